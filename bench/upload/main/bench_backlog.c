@@ -0,0 +1,46 @@
+// Holds the sessions in the backlog, then drains it as the firmware does once the backend is back
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "backlog.h"
+#include "sdkconfig.h"
+#include "bench.h"
+
+static const char *TAG = "upload_bench";
+
+void bench_backlog(int sessions, camera_fb_t *fb)
+{
+  int batch = bench_env_int("BENCH_RUN_BATCH", CONFIG_HTTP_CLIENT_RUN_BATCH_SIZE);
+  for (int i = 0; i < sessions; i++)
+  {
+    session_data_t session = bench_session(i, fb);
+    if (backlog_add(&session, NULL) != ESP_OK)
+    {
+      ESP_LOGE(TAG, "Backlog add failed");
+      exit(1);
+    }
+  }
+  printf("Draining %zu held sessions, %d runs per request\n", backlog_count(), batch);
+
+  int64_t start = esp_timer_get_time();
+  esp_err_t err = backlog_upload_images();
+  int64_t images_done = esp_timer_get_time();
+  // every request goes out on a new or a kept connection
+  http_client_stats_t before, after;
+  http_client_get_stats(&before);
+  if (err == ESP_OK)
+  {
+    err = backlog_create_runs(batch);
+  }
+  int64_t runs_done = esp_timer_get_time();
+  http_client_get_stats(&after);
+  uint32_t requests = after.connections + after.reused - before.connections - before.reused;
+
+  printf("\n%s, %zu sessions left\n", esp_err_to_name(err), backlog_count());
+  printf("images  %.2f s\n", (images_done - start) / 1e6);
+  printf("runs    %.3f s, %" PRIu32 " requests\n", (runs_done - images_done) / 1e6, requests);
+  printf("total   %.2f s, %.1f sessions/s\n", (runs_done - start) / 1e6, sessions / ((runs_done - start) / 1e6));
+}
@@ -0,0 +1,62 @@
+// Encodes runs as JSON and as CBOR, needs no server
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_timer.h"
+#include "run_encoding.h"
+#include "sdkconfig.h"
+#include "bench.h"
+
+// Size and encode time of the runs as formatted JSON, unformatted JSON and CBOR
+void bench_encode(int rounds, size_t count)
+{
+  static const session_data_t *sessions[100];
+  static const char *names[100];
+  static session_data_t storage[100];
+  static char keys[100][HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE];
+  static uint8_t cbor[100 * (CONFIG_SENSOR_FLOW_MAX_SAMPLES + 128)];
+  count = MIN(count, sizeof(sessions) / sizeof(sessions[0]));
+  for (size_t i = 0; i < count; i++)
+  {
+    storage[i] = bench_session(i + 10, NULL);
+    http_client_make_idempotency_key(keys[i], sizeof(keys[i]));
+    storage[i].idempotency_key = keys[i];
+    sessions[i] = &storage[i];
+    names[i] = "images/00000042.jpg";
+  }
+  bool array = count > 1;
+
+  size_t sizes[3] = {0};
+  int64_t us[3] = {0};
+  for (int kind = 0; kind < 3; kind++)
+  {
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++)
+    {
+      if (kind < 2)
+      {
+        // a single run goes out formatted, arrays unformatted
+        char *json = run_encoding_json(sessions, names, count, array, kind == 0 && !array);
+        sizes[kind] = strlen(json);
+        free(json);
+      }
+      else
+      {
+        sizes[kind] = run_encoding_cbor(cbor, sizeof(cbor), sessions, names, count, array);
+      }
+    }
+    us[kind] = esp_timer_get_time() - start;
+  }
+
+  printf("%zu run%s with flow curves, %d rounds\n", count, array ? "s" : "", rounds);
+  const char *labels[3] = {"JSON formatted", "JSON", "CBOR"};
+  // arrays are only sent unformatted
+  int sent = array ? 1 : 0;
+  for (int kind = sent; kind < 3; kind++)
+  {
+    printf("  %-15s %6zu bytes  %8.2f us  %5.1f%% of the JSON sent\n", labels[kind], sizes[kind],
+           (double)us[kind] / rounds, 100.0 * sizes[kind] / sizes[sent]);
+  }
+}
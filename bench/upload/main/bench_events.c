@@ -0,0 +1,103 @@
+// Announces runs over the event channel to scripts/standin_broker.py and compares the time until
+// the broker acknowledged each with the time until the run is created over HTTP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "event_channel.h"
+#include "bench.h"
+
+static const char *TAG = "upload_bench";
+
+// Per session: the event is queued, acknowledged by the broker, then the run is created over
+// HTTP for an image uploaded beforehand and, separately, the whole session is submitted
+void bench_events(int count, camera_fb_t *fb)
+{
+  const char *uri = getenv("BENCH_MQTT_URI") ? getenv("BENCH_MQTT_URI") : "mqtt://127.0.0.1:1883";
+  const event_channel_config_t channel_config = {
+      .uri = uri,
+      .username = "trichter",
+      .password = "super-safe-password",
+      .topic = "trichter/runs"};
+  esp_log_level_set("event_channel", ESP_LOG_WARN);
+  if (event_channel_mqtt.start(&channel_config) != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Event channel not started");
+    exit(1);
+  }
+  for (int i = 0; i < 500 && !event_channel_mqtt.is_connected(); i++)
+  {
+    usleep(10000);
+  }
+  if (!event_channel_mqtt.is_connected())
+  {
+    ESP_LOGE(TAG, "No connection to the broker at %s", uri);
+    exit(1);
+  }
+
+  session_data_t session = bench_session(0, fb);
+  image_upload_response_t upload = {0};
+  if (http_client_upload_image(&session, &upload) != ESP_OK || !upload.image_resource_name)
+  {
+    ESP_LOGE(TAG, "Image upload failed");
+    exit(1);
+  }
+
+  int64_t *queued_us = malloc(count * sizeof(int64_t));
+  int64_t *acked_us = malloc(count * sizeof(int64_t));
+  int64_t *run_us = malloc(count * sizeof(int64_t));
+  int64_t *submit_us = malloc(count * sizeof(int64_t));
+  if (!queued_us || !acked_us || !run_us || !submit_us)
+  {
+    ESP_LOGE(TAG, "Out of memory");
+    exit(1);
+  }
+
+  printf("Announcing %d runs over %s on %s\n", count, event_channel_mqtt.name, uri);
+  int failed = 0;
+  for (int i = 0; i < count; i++)
+  {
+    char key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE];
+    http_client_make_idempotency_key(key, sizeof(key));
+    session = bench_session(i, fb);
+    session.idempotency_key = key;
+
+    int64_t t = esp_timer_get_time();
+    if (event_channel_mqtt.publish_run(&session) != ESP_OK)
+    {
+      failed++;
+    }
+    queued_us[i] = esp_timer_get_time() - t;
+    while (!event_channel_mqtt.is_flushed() && esp_timer_get_time() - t < 5000000)
+    {
+      usleep(20);
+    }
+    acked_us[i] = esp_timer_get_time() - t;
+
+    run_create_response_t run = {0};
+    t = esp_timer_get_time();
+    failed += http_client_create_run(&session, upload.image_resource_name, &run) != ESP_OK;
+    run_us[i] = esp_timer_get_time() - t;
+    http_client_free_run_response(&run);
+
+    // a fresh key, the run above already exists
+    http_client_make_idempotency_key(key, sizeof(key));
+    t = esp_timer_get_time();
+    failed += http_client_submit_session(&session, NULL, NULL) != ESP_OK;
+    submit_us[i] = esp_timer_get_time() - t;
+  }
+
+  printf("%d failed\n", failed);
+  bench_print_latency("event queued", queued_us, count);
+  bench_print_latency("event acked", acked_us, count);
+  bench_print_latency("HTTP run", run_us, count);
+  bench_print_latency("HTTP session", submit_us, count);
+  event_channel_mqtt.stop();
+  http_client_free_image_response(&upload);
+  free(queued_us);
+  free(acked_us);
+  free(run_us);
+  free(submit_us);
+}
@@ -0,0 +1,73 @@
+// Times new connections with a full handshake and with the saved session offered. For the latter
+// the stand-in has to close each connection (--close-connections). Whether the session was
+// actually resumed only the server knows, the stand-in counts tls_resumed and tls_full.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "bench.h"
+
+static const char *TAG = "upload_bench";
+
+// Connect and handshake time of the request, 0 if it was sent on a kept connection
+static int64_t bench_connect_us(const session_data_t *session)
+{
+  http_client_stats_t before, after;
+  http_client_get_stats(&before);
+  image_upload_response_t response = {0};
+  esp_err_t err = http_client_upload_image(session, &response);
+  http_client_free_image_response(&response);
+  http_client_get_stats(&after);
+  if (err != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Upload failed: %s", esp_err_to_name(err));
+    exit(1);
+  }
+  return after.connections > before.connections ? after.last_connect_us : 0;
+}
+
+void bench_handshakes(int count, const http_client_config_t *config, camera_fb_t *fb)
+{
+  int64_t *full_us = malloc(count * sizeof(int64_t));
+  int64_t *offered_us = malloc(count * sizeof(int64_t));
+  if (!full_us || !offered_us)
+  {
+    ESP_LOGE(TAG, "Out of memory");
+    exit(1);
+  }
+  session_data_t session = bench_session(0, fb);
+
+  // Setting the configuration drops the connection and the TLS session
+  for (int i = 0; i < count; i++)
+  {
+    http_client_set_config(config);
+    full_us[i] = bench_connect_us(&session);
+  }
+
+  http_client_set_config(config);
+  bench_connect_us(&session);
+  int offered = 0;
+  for (int i = 0; i < count; i++)
+  {
+    int64_t us = bench_connect_us(&session);
+    if (us)
+    {
+      offered_us[offered++] = us;
+    }
+  }
+
+  qsort(full_us, count, sizeof(int64_t), bench_compare_i64);
+  printf("%s handshakes to %s:%d\n", config->use_tls ? "TLS" : "TCP", config->host, config->port);
+  printf("full     n=%-4d p50 %.2f ms  p90 %.2f ms  max %.2f ms\n", count,
+         bench_percentile_ms(full_us, count, 50), bench_percentile_ms(full_us, count, 90), full_us[count - 1] / 1000.0);
+  if (offered)
+  {
+    qsort(offered_us, offered, sizeof(int64_t), bench_compare_i64);
+    printf("offered  n=%-4d p50 %.2f ms  p90 %.2f ms  max %.2f ms\n", offered,
+           bench_percentile_ms(offered_us, offered, 50), bench_percentile_ms(offered_us, offered, 90),
+           offered_us[offered - 1] / 1000.0);
+  }
+  printf("kept     n=%-4d requests needed no new connection\n", count - offered);
+  free(full_us);
+  free(offered_us);
+}
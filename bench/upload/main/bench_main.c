@@ -0,0 +1,82 @@
+// Drives the client against the stand-in backend (scripts/standin_server.py). Without a mode set it
+// submits BENCH_SESSIONS sessions and reports throughput and latency percentiles (bench_sessions.c).
+// The modes, each in its own file:
+//   BENCH_BACKLOG=1     holds the sessions in the backlog and drains it with BENCH_RUN_BATCH runs
+//                       per request (bench_backlog.c)
+//   BENCH_HANDSHAKES=n  times n full and n resumed handshakes (bench_handshakes.c)
+//   BENCH_EVENTS=n      announces n runs over the event channel (bench_events.c)
+//   BENCH_ENCODE=n      encodes runs n times as JSON and CBOR, needs no server (bench_encode.c)
+//
+// Environment: BENCH_HOST (127.0.0.1), BENCH_PORT (8080), BENCH_SESSIONS (1000), BENCH_TIMEOUT_MS (10000),
+//              BENCH_BACKLOG (0), BENCH_RUN_BATCH (CONFIG_HTTP_CLIENT_RUN_BATCH_SIZE),
+//              BENCH_TLS (0), BENCH_CA_CERT (PEM file, required with BENCH_TLS), BENCH_HANDSHAKES (0),
+//              BENCH_EVENTS (0), BENCH_MQTT_URI (mqtt://127.0.0.1:1883), BENCH_ENCODE (0)
+
+#include <stdlib.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "bench.h"
+
+static const char *TAG = "upload_bench";
+
+extern const uint8_t image_start[] asm("_binary_test_inside_jpeg_start");
+extern const uint8_t image_end[] asm("_binary_test_inside_jpeg_end");
+
+void app_main(void)
+{
+  const char *host = getenv("BENCH_HOST") ? getenv("BENCH_HOST") : "127.0.0.1";
+  int sessions = bench_env_int("BENCH_SESSIONS", 1000);
+  if (sessions < 1)
+  {
+    sessions = 1;
+  }
+  http_client_config_t config = {
+      .host = host,
+      .port = bench_env_int("BENCH_PORT", 8080),
+      .auth_header = "Basic dHJpY2h0ZXI6c3VwZXItc2FmZS1wYXNzd29yZA==",
+      .timeout_ms = bench_env_int("BENCH_TIMEOUT_MS", 10000),
+      .use_tls = bench_env_int("BENCH_TLS", 0),
+      .ca_cert_pem = bench_read_file(getenv("BENCH_CA_CERT"))};
+  if (config.use_tls && !config.ca_cert_pem)
+  {
+    ESP_LOGE(TAG, "BENCH_TLS needs the stand-in certificate in BENCH_CA_CERT");
+    exit(1);
+  }
+
+  bench_init_flow();
+  if (bench_env_int("BENCH_ENCODE", 0) > 0)
+  {
+    bench_encode(bench_env_int("BENCH_ENCODE", 0), 1);
+    bench_encode(bench_env_int("BENCH_ENCODE", 0), bench_env_int("BENCH_RUN_BATCH", CONFIG_HTTP_CLIENT_RUN_BATCH_SIZE));
+    exit(0);
+  }
+
+  esp_log_level_set("http_client", ESP_LOG_NONE);
+  ESP_ERROR_CHECK(http_client_init());
+  ESP_ERROR_CHECK(http_client_set_config(&config));
+
+  camera_fb_t fb = {
+      .buf = (uint8_t *)image_start,
+      .len = image_end - image_start,
+      .width = 320,
+      .height = 240,
+      .format = PIXFORMAT_JPEG};
+
+  if (bench_env_int("BENCH_HANDSHAKES", 0) > 0)
+  {
+    bench_handshakes(bench_env_int("BENCH_HANDSHAKES", 0), &config, &fb);
+  }
+  else if (bench_env_int("BENCH_EVENTS", 0) > 0)
+  {
+    bench_events(bench_env_int("BENCH_EVENTS", 0), &fb);
+  }
+  else if (bench_env_int("BENCH_BACKLOG", 0))
+  {
+    bench_backlog(sessions, &fb);
+  }
+  else
+  {
+    bench_sessions(sessions, &config, &fb);
+  }
+  exit(0);
+}
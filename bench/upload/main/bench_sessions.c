@@ -0,0 +1,84 @@
+// Submits sessions one after the other with http_client_submit_session()
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bench.h"
+
+static const char *TAG = "upload_bench";
+
+#define BENCH_MAX_ERROR_KINDS 8
+
+typedef struct
+{
+  esp_err_t err;
+  int count;
+} error_count_t;
+
+static void count_error(error_count_t *errors, esp_err_t err)
+{
+  for (int i = 0; i < BENCH_MAX_ERROR_KINDS; i++)
+  {
+    if (errors[i].err == err || !errors[i].count)
+    {
+      errors[i].err = err;
+      errors[i].count++;
+      return;
+    }
+  }
+}
+
+void bench_sessions(int sessions, const http_client_config_t *config, camera_fb_t *fb)
+{
+  int64_t *latency_us = malloc(sessions * sizeof(int64_t));
+  if (!latency_us)
+  {
+    ESP_LOGE(TAG, "Out of memory");
+    exit(1);
+  }
+  error_count_t errors[BENCH_MAX_ERROR_KINDS] = {0};
+  int ok = 0;
+
+  printf("Submitting %d sessions with a %zu byte image to %s:%d\n", sessions, fb->len, config->host, config->port);
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < sessions; i++)
+  {
+    session_data_t session = bench_session(i, fb);
+    int64_t t = esp_timer_get_time();
+    esp_err_t err = http_client_submit_session(&session, NULL, NULL);
+    latency_us[i] = esp_timer_get_time() - t;
+    if (err == ESP_OK)
+    {
+      ok++;
+    }
+    else
+    {
+      count_error(errors, err);
+    }
+    if ((i + 1) % 500 == 0)
+    {
+      printf("  %d/%d\n", i + 1, sessions);
+    }
+  }
+  double elapsed_s = (esp_timer_get_time() - start) / 1e6;
+
+  qsort(latency_us, sessions, sizeof(int64_t), bench_compare_i64);
+  printf("\n%d submitted, %d failed in %.2f s\n", ok, sessions - ok, elapsed_s);
+  printf("throughput  %.1f sessions/s, %.1f kB/s of images\n",
+         ok / elapsed_s, (double)ok * fb->len / 1000.0 / elapsed_s);
+  printf("latency ms  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+         bench_percentile_ms(latency_us, sessions, 50), bench_percentile_ms(latency_us, sessions, 90),
+         bench_percentile_ms(latency_us, sessions, 99), bench_percentile_ms(latency_us, sessions, 99.9),
+         latency_us[sessions - 1] / 1000.0);
+  http_client_stats_t stats;
+  http_client_get_stats(&stats);
+  printf("connections %" PRIu32 " new, %" PRIu32 " requests on a kept connection\n", stats.connections, stats.reused);
+  for (int i = 0; i < BENCH_MAX_ERROR_KINDS && errors[i].count; i++)
+  {
+    printf("  %5d x %s (0x%x)\n", errors[i].count, esp_err_to_name(errors[i].err), errors[i].err);
+  }
+
+  free(latency_us);
+}
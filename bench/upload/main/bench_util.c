@@ -0,0 +1,85 @@
+// Helpers and the sessions the bench modes share
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/param.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "bench.h"
+
+int bench_env_int(const char *name, int fallback)
+{
+  const char *value = getenv(name);
+  return value && *value ? atoi(value) : fallback;
+}
+
+int bench_compare_i64(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+double bench_percentile_ms(const int64_t *sorted, size_t n, double p)
+{
+  size_t rank = (size_t)(p / 100.0 * n + 0.999999);
+  rank = rank ? rank - 1 : 0;
+  return sorted[rank < n ? rank : n - 1] / 1000.0;
+}
+
+void bench_print_latency(const char *name, int64_t *us, size_t n)
+{
+  qsort(us, n, sizeof(int64_t), bench_compare_i64);
+  printf("%-14s p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n", name,
+         bench_percentile_ms(us, n, 50), bench_percentile_ms(us, n, 90), bench_percentile_ms(us, n, 99),
+         us[n - 1] / 1000.0);
+}
+
+char *bench_read_file(const char *path)
+{
+  FILE *f = path ? fopen(path, "rb") : NULL;
+  if (!f)
+  {
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *data = malloc(len + 1);
+  if (data && fread(data, 1, len, f) == (size_t)len)
+  {
+    data[len] = '\0';
+  }
+  else
+  {
+    free(data);
+    data = NULL;
+  }
+  fclose(f);
+  return data;
+}
+
+// Pulses per 100 ms of a session that ramps up, holds and tails off
+static uint8_t bench_flow[CONFIG_SENSOR_FLOW_MAX_SAMPLES];
+
+void bench_init_flow(void)
+{
+  for (int i = 0; i < CONFIG_SENSOR_FLOW_MAX_SAMPLES; i++)
+  {
+    bench_flow[i] = i < 4 ? 6 * i : 22 + (i * 7) % 5;
+  }
+}
+
+session_data_t bench_session(int i, camera_fb_t *fb)
+{
+  session_data_t session = {
+      .rate = 2.0f + (i % 50) * 0.1f,
+      .duration = 1.0f + (i % 20) * 0.5f,
+      .volume = 0.5f,
+      .timestamp = time(NULL),
+      .image_fb = fb,
+      .flow = bench_flow,
+      .flow_interval_ms = 100};
+  session.flow_len = MIN((size_t)(session.duration * 10), sizeof(bench_flow));
+  return session;
+}
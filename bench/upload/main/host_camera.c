@@ -0,0 +1,23 @@
+#include "esp_camera.h"
+#include "esp_log.h"
+
+static const char *TAG = "host_camera";
+
+// The benchmark uploads JPEG frames only, and sends them as they are
+
+bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpg_out_cb cb, void *arg)
+{
+  ESP_LOGE(TAG, "JPEG encoding is not available on the host");
+  return false;
+}
+
+bool frame2jpg(camera_fb_t *fb, uint8_t quality, uint8_t **out, size_t *out_len)
+{
+  ESP_LOGE(TAG, "JPEG encoding is not available on the host");
+  return false;
+}
+
+bool jpg_optimize_huffman(const uint8_t *src, size_t src_len, uint8_t **out, size_t *out_len)
+{
+  return false;
+}
@@ -0,0 +1,41 @@
+// Modes of the upload bench and the helpers they share, app_main() in bench_main.c picks the mode
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+#include "http_client.h"
+
+// Environment variable as a number, fallback if unset or empty
+int bench_env_int(const char *name, int fallback);
+
+int bench_compare_i64(const void *a, const void *b);
+
+// Nearest rank percentile of a sorted array
+double bench_percentile_ms(const int64_t *sorted, size_t n, double p);
+
+// Sorts us and prints its percentiles
+void bench_print_latency(const char *name, int64_t *us, size_t n);
+
+// Whole file as a string, NULL if it can't be read
+char *bench_read_file(const char *path);
+
+void bench_init_flow(void);
+
+// Session i of the bench, with a flow curve and fb as its image
+session_data_t bench_session(int i, camera_fb_t *fb);
+
+// Submits sessions one after the other and reports throughput and latency percentiles
+void bench_sessions(int sessions, const http_client_config_t *config, camera_fb_t *fb);
+
+// Holds sessions in the backlog and drains it with BENCH_RUN_BATCH runs per request
+void bench_backlog(int sessions, camera_fb_t *fb);
+
+// Times count new connections with a full handshake and count with the saved session offered
+void bench_handshakes(int count, const http_client_config_t *config, camera_fb_t *fb);
+
+// Compares announcing a run over the event channel with creating it over HTTP
+void bench_events(int count, camera_fb_t *fb);
+
+// Size and encode time of count runs as JSON and as CBOR
+void bench_encode(int rounds, size_t count);
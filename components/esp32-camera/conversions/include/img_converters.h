@@ -0,0 +1,283 @@
+// Copyright 2015-2025 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _IMG_CONVERTERS_H_
+#define _IMG_CONVERTERS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_camera.h"
+#include "jpeg_decoder.h"
+
+typedef size_t (* jpg_out_cb)(void * arg, size_t index, const void* data, size_t len);
+
+/**
+ * @brief Convert image buffer to JPEG
+ *
+ * @param src       Source buffer in RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param quality   JPEG quality of the resulting image
+ * @param cp        Callback to be called to write the bytes of the output JPEG, in pieces of at most 512 bytes.
+ *                  It returns the number of bytes consumed; returning less than len stops the encoder.
+ *                  The image is encoded one MCU row at a time, so output starts before the frame is done.
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief Convert camera frame buffer to JPEG
+ *
+ * @param fb        Source camera frame buffer
+ * @param quality   JPEG quality of the resulting image
+ * @param cp        Callback to be called to write the bytes of the output JPEG
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool frame2jpg_cb(camera_fb_t * fb, uint8_t quality, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief Convert image buffer to JPEG buffer
+ *
+ * @param src       Source buffer in RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param quality   JPEG quality of the resulting image
+ * @param out       Pointer to be populated with the address of the resulting buffer.
+ *                  You MUST free the pointer once you are done with it.
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Convert camera frame buffer to JPEG buffer
+ *
+ * @param fb        Source camera frame buffer
+ * @param quality   JPEG quality of the resulting image
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool frame2jpg(camera_fb_t * fb, uint8_t quality, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Convert image buffer to BMP buffer
+ *
+ * @param src       Source buffer in JPEG, RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Convert camera frame buffer to BMP buffer
+ *
+ * @param fb        Source camera frame buffer
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool frame2bmp(camera_fb_t * fb, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Losslessly re-encode a baseline JPEG with Huffman tables optimized for its content
+ *
+ * The entropy coded data is rewritten symbol by symbol, the image is not decoded to pixels.
+ * Only single-scan baseline (sequential Huffman) JPEGs are supported, as produced by the camera sensors.
+ *
+ * @param src       Source JPEG buffer
+ * @param src_len   Length in bytes of the source buffer
+ * @param out       Pointer to be populated with the address of the resulting buffer.
+ *                  You MUST free the pointer once you are done with it.
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool jpg_optimize_huffman(const uint8_t *src, size_t src_len, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Luminance histogram
+ */
+typedef struct {
+    uint32_t bins[256]; /*!< Number of pixels per luminance level */
+    uint32_t count;     /*!< Total number of pixels */
+} luma_hist_t;
+
+/**
+ * @brief Add 8-bit luminance samples to a histogram
+ *
+ * @param hist      Histogram to update
+ * @param gray      Luminance samples
+ * @param len       Number of samples
+ */
+void luma_hist_add(luma_hist_t *hist, const uint8_t *gray, size_t len);
+
+/**
+ * @brief Compute the luminance histogram of a camera frame at reduced scale
+ *
+ * JPEG frames are decoded to grayscale at the given scale, so only luminance is decoded
+ * and at 1:8 only its DC coefficients. GRAYSCALE and YUV422 frames are subsampled
+ * by the same factor.
+ *
+ * @param fb        Source camera frame buffer
+ * @param scale     Reduction applied before counting
+ * @param hist      Histogram to be populated, cleared first
+ *
+ * @return true on success
+ */
+bool frame2luma_hist(camera_fb_t *fb, esp_jpeg_image_scale_t scale, luma_hist_t *hist);
+
+/**
+ * @brief Lowest luminance level below or at which the given share of pixels lies
+ *
+ * @param hist      Histogram
+ * @param percent   Share of pixels, 0 to 100
+ *
+ * @return luminance level, 0 for an empty histogram
+ */
+uint8_t luma_hist_percentile(const luma_hist_t *hist, uint8_t percent);
+
+/**
+ * @brief Count the pixels that changed against a reference image and move the reference towards the frame
+ *
+ * Both images hold 8-bit luminance samples of the same size. Nothing is allocated.
+ *
+ * @param reference     Reference image, updated in place
+ * @param frame         New image
+ * @param len           Number of samples
+ * @param threshold     A sample counts as changed when it differs by more than this
+ * @param adapt_shift   The reference moves by 1/2^adapt_shift of the difference, rounded toward zero.
+ *                      0 replaces it by the frame
+ *
+ * @return number of changed samples
+ */
+size_t luma_diff_update(uint8_t *reference, const uint8_t *frame, size_t len, uint8_t threshold, uint8_t adapt_shift);
+
+/**
+ * @brief ASCII tag of an Exif IFD0
+ */
+typedef struct {
+    uint16_t tag;       /*!< Exif tag, e.g. 0x010E ImageDescription or 0x0132 DateTime */
+    const char *value;  /*!< NUL terminated value */
+} jpg_exif_entry_t;
+
+/**
+ * @brief Build a minimal APP1 Exif segment holding ASCII tags in IFD0
+ *
+ * @param dst       Output buffer for the complete segment, starting with the APP1 marker
+ * @param dst_len   Size of the output buffer
+ * @param entries   Tags in ascending tag order
+ * @param count     Number of tags
+ *
+ * @return length of the segment, 0 if it does not fit or the tags are not in order
+ */
+size_t jpg_exif_build(uint8_t *dst, size_t dst_len, const jpg_exif_entry_t *entries, size_t count);
+
+/**
+ * @brief State of a streaming JPEG segment splice
+ */
+typedef struct {
+    jpg_out_cb cb;              /*!< Receives the output */
+    void *arg;                  /*!< Passed to cb */
+    const uint8_t *segment;     /*!< Complete segment to insert, including its marker */
+    size_t segment_len;         /*!< Length of the segment */
+    size_t index;               /*!< Bytes written to cb so far */
+    size_t skip;                /*!< Bytes left of the APP0 segment being passed through */
+    uint8_t state;
+    uint8_t head_len;
+    uint8_t head[4];            /*!< Held back marker bytes */
+} jpg_splice_t;
+
+/**
+ * @brief Start inserting a segment into a JPEG stream
+ *
+ * The segment is inserted behind SOI and any APP0 (JFIF) segment. Image data is handed
+ * to the callback in the pieces it was written in, without being copied or decoded.
+ * Input that does not start with SOI is passed through unchanged.
+ *
+ * @param splice        State to initialize, no other memory is used
+ * @param segment       Segment to insert, e.g. from jpg_exif_build(). Must stay valid until it is written.
+ * @param segment_len   Length of the segment
+ * @param cb            Callback receiving the output JPEG
+ * @param arg           Pointer to be passed to the callback
+ */
+void jpg_splice_init(jpg_splice_t *splice, const uint8_t *segment, size_t segment_len, jpg_out_cb cb, void *arg);
+
+/**
+ * @brief Feed the next piece of the JPEG stream, a jpg_out_cb so it can be chained behind frame2jpg_cb()
+ *
+ * @param arg       Splice state from jpg_splice_init()
+ * @param index     Ignored
+ * @param data      Next bytes of the source JPEG
+ * @param len       Number of bytes
+ *
+ * @return len, or 0 when the callback did not take all output
+ */
+size_t jpg_splice_write(void *arg, size_t index, const void *data, size_t len);
+
+/**
+ * @brief Flush held back bytes after the last write
+ *
+ * @param splice    Splice state
+ *
+ * @return true if the segment was inserted and all output was taken
+ */
+bool jpg_splice_finish(jpg_splice_t *splice);
+
+/**
+ * @brief Convert image buffer to RGB888 buffer (used for face detection)
+ *
+ * @param src       Source buffer in JPEG, RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param format    Format of the source image
+ * @param rgb_buf   Pointer to the output buffer (width * height * 3)
+ *
+ * @return true on success
+ */
+bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint8_t * rgb_buf);
+
+// Macros for backwards compatibility
+#define JPG_SCALE_NONE JPEG_IMAGE_SCALE_0
+#define JPG_SCALE_2X   JPEG_IMAGE_SCALE_1_2
+#define JPG_SCALE_4X   JPEG_IMAGE_SCALE_1_4
+#define JPG_SCALE_8X   JPEG_IMAGE_SCALE_1_8
+#define JPG_SCALE_MAX  JPEG_IMAGE_SCALE_1_8
+bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t * out, esp_jpeg_image_scale_t scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IMG_CONVERTERS_H_ */
@@ -0,0 +1,732 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include "img_converters.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "jpg_huffman";
+#endif
+
+// Lossless re-encoding of a baseline JPEG with Huffman tables built from its own
+// symbol statistics (ITU T.81 Annex K.2). Coefficients are never reconstructed:
+// pass one counts the Huffman symbols of the scan, pass two copies every symbol's
+// extra bits and replaces only its code.
+
+#define JH_MAX_COMPONENTS   4
+#define JH_MAX_TABLES       4
+#define JH_LOOKAHEAD        8
+
+typedef struct {
+    // table as found in the source, for decoding
+    uint8_t bits[17];
+    uint8_t vals[256];
+    int32_t maxcode[17];
+    int32_t valoffset[17];
+    uint8_t look_len[1 << JH_LOOKAHEAD];
+    uint8_t look_sym[1 << JH_LOOKAHEAD];
+    bool present;
+    // optimized table, for encoding
+    uint32_t freq[257];
+    uint8_t new_bits[17];
+    uint8_t new_vals[256];
+    uint16_t codes[256];
+    uint8_t sizes[256];
+    bool used;
+} jh_table_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+} jh_frame_comp_t;
+
+typedef struct {
+    uint8_t h;
+    uint8_t v;
+    jh_table_t *dc;
+    jh_table_t *ac;
+} jh_scan_comp_t;
+
+typedef struct {
+    const uint8_t *src;
+    size_t len;
+
+    jh_table_t dc[JH_MAX_TABLES];
+    jh_table_t ac[JH_MAX_TABLES];
+    jh_frame_comp_t frame[JH_MAX_COMPONENTS];
+    jh_scan_comp_t scan[JH_MAX_COMPONENTS];
+    int frame_comps;
+    int scan_comps;
+    uint16_t width;
+    uint16_t height;
+    uint16_t restart_interval;
+    size_t sos_offset;
+    size_t scan_offset;
+
+    // bit reader
+    size_t pos;
+    uint32_t acc;
+    int nbits;
+    bool marker_hit;
+
+    // bit writer, out == NULL while counting
+    uint8_t *out;
+    size_t out_len;
+    size_t out_cap;
+    uint32_t wacc;
+    int wbits;
+} jh_ctx_t;
+
+// Default tables of ITU T.81 Annex K.3, used by MJPEG style frames that carry no DHT segment
+static const uint8_t jh_std_dc_lum_bits[17] = { 0,0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0 };
+static const uint8_t jh_std_dc_chroma_bits[17] = { 0,0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0 };
+static const uint8_t jh_std_dc_val[12] = { 0,1,2,3,4,5,6,7,8,9,10,11 };
+static const uint8_t jh_std_ac_lum_bits[17] = { 0,0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d };
+static const uint8_t jh_std_ac_lum_val[162] = {
+    0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,
+    0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,
+    0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+    0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,
+    0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,
+    0xf9,0xfa
+};
+static const uint8_t jh_std_ac_chroma_bits[17] = { 0,0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77 };
+static const uint8_t jh_std_ac_chroma_val[162] = {
+    0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,
+    0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,
+    0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+    0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,
+    0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,
+    0xf9,0xfa
+};
+
+static void *_malloc(size_t size)
+{
+    // check if SPIRAM is enabled and allocate on SPIRAM if allocatable
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p) {
+        return p;
+    }
+#endif
+    // try allocating in internal memory
+    return malloc(size);
+}
+
+static uint16_t jh_read16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static bool jh_build_decoder(jh_table_t *t)
+{
+    int code = 0;
+    int k = 0;
+    memset(t->look_len, 0, sizeof(t->look_len));
+    for (int l = 1; l <= 16; l++) {
+        if (code + t->bits[l] > (1 << l)) {
+            return false;
+        }
+        t->valoffset[l] = k - code;
+        for (int i = 0; i < t->bits[l]; i++, k++, code++) {
+            if (l <= JH_LOOKAHEAD) {
+                int shift = JH_LOOKAHEAD - l;
+                for (int j = 0; j < (1 << shift); j++) {
+                    t->look_len[(code << shift) | j] = l;
+                    t->look_sym[(code << shift) | j] = t->vals[k];
+                }
+            }
+        }
+        t->maxcode[l] = t->bits[l] ? code - 1 : -1;
+        code <<= 1;
+    }
+    return true;
+}
+
+static bool jh_parse_dht(jh_ctx_t *c, const uint8_t *p, size_t len)
+{
+    while (len >= 17) {
+        uint8_t tc = p[0] >> 4;
+        uint8_t th = p[0] & 0x0F;
+        if (tc > 1 || th >= JH_MAX_TABLES) {
+            return false;
+        }
+        jh_table_t *t = tc ? &c->ac[th] : &c->dc[th];
+        size_t count = 0;
+        t->bits[0] = 0;
+        for (int i = 1; i <= 16; i++) {
+            t->bits[i] = p[i];
+            count += p[i];
+        }
+        if (count > 256 || len < 17 + count) {
+            return false;
+        }
+        memcpy(t->vals, p + 17, count);
+        if (!jh_build_decoder(t)) {
+            return false;
+        }
+        t->present = true;
+        p += 17 + count;
+        len -= 17 + count;
+    }
+    return len == 0;
+}
+
+static bool jh_load_std_table(jh_table_t *t, const uint8_t *bits, const uint8_t *vals, size_t count)
+{
+    memcpy(t->bits, bits, 17);
+    memcpy(t->vals, vals, count);
+    t->present = jh_build_decoder(t);
+    return t->present;
+}
+
+// Tables 0 and 1 fall back to the luminance and chrominance defaults when the frame did not define them
+static bool jh_default_tables(jh_ctx_t *c, uint8_t td, uint8_t ta)
+{
+    if (!c->dc[td].present && (td > 1 || !jh_load_std_table(&c->dc[td], td ? jh_std_dc_chroma_bits : jh_std_dc_lum_bits, jh_std_dc_val, 12))) {
+        return false;
+    }
+    if (!c->ac[ta].present && (ta > 1 || !jh_load_std_table(&c->ac[ta], ta ? jh_std_ac_chroma_bits : jh_std_ac_lum_bits, ta ? jh_std_ac_chroma_val : jh_std_ac_lum_val, 162))) {
+        return false;
+    }
+    return true;
+}
+
+static bool jh_parse_sof(jh_ctx_t *c, const uint8_t *p, size_t len)
+{
+    if (len < 6 || p[0] != 8) {
+        return false;
+    }
+    c->height = jh_read16(p + 1);
+    c->width = jh_read16(p + 3);
+    c->frame_comps = p[5];
+    if (c->frame_comps < 1 || c->frame_comps > JH_MAX_COMPONENTS || len < 6 + 3 * (size_t)c->frame_comps) {
+        return false;
+    }
+    for (int i = 0; i < c->frame_comps; i++) {
+        c->frame[i].id = p[6 + i * 3];
+        c->frame[i].h = p[7 + i * 3] >> 4;
+        c->frame[i].v = p[7 + i * 3] & 0x0F;
+        if (!c->frame[i].h || !c->frame[i].v) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool jh_parse_sos(jh_ctx_t *c, const uint8_t *p, size_t len)
+{
+    c->scan_comps = p[0];
+    // only a single scan holding all components is supported
+    if (c->scan_comps != c->frame_comps || len < 1 + 2 * (size_t)c->scan_comps + 3) {
+        return false;
+    }
+    for (int i = 0; i < c->scan_comps; i++) {
+        uint8_t id = p[1 + i * 2];
+        uint8_t td = p[2 + i * 2] >> 4;
+        uint8_t ta = p[2 + i * 2] & 0x0F;
+        const jh_frame_comp_t *fc = NULL;
+        for (int j = 0; j < c->frame_comps; j++) {
+            if (c->frame[j].id == id) {
+                fc = &c->frame[j];
+            }
+        }
+        if (!fc || td >= JH_MAX_TABLES || ta >= JH_MAX_TABLES || !jh_default_tables(c, td, ta)) {
+            return false;
+        }
+        c->scan[i].h = fc->h;
+        c->scan[i].v = fc->v;
+        c->scan[i].dc = &c->dc[td];
+        c->scan[i].ac = &c->ac[ta];
+        c->dc[td].used = true;
+        c->ac[ta].used = true;
+    }
+    return true;
+}
+
+// Walk the header up to SOS. Only baseline and extended sequential Huffman frames are accepted.
+static bool jh_parse_header(jh_ctx_t *c)
+{
+    size_t pos = 2;
+    if (c->len < 4 || c->src[0] != 0xFF || c->src[1] != 0xD8) {
+        return false;
+    }
+    while (pos + 4 <= c->len) {
+        if (c->src[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = c->src[pos + 1];
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+        size_t seg_len = jh_read16(c->src + pos + 2);
+        if (seg_len < 2 || pos + 2 + seg_len > c->len) {
+            return false;
+        }
+        const uint8_t *p = c->src + pos + 4;
+        size_t len = seg_len - 2;
+        bool ok = true;
+        if (marker == 0xC4) {
+            ok = jh_parse_dht(c, p, len);
+        } else if (marker == 0xC0 || marker == 0xC1) {
+            ok = jh_parse_sof(c, p, len);
+        } else if ((marker >= 0xC2 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            ok = false; // progressive, lossless or arithmetic coding
+        } else if (marker == 0xDD) {
+            ok = len >= 2;
+            c->restart_interval = ok ? jh_read16(p) : 0;
+        } else if (marker == 0xDA) {
+            if (!c->frame_comps || !jh_parse_sos(c, p, len)) {
+                return false;
+            }
+            c->sos_offset = pos;
+            c->scan_offset = pos + 2 + seg_len;
+            return true;
+        }
+        if (!ok) {
+            return false;
+        }
+        pos += 2 + seg_len;
+    }
+    return false;
+}
+
+static void jh_reader_reset(jh_ctx_t *c, size_t pos)
+{
+    c->pos = pos;
+    c->acc = 0;
+    c->nbits = 0;
+    c->marker_hit = false;
+}
+
+static inline void jh_fill(jh_ctx_t *c)
+{
+    while (c->nbits <= 24) {
+        uint8_t b = 0;
+        if (!c->marker_hit && c->pos < c->len) {
+            b = c->src[c->pos];
+            if (b == 0xFF) {
+                if (c->pos + 1 < c->len && c->src[c->pos + 1] == 0x00) {
+                    c->pos += 2;
+                } else {
+                    // a marker ends the entropy coded segment, pad with zeros
+                    c->marker_hit = true;
+                    b = 0;
+                }
+            } else {
+                c->pos++;
+            }
+        }
+        c->acc |= (uint32_t)b << (24 - c->nbits);
+        c->nbits += 8;
+    }
+}
+
+static inline void jh_skip(jh_ctx_t *c, int n)
+{
+    c->acc <<= n;
+    c->nbits -= n;
+}
+
+static inline uint32_t jh_get_bits(jh_ctx_t *c, int n)
+{
+    jh_fill(c);
+    uint32_t v = c->acc >> (32 - n);
+    jh_skip(c, n);
+    return v;
+}
+
+static inline int jh_decode(jh_ctx_t *c, const jh_table_t *t)
+{
+    jh_fill(c);
+    uint32_t look = c->acc >> (32 - JH_LOOKAHEAD);
+    int l = t->look_len[look];
+    if (l) {
+        jh_skip(c, l);
+        return t->look_sym[look];
+    }
+    uint32_t code16 = c->acc >> 16;
+    for (l = JH_LOOKAHEAD + 1; l <= 16; l++) {
+        int32_t code = code16 >> (16 - l);
+        if (code <= t->maxcode[l]) {
+            jh_skip(c, l);
+            return t->vals[t->valoffset[l] + code];
+        }
+    }
+    return -1;
+}
+
+static inline bool jh_emit_byte(jh_ctx_t *c, uint8_t b)
+{
+    if (c->out_len >= c->out_cap) {
+        return false;
+    }
+    c->out[c->out_len++] = b;
+    return true;
+}
+
+static inline bool jh_put_bits(jh_ctx_t *c, uint32_t code, int size)
+{
+    c->wacc = (c->wacc << size) | (code & ((1U << size) - 1));
+    c->wbits += size;
+    while (c->wbits >= 8) {
+        uint8_t b = c->wacc >> (c->wbits - 8);
+        if (!jh_emit_byte(c, b) || (b == 0xFF && !jh_emit_byte(c, 0x00))) {
+            return false;
+        }
+        c->wbits -= 8;
+    }
+    c->wacc &= (1U << c->wbits) - 1;
+    return true;
+}
+
+// Pad the last byte with ones, as required before a marker
+static bool jh_flush_bits(jh_ctx_t *c)
+{
+    bool ok = jh_put_bits(c, 0x7F, 7);
+    c->wacc = 0;
+    c->wbits = 0;
+    return ok;
+}
+
+static inline bool jh_symbol(jh_ctx_t *c, jh_table_t *t, int sym, uint32_t extra, int nextra)
+{
+    if (!c->out) {
+        t->freq[sym]++;
+        return true;
+    }
+    if (!t->sizes[sym] || !jh_put_bits(c, t->codes[sym], t->sizes[sym])) {
+        return false;
+    }
+    return !nextra || jh_put_bits(c, extra, nextra);
+}
+
+static bool jh_block(jh_ctx_t *c, jh_table_t *dc, jh_table_t *ac)
+{
+    int s = jh_decode(c, dc);
+    if (s < 0 || s > 11) {
+        return false;
+    }
+    if (!jh_symbol(c, dc, s, s ? jh_get_bits(c, s) : 0, s)) {
+        return false;
+    }
+    for (int k = 1; k < 64; k++) {
+        int rs = jh_decode(c, ac);
+        if (rs < 0) {
+            return false;
+        }
+        int r = rs >> 4;
+        s = rs & 0x0F;
+        if (s > 10 || !jh_symbol(c, ac, rs, s ? jh_get_bits(c, s) : 0, s)) {
+            return false;
+        }
+        if (s == 0) {
+            if (r != 15) {
+                break; // EOB
+            }
+            k += 15;
+        } else {
+            k += r;
+        }
+        if (k > 63) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool jh_restart(jh_ctx_t *c)
+{
+    // the reader stopped at the marker, drop the padding bits
+    size_t pos = c->pos;
+    while (pos + 1 < c->len && c->src[pos] == 0xFF && c->src[pos + 1] == 0xFF) {
+        pos++;
+    }
+    if (pos + 1 >= c->len || c->src[pos] != 0xFF || (c->src[pos + 1] & 0xF8) != 0xD0) {
+        return false;
+    }
+    uint8_t marker = c->src[pos + 1];
+    jh_reader_reset(c, pos + 2);
+    if (c->out) {
+        return jh_flush_bits(c) && jh_emit_byte(c, 0xFF) && jh_emit_byte(c, marker);
+    }
+    return true;
+}
+
+// Runs the scan once, counting symbols when c->out is NULL and re-encoding them otherwise
+static bool jh_scan(jh_ctx_t *c)
+{
+    int hmax = 1, vmax = 1;
+    for (int i = 0; i < c->frame_comps; i++) {
+        hmax = c->frame[i].h > hmax ? c->frame[i].h : hmax;
+        vmax = c->frame[i].v > vmax ? c->frame[i].v : vmax;
+    }
+    uint32_t mcus;
+    if (c->scan_comps > 1) {
+        mcus = ((c->width + 8 * hmax - 1) / (8 * hmax)) * ((c->height + 8 * vmax - 1) / (8 * vmax));
+    } else {
+        uint32_t w = (c->width * c->scan[0].h + hmax - 1) / hmax;
+        uint32_t h = (c->height * c->scan[0].v + vmax - 1) / vmax;
+        mcus = ((w + 7) / 8) * ((h + 7) / 8);
+    }
+
+    jh_reader_reset(c, c->scan_offset);
+    for (uint32_t m = 0; m < mcus; m++) {
+        if (c->restart_interval && m && (m % c->restart_interval) == 0 && !jh_restart(c)) {
+            return false;
+        }
+        for (int i = 0; i < c->scan_comps; i++) {
+            int blocks = c->scan_comps > 1 ? c->scan[i].h * c->scan[i].v : 1;
+            for (int b = 0; b < blocks; b++) {
+                if (!jh_block(c, c->scan[i].dc, c->scan[i].ac)) {
+                    return false;
+                }
+            }
+        }
+    }
+    if (c->out && !jh_flush_bits(c)) {
+        return false;
+    }
+
+    // the scan must be followed by EOI, anything else (more scans, DNL) is not supported
+    size_t pos = c->pos;
+    while (pos + 1 < c->len && !(c->src[pos] == 0xFF && c->src[pos + 1] != 0x00 && c->src[pos + 1] != 0xFF)) {
+        pos++;
+    }
+    return pos + 1 < c->len && c->src[pos + 1] == 0xD9;
+}
+
+// Optimal code lengths limited to 16 bits, as in ITU T.81 Annex K.2 (and libjpeg's jpeg_gen_optimal_table)
+static void jh_gen_optimal_table(jh_table_t *t)
+{
+    uint8_t bits[33] = {0};
+    int codesize[257];
+    int others[257];
+
+    t->freq[256] = 1; // reserves the all-ones code point
+    for (int i = 0; i < 257; i++) {
+        codesize[i] = 0;
+        others[i] = -1;
+    }
+    for (;;) {
+        int c1 = -1, c2 = -1;
+        uint32_t v = UINT32_MAX;
+        for (int i = 0; i <= 256; i++) {
+            if (t->freq[i] && t->freq[i] <= v) {
+                v = t->freq[i];
+                c1 = i;
+            }
+        }
+        v = UINT32_MAX;
+        for (int i = 0; i <= 256; i++) {
+            if (t->freq[i] && t->freq[i] <= v && i != c1) {
+                v = t->freq[i];
+                c2 = i;
+            }
+        }
+        if (c2 < 0) {
+            break;
+        }
+        t->freq[c1] += t->freq[c2];
+        t->freq[c2] = 0;
+        codesize[c1]++;
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            codesize[c1]++;
+        }
+        others[c1] = c2;
+        codesize[c2]++;
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            codesize[c2]++;
+        }
+    }
+    for (int i = 0; i <= 256; i++) {
+        if (codesize[i]) {
+            bits[codesize[i]]++;
+        }
+    }
+    for (int i = 32; i > 16; i--) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) {
+                j--;
+            }
+            bits[i] -= 2;
+            bits[i - 1]++;
+            bits[j + 1] += 2;
+            bits[j]--;
+        }
+    }
+    int i = 16;
+    while (bits[i] == 0) {
+        i--;
+    }
+    bits[i]--;
+
+    memcpy(t->new_bits, bits, 17);
+    int p = 0;
+    for (int l = 1; l <= 32; l++) {
+        for (int j = 0; j < 256; j++) {
+            if (codesize[j] == l) {
+                t->new_vals[p++] = j;
+            }
+        }
+    }
+
+    memset(t->sizes, 0, sizeof(t->sizes));
+    int code = 0, k = 0;
+    for (int l = 1; l <= 16; l++) {
+        for (int n = 0; n < t->new_bits[l]; n++, k++, code++) {
+            t->codes[t->new_vals[k]] = code;
+            t->sizes[t->new_vals[k]] = l;
+        }
+        code <<= 1;
+    }
+}
+
+static bool jh_emit_dht(jh_ctx_t *c)
+{
+    size_t len = 2;
+    for (int tc = 0; tc < 2; tc++) {
+        for (int th = 0; th < JH_MAX_TABLES; th++) {
+            jh_table_t *t = tc ? &c->ac[th] : &c->dc[th];
+            if (t->used) {
+                len += 17;
+                for (int l = 1; l <= 16; l++) {
+                    len += t->new_bits[l];
+                }
+            }
+        }
+    }
+    if (c->out_len + 2 + len > c->out_cap) {
+        return false;
+    }
+    uint8_t *p = c->out + c->out_len;
+    *p++ = 0xFF;
+    *p++ = 0xC4;
+    *p++ = len >> 8;
+    *p++ = len & 0xFF;
+    for (int tc = 0; tc < 2; tc++) {
+        for (int th = 0; th < JH_MAX_TABLES; th++) {
+            jh_table_t *t = tc ? &c->ac[th] : &c->dc[th];
+            if (!t->used) {
+                continue;
+            }
+            size_t count = 0;
+            *p++ = (tc << 4) | th;
+            for (int l = 1; l <= 16; l++) {
+                *p++ = t->new_bits[l];
+                count += t->new_bits[l];
+            }
+            memcpy(p, t->new_vals, count);
+            p += count;
+        }
+    }
+    c->out_len = p - c->out;
+    return true;
+}
+
+// Copy the header up to SOS without its DHT segments, then the new tables and the SOS segment
+static bool jh_emit_header(jh_ctx_t *c)
+{
+    size_t pos = 2;
+    c->out[0] = 0xFF;
+    c->out[1] = 0xD8;
+    c->out_len = 2;
+    while (pos < c->sos_offset) {
+        if (c->src[pos + 1] == 0xFF) {
+            pos++;
+            continue;
+        }
+        size_t seg = 2 + jh_read16(c->src + pos + 2);
+        if (c->src[pos + 1] != 0xC4) {
+            memcpy(c->out + c->out_len, c->src + pos, seg);
+            c->out_len += seg;
+        }
+        pos += seg;
+    }
+    if (!jh_emit_dht(c)) {
+        return false;
+    }
+    size_t sos_len = c->scan_offset - c->sos_offset;
+    if (c->out_len + sos_len > c->out_cap) {
+        return false;
+    }
+    memcpy(c->out + c->out_len, c->src + c->sos_offset, sos_len);
+    c->out_len += sos_len;
+    return true;
+}
+
+bool jpg_optimize_huffman(const uint8_t *src, size_t src_len, uint8_t **out, size_t *out_len)
+{
+    *out = NULL;
+    *out_len = 0;
+
+    jh_ctx_t *c = (jh_ctx_t *)_malloc(sizeof(jh_ctx_t));
+    if (!c) {
+        ESP_LOGE(TAG, "_malloc failed! %u", (unsigned)sizeof(jh_ctx_t));
+        return false;
+    }
+    memset(c, 0, sizeof(jh_ctx_t));
+    c->src = src;
+    c->len = src_len;
+
+    bool ok = false;
+    if (!jh_parse_header(c)) {
+        ESP_LOGW(TAG, "Unsupported JPEG header");
+        goto done;
+    }
+    if (!jh_scan(c)) {
+        ESP_LOGW(TAG, "Corrupt JPEG scan");
+        goto done;
+    }
+    for (int i = 0; i < JH_MAX_TABLES; i++) {
+        if (c->dc[i].used) {
+            jh_gen_optimal_table(&c->dc[i]);
+        }
+        if (c->ac[i].used) {
+            jh_gen_optimal_table(&c->ac[i]);
+        }
+    }
+
+    // the entropy data can only shrink, the tables may grow a little
+    c->out_cap = src_len + 2 * JH_MAX_TABLES * (17 + 256);
+    c->out = (uint8_t *)_malloc(c->out_cap);
+    if (!c->out) {
+        ESP_LOGE(TAG, "_malloc failed! %u", (unsigned)c->out_cap);
+        goto done;
+    }
+    ok = jh_emit_header(c) && jh_scan(c) && jh_emit_byte(c, 0xFF) && jh_emit_byte(c, 0xD9);
+    if (!ok) {
+        ESP_LOGW(TAG, "JPEG re-encode failed");
+        free(c->out);
+        goto done;
+    }
+    *out = c->out;
+    *out_len = c->out_len;
+
+done:
+    free(c);
+    return ok;
+}
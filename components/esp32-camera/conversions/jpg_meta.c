@@ -0,0 +1,220 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include <string.h>
+#include "img_converters.h"
+#include "sdkconfig.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "jpg_meta";
+#endif
+
+enum {
+    JPG_SPLICE_SOI,     // collecting the two SOI bytes
+    JPG_SPLICE_MARKER,  // collecting marker and length of the next segment
+    JPG_SPLICE_APP0,    // passing an APP0 (JFIF) segment through
+    JPG_SPLICE_DONE,    // segment inserted, passing the rest through
+    JPG_SPLICE_PASS,    // not a JPEG, passing everything through unchanged
+};
+
+#define EXIF_HEADER_LEN  6   // "Exif\0\0"
+#define TIFF_HEADER_LEN  8
+#define IFD_ENTRY_LEN    12
+#define EXIF_TYPE_ASCII  2
+
+static inline void put_u16le(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void put_u32le(uint8_t *p, uint32_t v)
+{
+    put_u16le(p, v);
+    put_u16le(p + 2, v >> 16);
+}
+
+size_t jpg_exif_build(uint8_t *dst, size_t dst_len, const jpg_exif_entry_t *entries, size_t count)
+{
+    // IFD0 directly follows the TIFF header, string values follow the IFD
+    size_t ifd_len = 2 + count * IFD_ENTRY_LEN + 4;
+    size_t len = 4 + EXIF_HEADER_LEN + TIFF_HEADER_LEN + ifd_len;
+    for (size_t i = 0; i < count; i++) {
+        size_t n = strlen(entries[i].value) + 1;
+        if (n > 4) {
+            len += n + (n & 1);
+        }
+        if (i && entries[i].tag <= entries[i - 1].tag) {
+            ESP_LOGE(TAG, "Exif tags must be in ascending order");
+            return 0;
+        }
+    }
+    if (len > dst_len || len - 2 > UINT16_MAX) {
+        ESP_LOGE(TAG, "Exif segment of %zu bytes does not fit", len);
+        return 0;
+    }
+
+    dst[0] = 0xFF;
+    dst[1] = 0xE1;
+    dst[2] = (len - 2) >> 8;
+    dst[3] = (len - 2) & 0xFF;
+    memcpy(dst + 4, "Exif\0\0", EXIF_HEADER_LEN);
+    uint8_t *tiff = dst + 4 + EXIF_HEADER_LEN;
+    memcpy(tiff, "II*\0", 4);
+    put_u32le(tiff + 4, TIFF_HEADER_LEN);
+
+    uint8_t *ifd = tiff + TIFF_HEADER_LEN;
+    size_t data = TIFF_HEADER_LEN + ifd_len;
+    put_u16le(ifd, count);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *e = ifd + 2 + i * IFD_ENTRY_LEN;
+        size_t n = strlen(entries[i].value) + 1;
+        put_u16le(e, entries[i].tag);
+        put_u16le(e + 2, EXIF_TYPE_ASCII);
+        put_u32le(e + 4, n);
+        if (n <= 4) {
+            memset(e + 8, 0, 4);
+            memcpy(e + 8, entries[i].value, n);
+        } else {
+            // values are word aligned
+            put_u32le(e + 8, data);
+            memcpy(tiff + data, entries[i].value, n);
+            if (n & 1) {
+                tiff[data + n] = 0;
+            }
+            data += n + (n & 1);
+        }
+    }
+    put_u32le(ifd + 2 + count * IFD_ENTRY_LEN, 0);
+    return len;
+}
+
+void jpg_splice_init(jpg_splice_t *splice, const uint8_t *segment, size_t segment_len, jpg_out_cb cb, void *arg)
+{
+    memset(splice, 0, sizeof(*splice));
+    splice->segment = segment;
+    splice->segment_len = segment_len;
+    splice->cb = cb;
+    splice->arg = arg;
+    splice->state = JPG_SPLICE_SOI;
+}
+
+static bool jpg_splice_emit(jpg_splice_t *splice, const uint8_t *data, size_t len)
+{
+    if (!len) {
+        return true;
+    }
+    if (splice->cb(splice->arg, splice->index, data, len) != len) {
+        return false;
+    }
+    splice->index += len;
+    return true;
+}
+
+static bool jpg_splice_insert(jpg_splice_t *splice)
+{
+    splice->state = JPG_SPLICE_DONE;
+    return jpg_splice_emit(splice, splice->segment, splice->segment_len);
+}
+
+size_t jpg_splice_write(void *arg, size_t index, const void *data, size_t len)
+{
+    jpg_splice_t *splice = (jpg_splice_t *)arg;
+    const uint8_t *src = (const uint8_t *)data;
+    size_t left = len;
+
+    // Only the few header bytes needed to find the insertion point are held back
+    while (left && splice->state != JPG_SPLICE_DONE && splice->state != JPG_SPLICE_PASS) {
+        if (splice->state == JPG_SPLICE_APP0) {
+            size_t n = left < splice->skip ? left : splice->skip;
+            if (!jpg_splice_emit(splice, src, n)) {
+                return 0;
+            }
+            src += n;
+            left -= n;
+            splice->skip -= n;
+            if (!splice->skip) {
+                splice->state = JPG_SPLICE_MARKER;
+            }
+            continue;
+        }
+
+        size_t want = splice->state == JPG_SPLICE_SOI ? 2 : 4;
+        while (left && splice->head_len < want) {
+            splice->head[splice->head_len++] = *src++;
+            left--;
+        }
+        if (splice->head_len < want) {
+            break;
+        }
+        uint8_t head_len = splice->head_len;
+        splice->head_len = 0;
+
+        if (splice->state == JPG_SPLICE_SOI) {
+            splice->state = (splice->head[0] == 0xFF && splice->head[1] == 0xD8) ? JPG_SPLICE_MARKER : JPG_SPLICE_PASS;
+            if (splice->state == JPG_SPLICE_PASS) {
+                ESP_LOGW(TAG, "No SOI marker, passing data through");
+            }
+            if (!jpg_splice_emit(splice, splice->head, head_len)) {
+                return 0;
+            }
+        } else if (splice->head[0] == 0xFF && splice->head[1] == 0xE0) {
+            // JFIF requires APP0 to come first
+            size_t seg_len = (splice->head[2] << 8) | splice->head[3];
+            if (seg_len < 2) {
+                ESP_LOGW(TAG, "Bad APP0 length %zu", seg_len);
+                splice->state = JPG_SPLICE_PASS;
+            } else {
+                splice->state = JPG_SPLICE_APP0;
+                splice->skip = seg_len - 2;
+            }
+            if (!jpg_splice_emit(splice, splice->head, head_len)) {
+                return 0;
+            }
+            if (splice->state == JPG_SPLICE_APP0 && !splice->skip) {
+                splice->state = JPG_SPLICE_MARKER;
+            }
+        } else {
+            if (!jpg_splice_insert(splice) || !jpg_splice_emit(splice, splice->head, head_len)) {
+                return 0;
+            }
+        }
+    }
+
+    if (!jpg_splice_emit(splice, src, left)) {
+        return 0;
+    }
+    return len;
+}
+
+bool jpg_splice_finish(jpg_splice_t *splice)
+{
+    // Input ended right behind SOI or APP0, e.g. a header only stream
+    if (splice->state == JPG_SPLICE_MARKER) {
+        uint8_t head_len = splice->head_len;
+        splice->head_len = 0;
+        if (!jpg_splice_insert(splice) || !jpg_splice_emit(splice, splice->head, head_len)) {
+            return false;
+        }
+    } else if (splice->head_len) {
+        uint8_t head_len = splice->head_len;
+        splice->head_len = 0;
+        jpg_splice_emit(splice, splice->head, head_len);
+    }
+    return splice->state == JPG_SPLICE_DONE;
+}
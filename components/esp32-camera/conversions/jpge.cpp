@@ -9,6 +9,7 @@
 //                       Code review revealed method load_block_16_8_8() (used for the non-default H2V1 sampling mode to downsample chroma) somehow didn't get the rounding factor fix from v1.02.
 
 #include "jpge.h"
+#include "jpge_block.h"
 
 #include <stdint.h>
 #include <stdarg.h>
@@ -18,6 +19,13 @@
 #include <string.h>
 #include <malloc.h>
 #include "esp_heap_caps.h"
+#include "sdkconfig.h"
+
+#if CONFIG_CAMERA_JPEG_ENCODER_FAST_DCT
+#define JPGE_FAST_DCT 1
+#else
+#define JPGE_FAST_DCT 0
+#endif
 
 #define JPGE_MAX(a,b) (((a)>(b))?(a):(b))
 #define JPGE_MIN(a,b) (((a)<(b))?(a):(b))
@@ -72,6 +80,9 @@ namespace jpge {
 
     static int32 m_last_quality = 0;
     static int32 m_quantization_tables[2][64];
+#if JPGE_FAST_DCT
+    static uint32 m_aan_recip_tables[2][64];
+#endif
 
     static bool m_huff_initialized = false;
     static uint m_huff_codes[4][256];
@@ -147,6 +158,52 @@ namespace jpge {
         }
     }
 
+    // Forward DCT - AAN (Arai, Agui, Nakajima), derived from jfdctfst but with 13 bit constants.
+    // 5 multiplies per 1D pass instead of 12. The outputs are left scaled by 32 * aan[u] * aan[v],
+    // that factor is folded into the reciprocal quantization tables, so quantization needs no divides.
+    enum { AAN_CONST_BITS = 13, AAN_PASS1_BITS = 2, AAN_RECIP_BITS = 18 };
+#define AAN_MUL(var, c) DCT_DESCALE((var) * static_cast<int32>(c), AAN_CONST_BITS)
+#define AAN1D(s0, s1, s2, s3, s4, s5, s6, s7) \
+    int32 t0 = s0 + s7, t7 = s0 - s7, t1 = s1 + s6, t6 = s1 - s6, t2 = s2 + s5, t5 = s2 - s5, t3 = s3 + s4, t4 = s3 - s4; \
+    int32 t10 = t0 + t3, t13 = t0 - t3, t11 = t1 + t2, t12 = t1 - t2; \
+    s0 = t10 + t11; s4 = t10 - t11; \
+    int32 z1 = AAN_MUL(t12 + t13, 5793); \
+    s2 = t13 + z1; s6 = t13 - z1; \
+    t10 = t4 + t5; t11 = t5 + t6; t12 = t6 + t7; \
+    int32 z5 = AAN_MUL(t10 - t12, 3135); \
+    int32 z2 = AAN_MUL(t10, 4433) + z5; \
+    int32 z4 = AAN_MUL(t12, 10703) + z5; \
+    int32 z3 = AAN_MUL(t11, 5793); \
+    int32 z11 = t7 + z3, z13 = t7 - z3; \
+    s5 = z13 + z2; s3 = z13 - z2; s1 = z11 + z4; s7 = z11 - z4;
+
+    static void DCT2D_AAN(int32 *p) {
+        int32 c, *q = p;
+        for (c = 7; c >= 0; c--, q += 8) {
+            int32 s0 = q[0] << AAN_PASS1_BITS, s1 = q[1] << AAN_PASS1_BITS, s2 = q[2] << AAN_PASS1_BITS, s3 = q[3] << AAN_PASS1_BITS;
+            int32 s4 = q[4] << AAN_PASS1_BITS, s5 = q[5] << AAN_PASS1_BITS, s6 = q[6] << AAN_PASS1_BITS, s7 = q[7] << AAN_PASS1_BITS;
+            AAN1D(s0, s1, s2, s3, s4, s5, s6, s7);
+            q[0] = s0; q[1] = s1; q[2] = s2; q[3] = s3; q[4] = s4; q[5] = s5; q[6] = s6; q[7] = s7;
+        }
+        for (q = p, c = 7; c >= 0; c--, q++) {
+            int32 s0 = q[0*8], s1 = q[1*8], s2 = q[2*8], s3 = q[3*8], s4 = q[4*8], s5 = q[5*8], s6 = q[6*8], s7 = q[7*8];
+            AAN1D(s0, s1, s2, s3, s4, s5, s6, s7);
+            q[0*8] = s0; q[1*8] = s1; q[2*8] = s2; q[3*8] = s3; q[4*8] = s4; q[5*8] = s5; q[6*8] = s6; q[7*8] = s7;
+        }
+    }
+
+    // aan[u] * aan[v] * 2^14, aan[0] = 1, aan[k] = cos(k * pi / 16) * sqrt(2)
+    static const int16 s_aan_scales[64] = {
+        16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+        22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
+        21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
+        19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
+        16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+        12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
+         8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
+         4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247
+    };
+
     // Compute the actual canonical Huffman codes/code sizes given the JPEG huff bits and val arrays.
     static void compute_huffman_table(uint *codes, uint8 *code_sizes, uint8 *bits, uint8 *val)
     {
@@ -381,13 +438,11 @@ namespace jpge {
         }
     }
 
-    void jpeg_encoder::load_quantized_coefficients(int component_num)
+    static void quantize_coefficients(int16 *pDst, const int32 *pSamples, const int32 *q)
     {
-        int32 *q = m_quantization_tables[component_num > 0];
-        int16 *pDst = m_coefficient_array;
         for (int i = 0; i < 64; i++)
         {
-            sample_array_t j = m_sample_array[s_zag[i]];
+            int32 j = pSamples[s_zag[i]];
             if (j < 0)
             {
                 if ((j = -j + (*q >> 1)) < *q)
@@ -406,6 +461,28 @@ namespace jpge {
         }
     }
 
+    static void quantize_coefficients_aan(int16 *pDst, const int32 *pSamples, const uint32 *r)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            int32 j = pSamples[s_zag[i]];
+            uint32 v = (static_cast<uint32>(j < 0 ? -j : j) * r[i] + (1U << (AAN_RECIP_BITS - 1))) >> AAN_RECIP_BITS;
+            pDst[i] = static_cast<int16>(j < 0 ? -static_cast<int32>(v) : static_cast<int32>(v));
+        }
+    }
+
+    void jpeg_encoder::load_quantized_coefficients(int component_num)
+    {
+        quantize_coefficients(m_coefficient_array, m_sample_array, m_quantization_tables[component_num > 0]);
+    }
+
+#if JPGE_FAST_DCT
+    void jpeg_encoder::load_quantized_coefficients_aan(int component_num)
+    {
+        quantize_coefficients_aan(m_coefficient_array, m_sample_array, m_aan_recip_tables[component_num > 0]);
+    }
+#endif
+
     void jpeg_encoder::code_coefficients_pass_two(int component_num)
     {
         int i, j, run_len, nbits, temp1, temp2;
@@ -472,8 +549,13 @@ namespace jpge {
 
     void jpeg_encoder::code_block(int component_num)
     {
+#if JPGE_FAST_DCT
+        DCT2D_AAN(m_sample_array);
+        load_quantized_coefficients_aan(component_num);
+#else
         DCT2D(m_sample_array);
         load_quantized_coefficients(component_num);
+#endif
         code_coefficients_pass_two(component_num);
     }
 
@@ -551,13 +633,23 @@ namespace jpge {
     }
 
     // Quantization table generation.
-    void jpeg_encoder::compute_quant_table(int32 *pDst, const int16 *pSrc)
+    // 2^AAN_RECIP_BITS / (q * 32 * aan[u] * aan[v]), in the zig-zag order of the quantization table
+    static void compute_aan_recip_table(uint32 *pDst, const int32 *pQuant)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            uint32 d = static_cast<uint32>(pQuant[i]) * s_aan_scales[s_zag[i]];
+            pDst[i] = ((1U << (AAN_RECIP_BITS + 14 - 5)) + (d >> 1)) / d;
+        }
+    }
+
+    static void compute_quant_table(int32 *pDst, const int16 *pSrc, int32 quality)
     {
         int32 q;
-        if (m_params.m_quality < 50)
-            q = 5000 / m_params.m_quality;
+        if (quality < 50)
+            q = 5000 / quality;
         else
-            q = 200 - m_params.m_quality * 2;
+            q = 200 - quality * 2;
         for (int i = 0; i < 64; i++)
         {
             int32 j = *pSrc++; j = (j * q + 50L) / 100L;
@@ -620,8 +712,12 @@ namespace jpge {
 
         if(m_last_quality != m_params.m_quality){
             m_last_quality = m_params.m_quality;
-            compute_quant_table(m_quantization_tables[0], s_std_lum_quant);
-            compute_quant_table(m_quantization_tables[1], s_std_croma_quant);
+            compute_quant_table(m_quantization_tables[0], s_std_lum_quant, m_params.m_quality);
+            compute_quant_table(m_quantization_tables[1], s_std_croma_quant, m_params.m_quality);
+#if JPGE_FAST_DCT
+            compute_aan_recip_table(m_aan_recip_tables[0], m_quantization_tables[0]);
+            compute_aan_recip_table(m_aan_recip_tables[1], m_quantization_tables[1]);
+#endif
         }
 
         if(!m_huff_initialized){
@@ -726,3 +822,20 @@ namespace jpge {
     }
 
 } // namespace jpge
+
+// Both DCT paths on a single block, for the tests that compare them
+void jpge_quantize_block(const int32_t *samples, int quality, bool chroma, bool fast, int16_t *coefficients)
+{
+    jpge::int32 block[64], quant[64];
+    jpge::uint32 recip[64];
+    memcpy(block, samples, sizeof(block));
+    jpge::compute_quant_table(quant, chroma ? jpge::s_std_croma_quant : jpge::s_std_lum_quant, quality);
+    if (fast) {
+        jpge::compute_aan_recip_table(recip, quant);
+        jpge::DCT2D_AAN(block);
+        jpge::quantize_coefficients_aan(coefficients, block, recip);
+    } else {
+        jpge::DCT2D(block);
+        jpge::quantize_coefficients(coefficients, block, quant);
+    }
+}
@@ -0,0 +1,30 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include "img_converters.h"
+
+// Change detection between low resolution grayscale frames. Runs on the caller's
+// buffers only, so it can be used from tasks that must not allocate.
+
+size_t luma_diff_update(uint8_t *reference, const uint8_t *frame, size_t len, uint8_t threshold, uint8_t adapt_shift)
+{
+    size_t changed = 0;
+    for (size_t i = 0; i < len; i++) {
+        int d = frame[i] - reference[i];
+        changed += (d > threshold) | (d < -threshold);
+        // Rounds toward zero, so the step never overshoots the frame and has no bias towards dark
+        reference[i] += (d + ((d >> 31) & ((1 << adapt_shift) - 1))) >> adapt_shift;
+    }
+    return changed;
+}
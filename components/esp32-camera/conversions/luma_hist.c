@@ -0,0 +1,128 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "img_converters.h"
+#include "sdkconfig.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "luma_hist";
+#endif
+
+void luma_hist_add(luma_hist_t *hist, const uint8_t *gray, size_t len)
+{
+    uint32_t *bins = hist->bins;
+    size_t i = 0;
+
+    // One 32-bit load per four pixels, the increments only depend on their own bin
+    for (; i + 4 <= len; i += 4) {
+        uint32_t w;
+        memcpy(&w, gray + i, 4);
+        bins[w & 0xff]++;
+        bins[(w >> 8) & 0xff]++;
+        bins[(w >> 16) & 0xff]++;
+        bins[w >> 24]++;
+    }
+    for (; i < len; i++) {
+        bins[gray[i]]++;
+    }
+    hist->count += len;
+}
+
+static void luma_hist_add_strided(luma_hist_t *hist, const uint8_t *src, size_t n, size_t stride)
+{
+    for (size_t i = 0; i < n; i++) {
+        hist->bins[src[i * stride]]++;
+    }
+    hist->count += n;
+}
+
+static bool jpg2luma_hist(const uint8_t *src, size_t src_len, esp_jpeg_image_scale_t scale, luma_hist_t *hist)
+{
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = (uint8_t *)src,
+        .indata_size = src_len,
+        .out_format = JPEG_IMAGE_FORMAT_GRAY8,
+        .out_scale = scale,
+    };
+    esp_jpeg_image_output_t output_img = {};
+    if (esp_jpeg_get_image_info(&jpeg_cfg, &output_img) != ESP_OK) {
+        ESP_LOGE(TAG, "Bad JPEG header");
+        return false;
+    }
+
+    // Small enough at 1:8 to stay in internal RAM
+    uint8_t *gray = malloc(output_img.output_len);
+    if (!gray) {
+        ESP_LOGE(TAG, "malloc failed! %zu", output_img.output_len);
+        return false;
+    }
+    jpeg_cfg.outbuf = gray;
+    jpeg_cfg.outbuf_size = output_img.output_len;
+    bool ok = esp_jpeg_decode(&jpeg_cfg, &output_img) == ESP_OK;
+    if (ok) {
+        luma_hist_add(hist, gray, (size_t)output_img.width * output_img.height);
+    }
+    free(gray);
+    return ok;
+}
+
+bool frame2luma_hist(camera_fb_t *fb, esp_jpeg_image_scale_t scale, luma_hist_t *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    if (fb->format == PIXFORMAT_JPEG) {
+        return jpg2luma_hist(fb->buf, fb->len, scale, hist);
+    }
+
+    // Raw frames are subsampled to the same pixel count instead of being averaged
+    size_t bpp;
+    if (fb->format == PIXFORMAT_GRAYSCALE) {
+        bpp = 1;
+    } else if (fb->format == PIXFORMAT_YUV422) {
+        bpp = 2; // Y is the first byte of every pixel
+    } else {
+        ESP_LOGE(TAG, "Unsupported format: %d", fb->format);
+        return false;
+    }
+    size_t step = (size_t)1 << scale;
+    size_t n = (fb->width + step - 1) / step;
+    if ((size_t)fb->width * fb->height * bpp > fb->len) {
+        return false;
+    }
+    for (size_t y = 0; y < fb->height; y += step) {
+        luma_hist_add_strided(hist, fb->buf + y * fb->width * bpp, n, step * bpp);
+    }
+    return true;
+}
+
+uint8_t luma_hist_percentile(const luma_hist_t *hist, uint8_t percent)
+{
+    if (!hist->count) {
+        return 0;
+    }
+    uint64_t target = ((uint64_t)hist->count * percent + 99) / 100;
+    uint32_t sum = 0;
+    for (int level = 0; level < 256; level++) {
+        sum += hist->bins[level];
+        if (sum >= target && sum) {
+            return level;
+        }
+    }
+    return 255;
+}
@@ -4,6 +4,8 @@
 #ifndef JPEG_ENCODER_H
 #define JPEG_ENCODER_H
 
+#include <stddef.h>
+
 namespace jpge
 {
     typedef unsigned char  uint8;
@@ -47,7 +49,7 @@ namespace jpge
         public:
             virtual ~output_stream() { };
             virtual bool put_buf(const void* Pbuf, int len) = 0;
-            virtual uint get_size() const = 0;
+            virtual size_t get_size() const = 0;
     };
     
     // Lower level jpeg_encoder class - useful if more control is needed than the above helper functions.
@@ -119,8 +121,8 @@ namespace jpge
             void emit_dhts();
             void emit_sos();
 
-            void compute_quant_table(int32 *dst, const int16 *src);
             void load_quantized_coefficients(int component_num);
+            void load_quantized_coefficients_aan(int component_num);
 
             void load_block_8_8_grey(int x);
             void load_block_8_8(int x, int y, int c);
@@ -0,0 +1,29 @@
+#ifndef _CONVERSIONS_JPGE_BLOCK_H_
+#define _CONVERSIONS_JPGE_BLOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Forward DCT and quantization of one 8x8 block, as the JPEG encoder does it
+ *
+ * Both DCT paths are built regardless of CONFIG_CAMERA_JPEG_ENCODER_FAST_DCT, so that
+ * tests can compare them.
+ *
+ * @param samples       64 level shifted samples (-128..127), row by row
+ * @param quality       Encoder quality, 1..100
+ * @param chroma        Use the chrominance quantization table instead of the luminance one
+ * @param fast          Use the AAN DCT with reciprocal quantization instead of jfdctint
+ * @param coefficients  Output, 64 quantized coefficients in zig-zag order
+ */
+void jpge_quantize_block(const int32_t *samples, int quality, bool chroma, bool fast, int16_t *coefficients);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONVERSIONS_JPGE_BLOCK_H_ */
@@ -0,0 +1,47 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _CONVERSIONS_RGB_H_
+#define _CONVERSIONS_RGB_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Expand a line of RGB565 pixels as sent by the sensor (high byte first)
+ *
+ * @param src    RGB565 data, 2 bytes per pixel
+ * @param dst    Output, 3 bytes per pixel
+ * @param pixels Number of pixels
+ */
+void rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels);
+void rgb565_to_bgr888(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+/**
+ * @brief Swap the first and third byte of every pixel in a 24-bit line
+ *
+ * @param src    Input, 3 bytes per pixel
+ * @param dst    Output, 3 bytes per pixel, may not overlap src
+ * @param pixels Number of pixels
+ */
+void rgb888_swap_rb(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONVERSIONS_RGB_H_ */
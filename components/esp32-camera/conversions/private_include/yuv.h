@@ -18,10 +18,21 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 void yuv2rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t *r, uint8_t *g, uint8_t *b);
 
+/**
+ * @brief Convert a line of YUYV pixels, same results as yuv2rgb() per pixel
+ *
+ * @param src    YUV422 data, Y0 U Y1 V
+ * @param dst    Output, 3 bytes per pixel
+ * @param pixels Number of pixels, an odd last pixel is left untouched
+ */
+void yuv422_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels);
+void yuv422_to_bgr888(const uint8_t *src, uint8_t *dst, size_t pixels);
+
 #ifdef __cplusplus
 }
 #endif
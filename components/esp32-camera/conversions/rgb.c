@@ -0,0 +1,79 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdbool.h>
+#include "rgb.h"
+#include "esp_attr.h"
+
+static inline void rgb565_expand(const uint8_t *src, uint8_t *dst, bool bgr)
+{
+    uint8_t hb = src[0];
+    uint8_t lb = src[1];
+    dst[bgr ? 2 : 0] = hb & 0xF8;
+    dst[1] = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
+    dst[bgr ? 0 : 2] = (lb & 0x1F) << 3;
+}
+
+// Two pixels per iteration keeps the loads of the second pixel off the
+// critical path of the stores of the first.
+static inline void rgb565_to_888(const uint8_t *src, uint8_t *dst, size_t pixels, bool bgr)
+{
+    size_t i = 0;
+    for (; i + 2 <= pixels; i += 2) {
+        rgb565_expand(src, dst, bgr);
+        rgb565_expand(src + 2, dst + 3, bgr);
+        src += 4;
+        dst += 6;
+    }
+    if (i < pixels) {
+        rgb565_expand(src, dst, bgr);
+    }
+}
+
+void IRAM_ATTR rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    rgb565_to_888(src, dst, pixels, false);
+}
+
+void IRAM_ATTR rgb565_to_bgr888(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    rgb565_to_888(src, dst, pixels, true);
+}
+
+static inline void rgb888_swap(const uint8_t *src, uint8_t *dst)
+{
+    uint8_t c0 = src[0];
+    uint8_t c1 = src[1];
+    uint8_t c2 = src[2];
+    dst[0] = c2;
+    dst[1] = c1;
+    dst[2] = c0;
+}
+
+void IRAM_ATTR rgb888_swap_rb(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        rgb888_swap(src, dst);
+        rgb888_swap(src + 3, dst + 3);
+        rgb888_swap(src + 6, dst + 6);
+        rgb888_swap(src + 9, dst + 9);
+        src += 12;
+        dst += 12;
+    }
+    for (; i < pixels; i++) {
+        rgb888_swap(src, dst);
+        src += 3;
+        dst += 3;
+    }
+}
@@ -17,6 +17,7 @@
 #include "soc/efuse_reg.h"
 #include "esp_heap_caps.h"
 #include "yuv.h"
+#include "rgb.h"
 #include "sdkconfig.h"
 #include "jpeg_decoder.h"
 
@@ -31,7 +32,13 @@ static const char* TAG = "to_bmp";
 #endif
 
 static const int BMP_HEADER_LEN = 54;
-static uint8_t work[3100]; // 3.1kB for JPEG decoder, static for legacy reasons
+// Static for legacy reasons. 3.1kB for the ROM JPEG decoder, the TJpgDec copy in esp_jpeg needs up to 3.7kB
+// with two full Huffman table pairs at its default 32-bit optimization level.
+#if CONFIG_JD_USE_ROM
+static uint8_t work[3100];
+#else
+static uint8_t work[4096];
+#endif
 
 typedef struct {
     uint32_t filesize;
@@ -170,16 +177,8 @@ bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint
     } else if(format == PIXFORMAT_RGB888) {
         memcpy(rgb_buf, src_buf, src_len);
     } else if(format == PIXFORMAT_RGB565) {
-        int i;
-        uint8_t hb, lb;
         pix_count = src_len / 2;
-        for(i=0; i<pix_count; i++) {
-            hb = *src_buf++;
-            lb = *src_buf++;
-            *rgb_buf++ = (lb & 0x1F) << 3;
-            *rgb_buf++ = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
-            *rgb_buf++ = hb & 0xF8;
-        }
+        rgb565_to_bgr888(src_buf, rgb_buf, pix_count);
     } else if(format == PIXFORMAT_GRAYSCALE) {
         int i;
         uint8_t b;
@@ -192,25 +191,7 @@ bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint
         }
     } else if(format == PIXFORMAT_YUV422) {
         pix_count = src_len / 2;
-        int i, maxi = pix_count / 2;
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        for(i=0; i<maxi; i++) {
-            y0 = *src_buf++;
-            u = *src_buf++;
-            y1 = *src_buf++;
-            v = *src_buf++;
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            *rgb_buf++ = b;
-            *rgb_buf++ = g;
-            *rgb_buf++ = r;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            *rgb_buf++ = b;
-            *rgb_buf++ = g;
-            *rgb_buf++ = r;
-        }
+        yuv422_to_bgr888(src_buf, rgb_buf, pix_count);
     }
     return true;
 }
@@ -234,7 +215,7 @@ bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
     size_t out_size = (pix_count * bpp) + BMP_HEADER_LEN + palette_size;
     uint8_t * out_buf = (uint8_t *)_malloc(out_size);
     if(!out_buf) {
-        ESP_LOGE(TAG, "_malloc failed! %u", out_size);
+        ESP_LOGE(TAG, "_malloc failed! %zu", out_size);
         return false;
     }
 
@@ -277,37 +258,11 @@ bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
     if(format == PIXFORMAT_RGB888) {
         memcpy(pix_buf, src_buf, pix_count*3);
     } else if(format == PIXFORMAT_RGB565) {
-        int i;
-        uint8_t hb, lb;
-        for(i=0; i<pix_count; i++) {
-            hb = *src_buf++;
-            lb = *src_buf++;
-            *pix_buf++ = (lb & 0x1F) << 3;
-            *pix_buf++ = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
-            *pix_buf++ = hb & 0xF8;
-        }
+        rgb565_to_bgr888(src_buf, pix_buf, pix_count);
     } else if(format == PIXFORMAT_GRAYSCALE) {
         memcpy(pix_buf, src_buf, pix_count);
     } else if(format == PIXFORMAT_YUV422) {
-        int i, maxi = pix_count / 2;
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        for(i=0; i<maxi; i++) {
-            y0 = *src_buf++;
-            u = *src_buf++;
-            y1 = *src_buf++;
-            v = *src_buf++;
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            *pix_buf++ = b;
-            *pix_buf++ = g;
-            *pix_buf++ = r;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            *pix_buf++ = b;
-            *pix_buf++ = g;
-            *pix_buf++ = r;
-        }
+        yuv422_to_bgr888(src_buf, pix_buf, pix_count);
     }
     *out = out_buf;
     *out_len = out_size;
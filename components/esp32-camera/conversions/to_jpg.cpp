@@ -20,6 +20,7 @@
 #include "img_converters.h"
 #include "jpge.h"
 #include "yuv.h"
+#include "rgb.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -45,46 +46,14 @@ static void *_malloc(size_t size)
 
 static IRAM_ATTR void convert_line_format(uint8_t * src, pixformat_t format, uint8_t * dst, size_t width, size_t in_channels, size_t line)
 {
-    int i=0, o=0, l=0;
     if(format == PIXFORMAT_GRAYSCALE) {
         memcpy(dst, src + line * width, width);
     } else if(format == PIXFORMAT_RGB888) {
-        l = width * 3;
-        src += l * line;
-        for(i=0; i<l; i+=3) {
-            dst[o++] = src[i+2];
-            dst[o++] = src[i+1];
-            dst[o++] = src[i];
-        }
+        rgb888_swap_rb(src + line * width * 3, dst, width);
     } else if(format == PIXFORMAT_RGB565) {
-        l = width * 2;
-        src += l * line;
-        for(i=0; i<l; i+=2) {
-            dst[o++] = src[i] & 0xF8;
-            dst[o++] = (src[i] & 0x07) << 5 | (src[i+1] & 0xE0) >> 3;
-            dst[o++] = (src[i+1] & 0x1F) << 3;
-        }
+        rgb565_to_rgb888(src + line * width * 2, dst, width);
     } else if(format == PIXFORMAT_YUV422) {
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        l = width * 2;
-        src += l * line;
-        for(i=0; i<l; i+=4) {
-            y0 = src[i];
-            u = src[i+1];
-            y1 = src[i+2];
-            v = src[i+3];
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            dst[o++] = r;
-            dst[o++] = g;
-            dst[o++] = b;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            dst[o++] = r;
-            dst[o++] = g;
-            dst[o++] = b;
-        }
+        yuv422_to_rgb888(src + line * width * 2, dst, width);
     }
 }
 
@@ -150,8 +119,10 @@ public:
     virtual ~callback_stream() { }
     virtual bool put_buf(const void* data, int len)
     {
-        index += ocb(oarg, index, data, len);
-        return true;
+        size_t written = ocb(oarg, index, data, len);
+        index += written;
+        // a short write aborts the encoder, e.g. when the receiving socket was closed
+        return written == (size_t)len;
     }
     virtual size_t get_size() const
     {
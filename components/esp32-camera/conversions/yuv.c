@@ -11,6 +11,7 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <stdbool.h>
 #include "yuv.h"
 #include "esp_attr.h"
 
@@ -296,3 +297,44 @@ void IRAM_ATTR yuv2rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t *r, uint8_t *g,
     *g = YUYV_CONSTRAIN(gi);
     *b = YUYV_CONSTRAIN(bi);
 }
+
+static inline uint8_t yuv_constrain(int16_t v)
+{
+    return YUYV_CONSTRAIN(v);
+}
+
+// Both pixels of a YUYV pair share the chroma terms, so they are looked up once per pair.
+// Sums are the same as in yuv2rgb(), the output is bit-exact.
+static inline void yuv422_to_888(const uint8_t *src, uint8_t *dst, size_t pixels, bool bgr)
+{
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    for (size_t i = 0; i < pixels / 2; i++) {
+        const yuv_table_row *u = &yuv_table[src[1]];
+        const yuv_table_row *v = &yuv_table[src[3]];
+        int16_t r = v->vVr;
+        int16_t g = u->vUg + v->vVg;
+        int16_t b = u->vUb;
+        int16_t y0 = yuv_table[src[0]].vY;
+        int16_t y1 = yuv_table[src[2]].vY;
+
+        dst[ri] = yuv_constrain(y0 + r);
+        dst[1] = yuv_constrain(y0 + g);
+        dst[bi] = yuv_constrain(y0 + b);
+        dst[3 + ri] = yuv_constrain(y1 + r);
+        dst[4] = yuv_constrain(y1 + g);
+        dst[3 + bi] = yuv_constrain(y1 + b);
+        src += 4;
+        dst += 6;
+    }
+}
+
+void IRAM_ATTR yuv422_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    yuv422_to_888(src, dst, pixels, false);
+}
+
+void IRAM_ATTR yuv422_to_bgr888(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    yuv422_to_888(src, dst, pixels, true);
+}
@@ -18,6 +18,7 @@
 #include "esp_heap_caps.h"
 #include "ll_cam.h"
 #include "cam_hal.h"
+#include "cam_jpeg.h"
 
 #if (ESP_IDF_VERSION_MAJOR == 3) && (ESP_IDF_VERSION_MINOR == 3)
 #include "rom/ets_sys.h"
@@ -39,37 +40,86 @@
 #define CAM_TASK_STACK             (2*1024)
 #endif
 
+#define CAM_TAKE_RETRY_MAX         4
+
 static const char *TAG = "cam_hal";
 static cam_obj_t *cam_obj = NULL;
 
-static const uint32_t JPEG_SOI_MARKER = 0xFFD8FF;  // written in little-endian for esp32
+static camera_stats_t cam_stats;
+static portMUX_TYPE cam_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+// The size window and target are updated by cam_task() and by every esp_camera_fb_get() caller
+static portMUX_TYPE fb_size_lock = portMUX_INITIALIZER_UNLOCKED;
+static void cam_fb_resize(cam_frame_t *frame, bool shrink);
+#endif
+
+static void IRAM_ATTR cam_stats_drop(camera_drop_reason_t reason)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&cam_stats_lock);
+    cam_stats.drops[reason].count++;
+    cam_stats.drops[reason].last_us = now;
+    portEXIT_CRITICAL_SAFE(&cam_stats_lock);
+}
+
+static int cam_stats_bin(uint32_t value)
+{
+    if (value < 2) {
+        return 0;
+    }
+    int bin = 31 - __builtin_clz(value);
+    return bin < CAMERA_STATS_HIST_BINS ? bin : CAMERA_STATS_HIST_BINS - 1;
+}
+
+static void cam_stats_retry(void)
+{
+    portENTER_CRITICAL(&cam_stats_lock);
+    cam_stats.take_retries++;
+    portEXIT_CRITICAL(&cam_stats_lock);
+}
+
+static void cam_stats_frame(const camera_fb_t *fb, uint32_t latency_ms, bool jpeg)
+{
+    portENTER_CRITICAL(&cam_stats_lock);
+    cam_stats.frames++;
+    cam_stats.latency_hist[cam_stats_bin(latency_ms)]++;
+    if (latency_ms > cam_stats.latency_max_ms) {
+        cam_stats.latency_max_ms = latency_ms;
+    }
+    if (jpeg) {
+        cam_stats.jpeg_size_hist[cam_stats_bin(fb->len / 1024)]++;
+        if (fb->len > cam_stats.jpeg_size_max) {
+            cam_stats.jpeg_size_max = fb->len;
+        }
+    }
+    portEXIT_CRITICAL(&cam_stats_lock);
+}
+
 static const uint16_t JPEG_EOI_MARKER = 0xD9FF;  // written in little-endian for esp32
 
 static int cam_verify_jpeg_soi(const uint8_t *inbuf, uint32_t length)
 {
-    for (uint32_t i = 0; i < length; i++) {
-        if (memcmp(&inbuf[i], &JPEG_SOI_MARKER, 3) == 0) {
-            //ESP_LOGW(TAG, "SOI: %d", (int) i);
-            return i;
-        }
+    int offset = cam_jpeg_find_soi(inbuf, length);
+    if (offset < 0) {
+        ESP_LOGW(TAG, "NO-SOI");
+        cam_stats_drop(CAMERA_DROP_NO_SOI);
     }
-    ESP_LOGW(TAG, "NO-SOI");
-    return -1;
+    return offset;
 }
 
 static int cam_verify_jpeg_eoi(const uint8_t *inbuf, uint32_t length)
 {
-    int offset = -1;
-    uint8_t *dptr = (uint8_t *)inbuf + length - 2;
-    while (dptr > inbuf) {
-        if (memcmp(dptr, &JPEG_EOI_MARKER, 2) == 0) {
-            offset = dptr - inbuf;
-            //ESP_LOGW(TAG, "EOI: %d", length - (offset + 2));
-            return offset;
+    return cam_jpeg_find_eoi(inbuf, length);
+}
+
+static cam_frame_t *cam_get_frame(const camera_fb_t *fb)
+{
+    for (int x = 0; x < cam_obj->frame_cnt; x++) {
+        if (&cam_obj->frames[x].fb == fb) {
+            return &cam_obj->frames[x];
         }
-        dptr--;
     }
-    return -1;
+    return NULL;
 }
 
 static bool cam_get_next_frame(int * frame_pos)
@@ -90,6 +140,12 @@ static bool cam_get_next_frame(int * frame_pos)
 static bool cam_start_frame(int * frame_pos)
 {
     if (cam_get_next_frame(frame_pos)) {
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+        // a free frame kept its size from before an overflow or a frame size change
+        if (cam_obj->fb_adaptive) {
+            cam_fb_resize(&cam_obj->frames[*frame_pos], false);
+        }
+#endif
         if(ll_cam_start(cam_obj, *frame_pos)){
             // Vsync the frame manually
             ll_cam_do_vsync(cam_obj);
@@ -107,6 +163,7 @@ void IRAM_ATTR ll_cam_send_event(cam_obj_t *cam, cam_event_t cam_event, BaseType
     if (xQueueSendFromISR(cam->event_queue, (void *)&cam_event, HPTaskAwoken) != pdTRUE) {
         ll_cam_stop(cam);
         cam->state = CAM_STATE_IDLE;
+        cam_stats_drop(CAMERA_DROP_EV_OVF);
         ESP_CAMERA_ETS_PRINTF(DRAM_STR("cam_hal: EV-%s-OVF\r\n"), cam_event==CAM_IN_SUC_EOF_EVENT ? DRAM_STR("EOF") : DRAM_STR("VSYNC"));
     }
 }
@@ -144,8 +201,14 @@ static void cam_task(void *arg)
 
                 if (cam_event == CAM_IN_SUC_EOF_EVENT) {
                     if(!cam_obj->psram_mode){
-                        if (cam_obj->fb_size < (frame_buffer_event->len + pixels_per_dma)) {
+                        if (cam_obj->frames[frame_pos].size < (frame_buffer_event->len + pixels_per_dma)) {
                             ESP_LOGW(TAG, "FB-OVF");
+                            cam_stats_drop(CAMERA_DROP_FB_OVF);
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+                            if (cam_obj->fb_adaptive) {
+                                cam_fb_overflow();
+                            }
+#endif
                             ll_cam_stop(cam_obj);
                             DBG_PIN_SET(0);
                             continue;
@@ -169,8 +232,14 @@ static void cam_task(void *arg)
                     if (cnt || !cam_obj->jpeg_mode || cam_obj->psram_mode) {
                         if (cam_obj->jpeg_mode) {
                             if (!cam_obj->psram_mode) {
-                                if (cam_obj->fb_size < (frame_buffer_event->len + pixels_per_dma)) {
+                                if (cam_obj->frames[frame_pos].size < (frame_buffer_event->len + pixels_per_dma)) {
                                     ESP_LOGW(TAG, "FB-OVF");
+                                    cam_stats_drop(CAMERA_DROP_FB_OVF);
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+                                    if (cam_obj->fb_adaptive) {
+                                        cam_fb_overflow();
+                                    }
+#endif
                                     cnt--;
                                 } else {
                                     frame_buffer_event->len += ll_cam_memcpy(cam_obj,
@@ -194,6 +263,7 @@ static void cam_task(void *arg)
                             if (frame_buffer_event->len != cam_obj->fb_size) {
                                 cam_obj->frames[frame_pos].en = 1;
                                 ESP_LOGE(TAG, "FB-SIZE: %u != %u", frame_buffer_event->len, (unsigned) cam_obj->fb_size);
+                                cam_stats_drop(CAMERA_DROP_FB_SIZE);
                             }
                         }
                         //send frame
@@ -205,6 +275,7 @@ static void cam_task(void *arg)
                                 if (xQueueSend(cam_obj->frame_buffer_queue, (void *)&frame_buffer_event, 0) != pdTRUE) {
                                     cam_obj->frames[frame_pos].en = 1;
                                     ESP_LOGE(TAG, "FBQ-SND");
+                                    cam_stats_drop(CAMERA_DROP_FBQ_SND);
                                 }
                                 //free the popped buffer
                                 cam_give(fb2);
@@ -212,6 +283,7 @@ static void cam_task(void *arg)
                                 //queue is full and we could not pop a frame from it
                                 cam_obj->frames[frame_pos].en = 1;
                                 ESP_LOGE(TAG, "FBQ-RCV");
+                                cam_stats_drop(CAMERA_DROP_FBQ_RCV);
                             }
                         }
                     }
@@ -249,6 +321,136 @@ static lldesc_t * allocate_dma_descriptors(uint32_t count, uint16_t size, uint8_
     return dma;
 }
 
+static uint8_t *cam_alloc_fb(size_t size)
+{
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
+    // In IDF v4.2 and earlier, memory returned by heap_caps_aligned_alloc must be freed using heap_caps_aligned_free.
+    // And heap_caps_aligned_free is deprecated on v4.3.
+    return (uint8_t *)heap_caps_aligned_alloc(16, size, cam_obj->fb_caps);
+#else
+    return (uint8_t *)heap_caps_malloc(size, cam_obj->fb_caps);
+#endif
+}
+
+// Points the frame at buf, moved forward to the DMA alignment in PSRAM mode. buf must have been
+// allocated fb_dma_align bytes larger than the frame.
+static void cam_align_fb(cam_frame_t *frame, uint8_t *buf)
+{
+    frame->fb_offset = 0;
+    if (cam_obj->psram_mode) {
+        frame->fb_offset = cam_obj->fb_dma_align - ((uint32_t)buf & (cam_obj->fb_dma_align - 1));
+    }
+    frame->fb.buf = buf + frame->fb_offset;
+}
+
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+static size_t cam_fb_saved_bytes(void)
+{
+    size_t saved = 0;
+    for (int x = 0; x < cam_obj->frame_cnt; x++) {
+        saved += cam_obj->fb_size - cam_obj->frames[x].size;
+    }
+    return saved;
+}
+
+// Called from cam_take() with the length of every complete JPEG frame
+static void cam_fb_record_size(size_t len)
+{
+    uint32_t sizes[CAM_JPEG_SIZE_WINDOW];
+    portENTER_CRITICAL(&fb_size_lock);
+    cam_obj->jpeg_sizes[cam_obj->jpeg_size_pos] = len;
+    cam_obj->jpeg_size_pos = (cam_obj->jpeg_size_pos + 1) % CAM_JPEG_SIZE_WINDOW;
+    if (cam_obj->jpeg_size_cnt < CAM_JPEG_SIZE_WINDOW) {
+        cam_obj->jpeg_size_cnt++;
+    }
+    size_t n = cam_obj->jpeg_size_cnt;
+    uint32_t gen = cam_obj->jpeg_size_gen;
+    if (n >= CAM_JPEG_SIZE_MIN_SAMPLES) {
+        memcpy(sizes, cam_obj->jpeg_sizes, n * sizeof(sizes[0]));
+    }
+    portEXIT_CRITICAL(&fb_size_lock);
+    if (n < CAM_JPEG_SIZE_MIN_SAMPLES) {
+        return;
+    }
+
+    // sorted outside the critical section, on the copy
+    uint32_t sorted[CAM_JPEG_SIZE_WINDOW];
+    for (size_t i = 0; i < n; i++) {
+        uint32_t v = sizes[i];
+        size_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = v;
+    }
+    size_t idx = (n * CONFIG_CAMERA_JPEG_ADAPTIVE_PERCENTILE + 99) / 100;
+    idx = idx ? idx - 1 : 0;
+    size_t target = sorted[idx] + sorted[idx] * CONFIG_CAMERA_JPEG_ADAPTIVE_MARGIN / 100;
+
+    // frames are copied in half DMA buffer steps and one step must always fit on top
+    size_t step = cam_obj->dma_half_buffer_size;
+    target = (target + step - 1) / step * step + step;
+    if (target > cam_obj->fb_size) {
+        target = cam_obj->fb_size;
+    }
+    portENTER_CRITICAL(&fb_size_lock);
+    // an overflow since the copy restarted the learning, its full size target stays
+    if (gen == cam_obj->jpeg_size_gen) {
+        cam_obj->fb_target = target;
+    }
+    portEXIT_CRITICAL(&fb_size_lock);
+}
+
+// Called from cam_task() when a frame did not fit, and from cam_fb_size_reset(): go back to
+// full size and learn again
+static void cam_fb_overflow(void)
+{
+    portENTER_CRITICAL(&fb_size_lock);
+    cam_obj->fb_target = cam_obj->fb_size;
+    // the window is read from the start while it fills up
+    cam_obj->jpeg_size_pos = 0;
+    cam_obj->jpeg_size_cnt = 0;
+    cam_obj->jpeg_size_gen++;
+    portEXIT_CRITICAL(&fb_size_lock);
+}
+
+// Called when a frame is handed back, before cam_task() can use it again, and by cam_task()
+// for a free frame that is too small for the target. Only that context owns the frame, so the
+// buffer itself needs no lock.
+static void cam_fb_resize(cam_frame_t *frame, bool shrink)
+{
+    portENTER_CRITICAL(&fb_size_lock);
+    size_t target = cam_obj->fb_target;
+    portEXIT_CRITICAL(&fb_size_lock);
+    if (target == frame->size || (target < frame->size && !shrink)) {
+        return;
+    }
+    // grow right away, shrink only when it frees a meaningful amount
+    if (target < frame->size && frame->size - target < frame->size / 8) {
+        return;
+    }
+    uint8_t *buf = cam_alloc_fb(target + cam_obj->fb_dma_align);
+    if (buf == NULL) {
+        ESP_LOGW(TAG, "Frame buffer resize to %u failed", (unsigned) target);
+        return;
+    }
+    free(frame->fb.buf - frame->fb_offset);
+    cam_align_fb(frame, buf);
+    ESP_LOGI(TAG, "Frame buffer resized %u -> %u, %u bytes saved", (unsigned) frame->size, (unsigned) target,
+             (unsigned) (cam_obj->fb_size - target));
+    frame->size = target;
+}
+#endif
+
+void cam_fb_size_reset(void)
+{
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+    if (cam_obj && cam_obj->fb_adaptive) {
+        cam_fb_overflow();
+    }
+#endif
+}
+
 static esp_err_t cam_dma_config(const camera_config_t *config)
 {
     bool ret = ll_cam_dma_sizes(cam_obj);
@@ -273,6 +475,7 @@ static esp_err_t cam_dma_config(const camera_config_t *config)
     size_t fb_size = cam_obj->fb_size;
     if (cam_obj->psram_mode) {
         dma_align = ll_cam_get_dma_align(cam_obj);
+        cam_obj->fb_dma_align = dma_align;
         if (cam_obj->fb_size < cam_obj->recv_size) {
             fb_size = cam_obj->recv_size;
         }
@@ -280,29 +483,27 @@ static esp_err_t cam_dma_config(const camera_config_t *config)
 
     /* Allocate memory for frame buffer */
     size_t alloc_size = fb_size * sizeof(uint8_t) + dma_align;
-    uint32_t _caps = MALLOC_CAP_8BIT;
+    cam_obj->fb_caps = MALLOC_CAP_8BIT;
     if (CAMERA_FB_IN_DRAM == config->fb_location) {
-        _caps |= MALLOC_CAP_INTERNAL;
+        cam_obj->fb_caps |= MALLOC_CAP_INTERNAL;
     } else {
-        _caps |= MALLOC_CAP_SPIRAM;
+        cam_obj->fb_caps |= MALLOC_CAP_SPIRAM;
     }
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+    // with DMA straight into the frame buffers the descriptors are tied to the allocation
+    cam_obj->fb_adaptive = cam_obj->jpeg_mode && !cam_obj->psram_mode;
+    cam_obj->fb_target = cam_obj->fb_size;
+#endif
     for (int x = 0; x < cam_obj->frame_cnt; x++) {
         cam_obj->frames[x].dma = NULL;
         cam_obj->frames[x].fb_offset = 0;
         cam_obj->frames[x].en = 0;
-        ESP_LOGI(TAG, "Allocating %d Byte frame buffer in %s", alloc_size, _caps & MALLOC_CAP_SPIRAM ? "PSRAM" : "OnBoard RAM");
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
-        // In IDF v4.2 and earlier, memory returned by heap_caps_aligned_alloc must be freed using heap_caps_aligned_free.
-        // And heap_caps_aligned_free is deprecated on v4.3.
-        cam_obj->frames[x].fb.buf = (uint8_t *)heap_caps_aligned_alloc(16, alloc_size, _caps);
-#else
-        cam_obj->frames[x].fb.buf = (uint8_t *)heap_caps_malloc(alloc_size, _caps);
-#endif
-        CAM_CHECK(cam_obj->frames[x].fb.buf != NULL, "frame buffer malloc failed", ESP_FAIL);
+        cam_obj->frames[x].size = fb_size;
+        ESP_LOGI(TAG, "Allocating %d Byte frame buffer in %s", alloc_size, cam_obj->fb_caps & MALLOC_CAP_SPIRAM ? "PSRAM" : "OnBoard RAM");
+        uint8_t *buf = cam_alloc_fb(alloc_size);
+        CAM_CHECK(buf != NULL, "frame buffer malloc failed", ESP_FAIL);
+        cam_align_fb(&cam_obj->frames[x], buf);
         if (cam_obj->psram_mode) {
-            //align PSRAM buffer. TODO: save the offset so proper address can be freed later
-            cam_obj->frames[x].fb_offset = dma_align - ((uint32_t)cam_obj->frames[x].fb.buf & (dma_align - 1));
-            cam_obj->frames[x].fb.buf += cam_obj->frames[x].fb_offset;
             ESP_LOGI(TAG, "Frame[%d]: Offset: %u, Addr: 0x%08X", x, cam_obj->frames[x].fb_offset, (unsigned) cam_obj->frames[x].fb.buf);
             cam_obj->frames[x].dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->frames[x].fb.buf);
             CAM_CHECK(cam_obj->frames[x].dma != NULL, "frame dma malloc failed", ESP_FAIL);
@@ -478,56 +679,99 @@ camera_fb_t *cam_take(TickType_t timeout)
 {
     camera_fb_t *dma_buffer = NULL;
     TickType_t start = xTaskGetTickCount();
-    xQueueReceive(cam_obj->frame_buffer_queue, (void *)&dma_buffer, timeout);
+    int64_t start_us = esp_timer_get_time();
+    TickType_t remaining = timeout;
+
+    for (int retries = 0; retries <= CAM_TAKE_RETRY_MAX; retries++) {
+        if (retries) {
+            cam_stats_retry();
+        }
+        dma_buffer = NULL;
+        xQueueReceive(cam_obj->frame_buffer_queue, (void *)&dma_buffer, remaining);
 #if CONFIG_IDF_TARGET_ESP32S3
-    // Currently (22.01.2024) there is a bug in ESP-IDF v5.2, that causes
-    // GDMA to fall into a strange state if it is running while WiFi STA is connecting.
-    // This code tries to reset GDMA if frame is not received, to try and help with
-    // this case. It is possible to have some side effects too, though none come to mind
-    if (!dma_buffer) {
-        ll_cam_dma_reset(cam_obj);
-        xQueueReceive(cam_obj->frame_buffer_queue, (void *)&dma_buffer, timeout);
-    }
+        // Currently (22.01.2024) there is a bug in ESP-IDF v5.2, that causes
+        // GDMA to fall into a strange state if it is running while WiFi STA is connecting.
+        // This code tries to reset GDMA if frame is not received, to try and help with
+        // this case. It is possible to have some side effects too, though none come to mind
+        if (!dma_buffer) {
+            ll_cam_dma_reset(cam_obj);
+            xQueueReceive(cam_obj->frame_buffer_queue, (void *)&dma_buffer, remaining);
+        }
 #endif
-    if (dma_buffer) {
+        if (!dma_buffer) {
+            ESP_LOGW(TAG, "Failed to get the frame on time!");
+// #if CONFIG_IDF_TARGET_ESP32S3
+//             ll_cam_dma_print_state(cam_obj);
+// #endif
+            break;
+        }
         if(cam_obj->jpeg_mode){
             // find the end marker for JPEG. Data after that can be discarded
             int offset_e = cam_verify_jpeg_eoi(dma_buffer->buf, dma_buffer->len);
-            if (offset_e >= 0) {
-                // adjust buffer length
-                dma_buffer->len = offset_e + sizeof(JPEG_EOI_MARKER);
-                return dma_buffer;
-            } else {
+            if (offset_e < 0) {
                 ESP_LOGW(TAG, "NO-EOI");
+                cam_stats_drop(CAMERA_DROP_NO_EOI);
                 cam_give(dma_buffer);
+                // frames came in time, these are NO-EOI drops and not a timeout
                 TickType_t ticks_spent = xTaskGetTickCount() - start;
                 if (ticks_spent >= timeout) {
                     return NULL; /* We are out of time */
                 }
-                return cam_take(timeout - ticks_spent);//recurse!!!!
+                if (retries == CAM_TAKE_RETRY_MAX) {
+                    ESP_LOGW(TAG, "NO-EOI in %d frames, giving up", retries + 1);
+                    return NULL;
+                }
+                remaining = timeout - ticks_spent;
+                continue;
+            }
+            // adjust buffer length
+            dma_buffer->len = offset_e + sizeof(JPEG_EOI_MARKER);
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+            if (cam_obj->fb_adaptive) {
+                cam_fb_record_size(dma_buffer->len);
             }
+#endif
         } else if(cam_obj->psram_mode && cam_obj->in_bytes_per_pixel != cam_obj->fb_bytes_per_pixel){
             //currently this is used only for YUV to GRAYSCALE
             dma_buffer->len = ll_cam_memcpy(cam_obj, dma_buffer->buf, dma_buffer->buf, dma_buffer->len);
         }
+        cam_stats_frame(dma_buffer, (esp_timer_get_time() - start_us) / 1000, cam_obj->jpeg_mode);
         return dma_buffer;
-    } else {
-        ESP_LOGW(TAG, "Failed to get the frame on time!");
-// #if CONFIG_IDF_TARGET_ESP32S3
-//         ll_cam_dma_print_state(cam_obj);
-// #endif
     }
+    cam_stats_drop(CAMERA_DROP_TIMEOUT);
     return NULL;
 }
 
 void cam_give(camera_fb_t *dma_buffer)
 {
-    for (int x = 0; x < cam_obj->frame_cnt; x++) {
-        if (&cam_obj->frames[x].fb == dma_buffer) {
-            cam_obj->frames[x].en = 1;
-            break;
-        }
+    cam_frame_t *frame = cam_get_frame(dma_buffer);
+    if (!frame) {
+        return;
     }
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+    // also for frames cam_task() evicts from a full queue, with GRAB_LATEST these may never
+    // reach a caller and would otherwise keep their old size after an overflow
+    if (cam_obj->fb_adaptive) {
+        cam_fb_resize(frame, true);
+    }
+#endif
+    frame->en = 1;
+}
+
+void cam_flush(void)
+{
+    camera_fb_t *fb = NULL;
+    while (xQueueReceive(cam_obj->frame_buffer_queue, (void *)&fb, 0) == pdTRUE) {
+        cam_give(fb);
+    }
+    xQueueReset(cam_obj->event_queue);
+    cam_obj->state = CAM_STATE_IDLE;
+}
+
+bool cam_wait_frame(TickType_t timeout)
+{
+    camera_fb_t *fb = NULL;
+    return xQueuePeek(cam_obj->frame_buffer_queue, (void *)&fb, timeout) == pdTRUE;
 }
 
 void cam_give_all(void) {
@@ -539,4 +783,42 @@ void cam_give_all(void) {
 bool cam_get_available_frames(void)
 {
     return 0 < uxQueueMessagesWaiting(cam_obj->frame_buffer_queue);
+}
+
+void cam_get_stats(camera_stats_t *stats)
+{
+    portENTER_CRITICAL(&cam_stats_lock);
+    *stats = cam_stats;
+    portEXIT_CRITICAL(&cam_stats_lock);
+    stats->fb_bytes = 0;
+    stats->fb_bytes_saved = 0;
+    if (cam_obj && cam_obj->frames) {
+        for (int x = 0; x < cam_obj->frame_cnt; x++) {
+            stats->fb_bytes += cam_obj->frames[x].size;
+        }
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+        if (cam_obj->fb_adaptive) {
+            stats->fb_bytes_saved = cam_fb_saved_bytes();
+        }
+#endif
+    }
+}
+
+void cam_reset_stats(void)
+{
+    portENTER_CRITICAL(&cam_stats_lock);
+    memset(&cam_stats, 0, sizeof(cam_stats));
+    portEXIT_CRITICAL(&cam_stats_lock);
+}
+
+esp_err_t cam_get_jpeg_info(const camera_fb_t *fb, camera_jpeg_info_t *info)
+{
+    if (!cam_get_frame(fb) || !cam_obj->jpeg_mode || fb->len < sizeof(JPEG_EOI_MARKER)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // parsed on request only, cam_take() cut the frame right after the EOI marker
+    if (!cam_jpeg_parse_segments(fb->buf, fb->len - sizeof(JPEG_EOI_MARKER), info)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
 }
\ No newline at end of file
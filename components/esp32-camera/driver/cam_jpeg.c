@@ -0,0 +1,140 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <string.h>
+#include "cam_jpeg.h"
+
+#define JPEG_MARKER_SOS 0xDA
+
+// Non-zero if any byte of w is 0xFF. Exact for the word as a whole,
+// the individual bytes still have to be checked to find which one it is.
+static inline uint32_t word_has_ff(uint32_t w)
+{
+    uint32_t x = ~w;
+    return (x - 0x01010101UL) & ~x & 0x80808080UL;
+}
+
+static inline uint32_t load_word(const uint8_t *p)
+{
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+static inline bool is_soi(const uint8_t *p)
+{
+    return p[0] == 0xFF && p[1] == 0xD8 && p[2] == 0xFF;
+}
+
+static inline bool is_eoi(const uint8_t *p)
+{
+    return p[0] == 0xFF && p[1] == 0xD9;
+}
+
+int cam_jpeg_find_soi(const uint8_t *inbuf, uint32_t length)
+{
+    if (length < 3) {
+        return -1;
+    }
+    const uint32_t last = length - 3;
+    uint32_t i = 0;
+
+    while (i <= last && ((uintptr_t)(inbuf + i) & 3)) {
+        if (is_soi(&inbuf[i])) {
+            return i;
+        }
+        i++;
+    }
+    for (; i + 3 <= last; i += 4) {
+        if (word_has_ff(load_word(&inbuf[i]))) {
+            for (uint32_t j = i; j < i + 4; j++) {
+                if (is_soi(&inbuf[j])) {
+                    return j;
+                }
+            }
+        }
+    }
+    for (; i <= last; i++) {
+        if (is_soi(&inbuf[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int cam_jpeg_find_eoi(const uint8_t *inbuf, uint32_t length)
+{
+    if (length < 3) {
+        return -1;
+    }
+    // candidates run from length - 2 down to 1, offset 0 is where SOI lives
+    uint32_t i = length - 2;
+
+    while (i >= 1 && ((uintptr_t)(inbuf + i + 1) & 3)) {
+        if (is_eoi(&inbuf[i])) {
+            return i;
+        }
+        i--;
+    }
+    for (; i >= 4; i -= 4) {
+        if (word_has_ff(load_word(&inbuf[i - 3]))) {
+            for (uint32_t j = i; j > i - 4; j--) {
+                if (is_eoi(&inbuf[j])) {
+                    return j;
+                }
+            }
+        }
+    }
+    for (; i >= 1; i--) {
+        if (is_eoi(&inbuf[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool cam_jpeg_parse_segments(const uint8_t *inbuf, uint32_t eoi, camera_jpeg_info_t *info)
+{
+    memset(info, 0, sizeof(camera_jpeg_info_t));
+    info->eoi_offset = eoi;
+
+    uint32_t pos = 2;
+    while (pos + 4 <= eoi) {
+        if (inbuf[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = inbuf[pos + 1];
+        if (marker == 0xFF) {
+            pos++; // fill byte
+            continue;
+        }
+        uint16_t len = (inbuf[pos + 2] << 8) | inbuf[pos + 3];
+        if (len < 2) {
+            return false;
+        }
+        if (info->count < CAMERA_JPEG_MAX_SEGMENTS) {
+            camera_jpeg_segment_t *seg = &info->segments[info->count++];
+            seg->marker = marker;
+            seg->offset = pos;
+            seg->length = len;
+        }
+        pos += 2 + len;
+        if (marker == JPEG_MARKER_SOS) {
+            info->scan_offset = pos;
+            return pos <= eoi;
+        }
+    }
+    return false;
+}
@@ -27,6 +27,7 @@
 #include "cam_hal.h"
 #include "esp_camera.h"
 #include "xclk.h"
+#include "esp_timer.h"
 #if CONFIG_OV2640_SUPPORT
 #include "ov2640.h"
 #endif
@@ -84,10 +85,24 @@ static const char *TAG = "camera";
 typedef struct {
     sensor_t sensor;
     camera_fb_t fb;
+    camera_config_t config;
+    bool sleeping;
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+    // the sensor's own setters, wrapped to reset the adaptive frame buffer sizes
+    int (*sensor_set_framesize)(sensor_t *sensor, framesize_t framesize);
+    int (*sensor_set_quality)(sensor_t *sensor, int quality);
+#endif
 } camera_state_t;
 
+typedef struct {
+    camera_model_t model;
+    uint8_t slv_addr;
+} camera_cache_t;
+
 static const char *CAMERA_SENSOR_NVS_KEY = "sensor";
 static const char *CAMERA_PIXFORMAT_NVS_KEY = "pixformat";
+static const char *CAMERA_MODEL_NVS_KEY = "model";
+static const char *CAMERA_ADDR_NVS_KEY = "addr";
 static camera_state_t *s_state = NULL;
 
 #if CONFIG_IDF_TARGET_ESP32S3 // LCD_CAM module of ESP32-S3 will generate xclk
@@ -99,59 +114,85 @@ static camera_state_t *s_state = NULL;
 #endif
 
 typedef struct {
+    camera_model_t model;
     int (*detect)(int slv_addr, sensor_id_t *id);
     int (*init)(sensor_t *sensor);
 } sensor_func_t;
 
 static const sensor_func_t g_sensors[] = {
 #if CONFIG_OV7725_SUPPORT
-    {ov7725_detect, ov7725_init},
+    {CAMERA_OV7725, ov7725_detect, ov7725_init},
 #endif
 #if CONFIG_OV7670_SUPPORT
-    {ov7670_detect, ov7670_init},
+    {CAMERA_OV7670, ov7670_detect, ov7670_init},
 #endif
 #if CONFIG_OV2640_SUPPORT
-    {ov2640_detect, ov2640_init},
+    {CAMERA_OV2640, ov2640_detect, ov2640_init},
 #endif
 #if CONFIG_OV3660_SUPPORT
-    {ov3660_detect, ov3660_init},
+    {CAMERA_OV3660, ov3660_detect, ov3660_init},
 #endif
 #if CONFIG_OV5640_SUPPORT
-    {ov5640_detect, ov5640_init},
+    {CAMERA_OV5640, ov5640_detect, ov5640_init},
 #endif
 #if CONFIG_NT99141_SUPPORT
-    {nt99141_detect, nt99141_init},
+    {CAMERA_NT99141, nt99141_detect, nt99141_init},
 #endif
 #if CONFIG_GC2145_SUPPORT
-    {gc2145_detect, gc2145_init},
+    {CAMERA_GC2145, gc2145_detect, gc2145_init},
 #endif
 #if CONFIG_GC032A_SUPPORT
-    {gc032a_detect, gc032a_init},
+    {CAMERA_GC032A, gc032a_detect, gc032a_init},
 #endif
 #if CONFIG_GC0308_SUPPORT
-    {gc0308_detect, gc0308_init},
+    {CAMERA_GC0308, gc0308_detect, gc0308_init},
 #endif
 #if CONFIG_BF3005_SUPPORT
-    {bf3005_detect, bf3005_init},
+    {CAMERA_BF3005, bf3005_detect, bf3005_init},
 #endif
 #if CONFIG_BF20A6_SUPPORT
-    {bf20a6_detect, bf20a6_init},
+    {CAMERA_BF20A6, bf20a6_detect, bf20a6_init},
 #endif
 #if CONFIG_SC101IOT_SUPPORT
-    {sc101iot_detect, sc101iot_init},
+    {CAMERA_SC101IOT, sc101iot_detect, sc101iot_init},
 #endif
 #if CONFIG_SC030IOT_SUPPORT
-    {sc030iot_detect, sc030iot_init},
+    {CAMERA_SC030IOT, sc030iot_detect, sc030iot_init},
 #endif
 #if CONFIG_SC031GS_SUPPORT
-    {sc031gs_detect, sc031gs_init},
+    {CAMERA_SC031GS, sc031gs_detect, sc031gs_init},
 #endif
 #if CONFIG_MEGA_CCM_SUPPORT
-    {mega_ccm_detect, mega_ccm_init},
+    {CAMERA_MEGA_CCM, mega_ccm_detect, mega_ccm_init},
 #endif
 };
 
-static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out_camera_model)
+static bool camera_attach_cached(const camera_cache_t *cache, camera_model_t *out_camera_model)
+{
+    sensor_id_t *id = &s_state->sensor.id;
+    for (size_t i = 0; i < sizeof(g_sensors) / sizeof(sensor_func_t); i++) {
+        if (g_sensors[i].model != cache->model) {
+            continue;
+        }
+        // a single ID read confirms the cached model, instead of probing every address and sensor
+        if (SCCB_Install_Device(cache->slv_addr) != 0 || !g_sensors[i].detect(cache->slv_addr, id)) {
+            break;
+        }
+        camera_sensor_info_t *info = esp_camera_sensor_get_info(id);
+        if (NULL == info || info->model != cache->model) {
+            break;
+        }
+        s_state->sensor.slv_addr = cache->slv_addr;
+        *out_camera_model = info->model;
+        ESP_LOGI(TAG, "Using cached %s camera at address=0x%02x", info->name, cache->slv_addr);
+        g_sensors[i].init(&s_state->sensor);
+        return true;
+    }
+    ESP_LOGW(TAG, "Cached camera model %d not found, probing", cache->model);
+    return false;
+}
+
+static esp_err_t camera_probe(const camera_config_t *config, const camera_cache_t *cache, camera_model_t *out_camera_model)
 {
     esp_err_t ret = ESP_OK;
     *out_camera_model = CAMERA_NONE;
@@ -209,6 +250,11 @@ static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out
         vTaskDelay(10 / portTICK_PERIOD_MS);
     }
 
+    s_state->sensor.xclk_freq_hz = config->xclk_freq_hz;
+    if (cache != NULL && camera_attach_cached(cache, out_camera_model)) {
+        goto detected;
+    }
+
     ESP_LOGD(TAG, "Searching for camera address");
     vTaskDelay(10 / portTICK_PERIOD_MS);
 
@@ -246,8 +292,9 @@ static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out
         goto err;
     }
 
+detected:
     ESP_LOGI(TAG, "Camera PID=0x%02x VER=0x%02x MIDL=0x%02x MIDH=0x%02x",
-             id->PID, id->VER, id->MIDH, id->MIDL);
+             s_state->sensor.id.PID, s_state->sensor.id.VER, s_state->sensor.id.MIDH, s_state->sensor.id.MIDL);
 
     ESP_LOGD(TAG, "Doing SW reset of sensor");
     vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -275,9 +322,82 @@ static pixformat_t get_output_data_format(camera_conv_mode_t conv_mode)
 }
 #endif
 
-esp_err_t esp_camera_init(const camera_config_t *config)
+static bool camera_load_cache(const char *key, camera_cache_t *cache, camera_status_t *status)
+{
+#if ESP_IDF_VERSION_MAJOR > 3
+    nvs_handle_t handle;
+#else
+    nvs_handle handle;
+#endif
+    if (nvs_open(key, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    uint8_t model = CAMERA_NONE;
+    size_t size = sizeof(camera_status_t);
+    esp_err_t ret = nvs_get_u8(handle, CAMERA_MODEL_NVS_KEY, &model);
+    if (ret == ESP_OK) {
+        ret = nvs_get_u8(handle, CAMERA_ADDR_NVS_KEY, &cache->slv_addr);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_get_blob(handle, CAMERA_SENSOR_NVS_KEY, status, &size);
+    }
+    nvs_close(handle);
+    cache->model = (camera_model_t) model;
+    return ret == ESP_OK && model < CAMERA_MODEL_MAX;
+}
+
+// Frame size, pixel format and quality come from the config, everything else from the snapshot
+static void camera_restore_status(sensor_t *s, const camera_status_t *st)
+{
+    s->set_ae_level(s, st->ae_level);
+    s->set_aec2(s, st->aec2);
+    s->set_aec_value(s, st->aec_value);
+    s->set_agc_gain(s, st->agc_gain);
+    s->set_awb_gain(s, st->awb_gain);
+    s->set_bpc(s, st->bpc);
+    s->set_brightness(s, st->brightness);
+    s->set_colorbar(s, st->colorbar);
+    s->set_contrast(s, st->contrast);
+    s->set_dcw(s, st->dcw);
+    s->set_denoise(s, st->denoise);
+    s->set_exposure_ctrl(s, st->aec);
+    s->set_gain_ctrl(s, st->agc);
+    s->set_gainceiling(s, st->gainceiling);
+    s->set_hmirror(s, st->hmirror);
+    s->set_lenc(s, st->lenc);
+    s->set_raw_gma(s, st->raw_gma);
+    s->set_saturation(s, st->saturation);
+    s->set_sharpness(s, st->sharpness);
+    s->set_special_effect(s, st->special_effect);
+    s->set_vflip(s, st->vflip);
+    s->set_wb_mode(s, st->wb_mode);
+    s->set_whitebal(s, st->awb);
+    s->set_wpc(s, st->wpc);
+}
+
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+// A JPEG frame size learned at one frame size or quality does not hold for another
+static int camera_set_framesize(sensor_t *sensor, framesize_t framesize)
+{
+    cam_fb_size_reset();
+    return s_state->sensor_set_framesize(sensor, framesize);
+}
+
+static int camera_set_quality(sensor_t *sensor, int quality)
+{
+    cam_fb_size_reset();
+    return s_state->sensor_set_quality(sensor, quality);
+}
+#endif
+
+static esp_err_t camera_init(const camera_config_t *config, const char *key)
 {
     esp_err_t err;
+    int64_t start_us = esp_timer_get_time();
+    camera_cache_t cache;
+    camera_status_t cached_status;
+    bool warm = key != NULL && camera_load_cache(key, &cache, &cached_status);
+
     err = cam_init(config);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
@@ -285,11 +405,19 @@ esp_err_t esp_camera_init(const camera_config_t *config)
     }
 
     camera_model_t camera_model = CAMERA_NONE;
-    err = camera_probe(config, &camera_model);
+    err = camera_probe(config, warm ? &cache : NULL, &camera_model);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Camera probe failed with error 0x%x(%s)", err, esp_err_to_name(err));
         goto fail;
     }
+    warm = warm && camera_model == cache.model;
+    s_state->config = *config;
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+    s_state->sensor_set_framesize = s_state->sensor.set_framesize;
+    s_state->sensor.set_framesize = camera_set_framesize;
+    s_state->sensor_set_quality = s_state->sensor.set_quality;
+    s_state->sensor.set_quality = camera_set_quality;
+#endif
 
     framesize_t frame_size = (framesize_t) config->frame_size;
     pixformat_t pix_format = (pixformat_t) config->pixel_format;
@@ -338,9 +466,14 @@ esp_err_t esp_camera_init(const camera_config_t *config)
         s_state->sensor.set_quality(&s_state->sensor, config->jpeg_quality);
     }
     s_state->sensor.init_status(&s_state->sensor);
+    if (warm) {
+        camera_restore_status(&s_state->sensor, &cached_status);
+    }
 
     cam_start();
 
+    ESP_LOGI(TAG, "Camera %s init took %d ms", warm ? "warm" : "cold",
+             (int) ((esp_timer_get_time() - start_us) / 1000));
     return ESP_OK;
 
 fail:
@@ -348,6 +481,19 @@ fail:
     return err;
 }
 
+esp_err_t esp_camera_init(const camera_config_t *config)
+{
+    return camera_init(config, NULL);
+}
+
+esp_err_t esp_camera_init_warm(const camera_config_t *config, const char *key)
+{
+    if (key == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return camera_init(config, key);
+}
+
 esp_err_t esp_camera_deinit()
 {
     esp_err_t ret = cam_deinit();
@@ -369,6 +515,10 @@ camera_fb_t *esp_camera_fb_get()
     if (s_state == NULL) {
         return NULL;
     }
+    if (s_state->sleeping) {
+        ESP_LOGW(TAG, "Camera is sleeping, call esp_camera_wake() first");
+        return NULL;
+    }
     camera_fb_t *fb = cam_take(FB_GET_TIMEOUT);
     //set the frame properties
     if (fb) {
@@ -387,6 +537,31 @@ void esp_camera_fb_return(camera_fb_t *fb)
     cam_give(fb);
 }
 
+esp_err_t esp_camera_get_stats(camera_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cam_get_stats(stats);
+    return ESP_OK;
+}
+
+void esp_camera_reset_stats(void)
+{
+    cam_reset_stats();
+}
+
+esp_err_t esp_camera_fb_get_jpeg_info(const camera_fb_t *fb, camera_jpeg_info_t *info)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fb == NULL || info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return cam_get_jpeg_info(fb, info);
+}
+
 sensor_t *esp_camera_sensor_get()
 {
     if (s_state == NULL) {
@@ -412,9 +587,18 @@ esp_err_t esp_camera_save_to_nvs(const char *key)
                 uint8_t pf = s->pixformat;
                 ret = nvs_set_u8(handle, CAMERA_PIXFORMAT_NVS_KEY, pf);
             }
-            return ret;
+            camera_sensor_info_t *info = esp_camera_sensor_get_info(&s->id);
+            if (ret == ESP_OK && info != NULL) {
+                ret = nvs_set_u8(handle, CAMERA_MODEL_NVS_KEY, info->model);
+            }
+            if (ret == ESP_OK) {
+                ret = nvs_set_u8(handle, CAMERA_ADDR_NVS_KEY, s->slv_addr);
+            }
+            if (ret == ESP_OK) {
+                ret = nvs_commit(handle);
+            }
         } else {
-            return ESP_ERR_CAMERA_NOT_DETECTED;
+            ret = ESP_ERR_CAMERA_NOT_DETECTED;
         }
         nvs_close(handle);
         return ret;
@@ -441,32 +625,9 @@ esp_err_t esp_camera_load_from_nvs(const char *key)
             size_t size = sizeof(camera_status_t);
             ret = nvs_get_blob(handle, CAMERA_SENSOR_NVS_KEY, &st, &size);
             if (ret == ESP_OK) {
-                s->set_ae_level(s, st.ae_level);
-                s->set_aec2(s, st.aec2);
-                s->set_aec_value(s, st.aec_value);
-                s->set_agc_gain(s, st.agc_gain);
-                s->set_awb_gain(s, st.awb_gain);
-                s->set_bpc(s, st.bpc);
-                s->set_brightness(s, st.brightness);
-                s->set_colorbar(s, st.colorbar);
-                s->set_contrast(s, st.contrast);
-                s->set_dcw(s, st.dcw);
-                s->set_denoise(s, st.denoise);
-                s->set_exposure_ctrl(s, st.aec);
+                camera_restore_status(s, &st);
                 s->set_framesize(s, st.framesize);
-                s->set_gain_ctrl(s, st.agc);
-                s->set_gainceiling(s, st.gainceiling);
-                s->set_hmirror(s, st.hmirror);
-                s->set_lenc(s, st.lenc);
                 s->set_quality(s, st.quality);
-                s->set_raw_gma(s, st.raw_gma);
-                s->set_saturation(s, st.saturation);
-                s->set_sharpness(s, st.sharpness);
-                s->set_special_effect(s, st.special_effect);
-                s->set_vflip(s, st.vflip);
-                s->set_wb_mode(s, st.wb_mode);
-                s->set_whitebal(s, st.awb);
-                s->set_wpc(s, st.wpc);
             }
             ret = nvs_get_u8(handle, CAMERA_PIXFORMAT_NVS_KEY, &pf);
             if (ret == ESP_OK) {
@@ -497,3 +658,63 @@ bool esp_camera_available_frames(void)
     }
     return cam_get_available_frames();
 }
+
+esp_err_t esp_camera_sleep(void)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_state->sleeping) {
+        return ESP_OK;
+    }
+    cam_stop();
+    cam_flush();
+
+    sensor_t *s = &s_state->sensor;
+    if (s->set_standby && s->set_standby(s, 1) != 0) {
+        ESP_LOGW(TAG, "Sensor standby failed");
+    }
+    // the sensor keeps its registers in hardware power down as long as DOVDD stays up
+    if (s_state->config.pin_pwdn >= 0) {
+        gpio_set_level(s_state->config.pin_pwdn, 1);
+    }
+    if (s_state->config.pin_xclk >= 0) {
+        CAMERA_DISABLE_OUT_CLOCK();
+    }
+    s_state->sleeping = true;
+    ESP_LOGD(TAG, "Camera sleeping");
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_wake(uint32_t timeout_ms)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!s_state->sleeping) {
+        return ESP_OK;
+    }
+    int64_t start_us = esp_timer_get_time();
+
+    if (s_state->config.pin_xclk >= 0) {
+        CAMERA_ENABLE_OUT_CLOCK(&s_state->config);
+    }
+    if (s_state->config.pin_pwdn >= 0) {
+        gpio_set_level(s_state->config.pin_pwdn, 0);
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+    sensor_t *s = &s_state->sensor;
+    if (s->set_standby && s->set_standby(s, 0) != 0) {
+        ESP_LOGE(TAG, "Sensor failed to leave standby");
+        return ESP_FAIL;
+    }
+    s_state->sleeping = false;
+    cam_start();
+
+    if (timeout_ms && !cam_wait_frame(pdMS_TO_TICKS(timeout_ms))) {
+        ESP_LOGW(TAG, "No frame within %u ms after wake", (unsigned) timeout_ms);
+        return ESP_ERR_TIMEOUT;
+    }
+    ESP_LOGI(TAG, "Camera warm resume took %d ms", (int) ((esp_timer_get_time() - start_us) / 1000));
+    return ESP_OK;
+}
@@ -169,6 +169,70 @@ typedef struct {
     struct timeval timestamp;   /*!< Timestamp since boot of the first DMA buffer of the frame */
 } camera_fb_t;
 
+#define CAMERA_JPEG_MAX_SEGMENTS 16
+
+/**
+ * @brief Position of a JPEG header segment inside a frame buffer
+ */
+typedef struct {
+    uint8_t marker;             /*!< Marker code, the byte following 0xFF */
+    uint32_t offset;            /*!< Offset of the 0xFF byte of the marker */
+    uint16_t length;            /*!< Segment length as stored after the marker, excluding the marker itself */
+} camera_jpeg_segment_t;
+
+/**
+ * @brief Header layout of a JPEG frame, see esp_camera_fb_get_jpeg_info()
+ */
+typedef struct {
+    size_t count;               /*!< Number of valid entries in segments */
+    camera_jpeg_segment_t segments[CAMERA_JPEG_MAX_SEGMENTS]; /*!< Header segments from SOI up to SOS */
+    uint32_t scan_offset;       /*!< Offset of the entropy coded data following SOS */
+    uint32_t eoi_offset;        /*!< Offset of the EOI marker */
+} camera_jpeg_info_t;
+
+/**
+ * @brief Reasons for a frame being dropped or delayed by the driver
+ */
+typedef enum {
+    CAMERA_DROP_FB_OVF,         /*!< JPEG frame did not fit into the frame buffer */
+    CAMERA_DROP_FBQ_SND,        /*!< Frame could not be queued after evicting an older one */
+    CAMERA_DROP_FBQ_RCV,        /*!< Frame queue was full and no frame could be evicted */
+    CAMERA_DROP_FB_SIZE,        /*!< Raw frame length did not match the frame size */
+    CAMERA_DROP_NO_SOI,         /*!< JPEG frame did not start with SOI */
+    CAMERA_DROP_NO_EOI,         /*!< JPEG frame had no EOI, esp_camera_fb_get() retried */
+    CAMERA_DROP_EV_OVF,         /*!< Event queue overflowed in the interrupt handler */
+    CAMERA_DROP_TIMEOUT,        /*!< No frame arrived before the esp_camera_fb_get() timeout */
+    CAMERA_DROP_MAX,
+} camera_drop_reason_t;
+
+#define CAMERA_STATS_HIST_BINS 12
+
+/**
+ * @brief Drop counter for one reason
+ */
+typedef struct {
+    uint32_t count;             /*!< Number of occurrences since boot or the last reset */
+    int64_t last_us;            /*!< esp_timer time of the last occurrence, 0 if none */
+} camera_drop_stats_t;
+
+/**
+ * @brief Frame statistics collected by the driver
+ *
+ * Histogram bin 0 counts values below 2, bin i counts values in [2^i, 2^(i+1)),
+ * the last bin also counts everything larger.
+ */
+typedef struct {
+    uint32_t frames;            /*!< Frames returned by esp_camera_fb_get() */
+    uint32_t take_retries;      /*!< Frames discarded and retried within esp_camera_fb_get() */
+    camera_drop_stats_t drops[CAMERA_DROP_MAX]; /*!< Drop counters, indexed by camera_drop_reason_t */
+    uint32_t latency_hist[CAMERA_STATS_HIST_BINS]; /*!< Time spent in esp_camera_fb_get(), in ms */
+    uint32_t latency_max_ms;    /*!< Longest time spent in esp_camera_fb_get() */
+    uint32_t jpeg_size_hist[CAMERA_STATS_HIST_BINS]; /*!< Size of returned JPEG frames, in KiB */
+    size_t jpeg_size_max;       /*!< Largest JPEG frame returned, in bytes */
+    size_t fb_bytes;            /*!< Memory currently held by the frame buffers */
+    size_t fb_bytes_saved;      /*!< Memory given back by adaptive JPEG frame buffers, compared to the worst case */
+} camera_stats_t;
+
 #define ESP_ERR_CAMERA_BASE 0x20000
 #define ESP_ERR_CAMERA_NOT_DETECTED             (ESP_ERR_CAMERA_BASE + 1)
 #define ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE (ESP_ERR_CAMERA_BASE + 2)
@@ -191,6 +255,21 @@ typedef struct {
  */
 esp_err_t esp_camera_init(const camera_config_t* config);
 
+/**
+ * @brief Initialize the camera driver from settings cached in NVS
+ *
+ * Uses the sensor model and SCCB address stored by esp_camera_save_to_nvs()
+ * to skip probing the bus for every supported sensor, then restores the saved
+ * sensor settings. Frame size, pixel format and JPEG quality are taken from
+ * the config. Falls back to a full probe if the cache is missing or stale.
+ *
+ * @param config  Camera configuration parameters
+ * @param key     The nvs key name the camera settings were saved under
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t esp_camera_init_warm(const camera_config_t* config, const char *key);
+
 /**
  * @brief Deinitialize the camera driver
  *
@@ -214,6 +293,23 @@ camera_fb_t* esp_camera_fb_get(void);
  */
 void esp_camera_fb_return(camera_fb_t * fb);
 
+/**
+ * @brief Get the JPEG header layout of a frame buffer
+ *
+ * Lets callers patch or skip header segments. The header is parsed on each call, frames
+ * are not parsed while they are captured.
+ *
+ * @param fb    Frame buffer obtained from esp_camera_fb_get()
+ * @param info  Filled with the segment offsets
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if fb is not a JPEG frame of this driver
+ *      - ESP_ERR_NOT_FOUND if the header could not be parsed
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ */
+esp_err_t esp_camera_fb_get_jpeg_info(const camera_fb_t *fb, camera_jpeg_info_t *info);
+
 /**
  * @brief Get a pointer to the image sensor control structure
  *
@@ -245,6 +341,49 @@ void esp_camera_return_all(void);
  */
 bool esp_camera_available_frames(void);
 
+/**
+ * @brief Get the frame statistics collected by the driver
+ *
+ * Counters keep running across esp_camera_deinit() and esp_camera_init().
+ *
+ * @param stats  Filled with a snapshot of the counters
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t esp_camera_get_stats(camera_stats_t *stats);
+
+/**
+ * @brief Reset all frame statistics to zero
+ */
+void esp_camera_reset_stats(void);
+
+/**
+ * @brief Stop capturing and put the sensor into standby
+ *
+ * Queued frames are dropped, frames held by the caller stay valid.
+ * The sensor keeps its register contents, so esp_camera_wake() does not
+ * need to reload any register tables.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ */
+esp_err_t esp_camera_sleep(void);
+
+/**
+ * @brief Leave standby and restart capturing
+ *
+ * @param timeout_ms  Maximum time to wait for the first frame, 0 to return immediately
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if no frame arrived within timeout_ms
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ */
+esp_err_t esp_camera_wake(uint32_t timeout_ms);
+
 
 #ifdef __cplusplus
 }
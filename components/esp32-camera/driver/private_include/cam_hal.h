@@ -57,8 +57,46 @@ void cam_give(camera_fb_t *dma_buffer);
 
 void cam_give_all(void);
 
+/**
+ * @brief Drop all queued frames and reset the capture state machine
+ *
+ * Must be called after cam_stop(), so that no new events arrive while flushing.
+ */
+void cam_flush(void);
+
+/**
+ * @brief Wait until a frame is queued without taking it
+ *
+ * @param timeout Maximum time to wait
+ *
+ * @return true if a frame is available
+ */
+bool cam_wait_frame(TickType_t timeout);
+
 bool cam_get_available_frames(void);
 
+/**
+ * @brief Forget the JPEG frame sizes learned for the adaptive frame buffers
+ *
+ * Called when the frame size or the quality changes. The frames grow back to full size and the
+ * sizes are learned again from the new frames. Does nothing without adaptive frame buffers.
+ */
+void cam_fb_size_reset(void);
+
+void cam_get_stats(camera_stats_t *stats);
+
+void cam_reset_stats(void);
+
+/**
+ * @brief Parse the JPEG header layout of a frame returned by cam_take()
+ *
+ * @param fb    Frame buffer returned by cam_take()
+ * @param info  Filled with the segment offsets
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for unknown or non-JPEG frames, ESP_ERR_NOT_FOUND if the header did not parse
+ */
+esp_err_t cam_get_jpeg_info(const camera_fb_t *fb, camera_jpeg_info_t *info);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,63 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Find the JPEG SOI marker (FF D8 FF)
+ *
+ * Scans a word at a time for 0xFF bytes and only compares the marker there.
+ *
+ * @param inbuf  Frame data
+ * @param length Number of valid bytes in inbuf
+ *
+ * @return Offset of the marker, or -1 if there is none
+ */
+int cam_jpeg_find_soi(const uint8_t *inbuf, uint32_t length);
+
+/**
+ * @brief Find the last JPEG EOI marker (FF D9), scanning backwards from the end
+ *
+ * Padding after the marker is skipped a word at a time.
+ *
+ * @param inbuf  Frame data
+ * @param length Number of valid bytes in inbuf
+ *
+ * @return Offset of the marker, or -1 if there is none
+ */
+int cam_jpeg_find_eoi(const uint8_t *inbuf, uint32_t length);
+
+/**
+ * @brief Record the header segments of a JPEG frame
+ *
+ * Walks the marker segments from SOI up to and including SOS.
+ *
+ * @param inbuf  Frame data, starting with SOI
+ * @param eoi    Offset of the EOI marker as returned by cam_jpeg_find_eoi()
+ * @param info   Filled with the segment offsets
+ *
+ * @return true if SOS was reached before EOI
+ */
+bool cam_jpeg_parse_segments(const uint8_t *inbuf, uint32_t eoi, camera_jpeg_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
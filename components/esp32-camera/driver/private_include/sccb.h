@@ -9,14 +9,23 @@
 #ifndef __SCCB_H__
 #define __SCCB_H__
 #include <stdint.h>
+#include <stddef.h>
 int SCCB_Init(int pin_sda, int pin_scl);
 int SCCB_Use_Port(int sccb_i2c_port);
 int SCCB_Deinit(void);
 uint8_t SCCB_Probe(void);
+int SCCB_Install_Device(uint8_t slv_addr);
 uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg);
 int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data);
 uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data);
+/*
+ * Write a list of {reg, value} pairs to a sensor with 16-bit register addresses.
+ * Runs of consecutive registers are sent as one auto-increment write of up to
+ * SCCB_BURST_MAX values. The list must not contain delay or tail markers.
+ */
+#define SCCB_BURST_MAX 32
+int SCCB_Write16_Seq(uint8_t slv_addr, const uint16_t (*regs)[2], size_t count);
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data);
 #endif // __SCCB_H__
@@ -7,6 +7,7 @@
  *
  */
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -26,6 +27,7 @@ static const char *TAG = "sccb-ng";
 #include "esp_private/i2c_platform.h"
 #include "driver/i2c_master.h"
 #include "driver/i2c_types.h"
+#include "esp_idf_version.h"
 
 // support IDF 5.x
 #ifndef portTICK_RATE_MS
@@ -80,6 +82,14 @@ int SCCB_Install_Device(uint8_t slv_addr)
     esp_err_t ret;
     i2c_master_bus_handle_t bus_handle;
 
+    for (uint8_t i = 0; i < device_count; i++)
+    {
+        if (slv_addr == devices[i].address)
+        {
+            return 0;
+        }
+    }
+
     if (device_count > MAX_DEVICES)
     {
         ESP_LOGE(TAG, "cannot add more than %d devices", MAX_DEVICES);
@@ -307,6 +317,106 @@ int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
     return ret == ESP_OK ? 0 : -1;
 }
 
+// Length of the run of consecutive registers starting at regs[0], at most SCCB_BURST_MAX
+static size_t sccb_burst_len(const uint16_t (*regs)[2], size_t count)
+{
+    size_t len = 1;
+    while (len < count && len < SCCB_BURST_MAX && regs[len][0] == regs[0][0] + len)
+    {
+        len++;
+    }
+    return len;
+}
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 5, 0)
+int SCCB_Write16_Seq(uint8_t slv_addr, const uint16_t (*regs)[2], size_t count)
+{
+    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+    if (!count)
+    {
+        return 0;
+    }
+
+    // all bursts go into one operation list and are executed in a single call, like the
+    // command list of the legacy driver
+    size_t bursts = 0;
+    for (size_t i = 0; i < count; i += sccb_burst_len(regs + i, count - i))
+    {
+        bursts++;
+    }
+    // each burst is START, WRITE of address, register and values, STOP
+    i2c_operation_job_t *ops = calloc(bursts * 3, sizeof(i2c_operation_job_t));
+    uint8_t *data = malloc(bursts * 3 + count);
+    if (!ops || !data)
+    {
+        free(ops);
+        free(data);
+        return -1;
+    }
+
+    i2c_operation_job_t *op = ops;
+    uint8_t *p = data;
+    for (size_t i = 0; i < count;)
+    {
+        size_t len = sccb_burst_len(regs + i, count - i);
+        uint8_t *burst = p;
+        *p++ = slv_addr << 1;
+        *p++ = regs[i][0] >> 8;
+        *p++ = regs[i][0] & 0x00ff;
+        for (size_t k = 0; k < len; k++)
+        {
+            *p++ = regs[i + k][1];
+        }
+        i += len;
+        op[0].command = I2C_MASTER_CMD_START;
+        op[1].command = I2C_MASTER_CMD_WRITE;
+        op[1].write.ack_check = true;
+        op[1].write.data = burst;
+        op[1].write.total_bytes = p - burst;
+        op[2].command = I2C_MASTER_CMD_STOP;
+        op += 3;
+    }
+
+    esp_err_t ret = i2c_master_execute_defined_operations(dev_handle, ops, op - ops, TIMEOUT_MS);
+    free(ops);
+    free(data);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "W [%04x..] %u regs fail\n", regs[0][0], (unsigned)count);
+        return -1;
+    }
+    return 0;
+}
+#else
+int SCCB_Write16_Seq(uint8_t slv_addr, const uint16_t (*regs)[2], size_t count)
+{
+    i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
+
+    // without user defined operations each burst is its own blocking transaction
+    uint8_t tx_buffer[2 + SCCB_BURST_MAX];
+    for (size_t i = 0; i < count;)
+    {
+        uint16_t reg = regs[i][0];
+        size_t len = sccb_burst_len(regs + i, count - i);
+        tx_buffer[0] = reg >> 8;
+        tx_buffer[1] = reg & 0x00ff;
+        for (size_t k = 0; k < len; k++)
+        {
+            tx_buffer[2 + k] = regs[i + k][1];
+        }
+        i += len;
+
+        esp_err_t ret = i2c_master_transmit(dev_handle, tx_buffer, 2 + len, TIMEOUT_MS);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "W [%04x..%04x] fail\n", reg, (unsigned)(reg + len - 1));
+            return -1;
+        }
+    }
+    return 0;
+}
+#endif
+
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
 {
     i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
@@ -115,6 +115,12 @@ uint8_t SCCB_Probe(void)
     return 0;
 }
 
+int SCCB_Install_Device(uint8_t slv_addr)
+{
+    // the legacy driver addresses devices directly, nothing to register
+    return 0;
+}
+
 uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
 {
     uint8_t data=0;
@@ -206,6 +212,34 @@ int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
     return ret == ESP_OK ? 0 : -1;
 }
 
+int SCCB_Write16_Seq(uint8_t slv_addr, const uint16_t (*regs)[2], size_t count)
+{
+    // all bursts go into one command list and are executed in a single call
+    esp_err_t ret = ESP_FAIL;
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    size_t i = 0;
+    while (i < count) {
+        uint16_t reg = regs[i][0];
+        size_t len = 0;
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
+        i2c_master_write_byte(cmd, reg >> 8, ACK_CHECK_EN);
+        i2c_master_write_byte(cmd, reg & 0x00ff, ACK_CHECK_EN);
+        do {
+            i2c_master_write_byte(cmd, regs[i][1], ACK_CHECK_EN);
+            len++;
+            i++;
+        } while (i < count && len < SCCB_BURST_MAX && regs[i][0] == reg + len);
+        i2c_master_stop(cmd);
+    }
+    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
+    if(ret != ESP_OK) {
+        ESP_LOGE(TAG, "W [%04x] +%u fail\n", count ? regs[0][0] : 0, (unsigned) count);
+    }
+    return ret == ESP_OK ? 0 : -1;
+}
+
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
 {
     uint16_t data = 0;
@@ -503,6 +503,12 @@ static int set_xclk(sensor_t *sensor, int timer, int xclk)
     return ret;
 }
 
+static int set_standby(sensor_t *sensor, int enable)
+{
+    // COM2 standby keeps the register file, so no table reload is needed on wake
+    return write_reg_bits(sensor, BANK_SENSOR, COM2, COM2_STDBY, enable);
+}
+
 static int init_status(sensor_t *sensor){
     sensor->status.brightness = 0;
     sensor->status.contrast = 0;
@@ -607,6 +613,7 @@ int ov2640_init(sensor_t *sensor)
     sensor->set_res_raw = set_res_raw;
     sensor->set_pll = _set_pll;
     sensor->set_xclk = set_xclk;
+    sensor->set_standby = set_standby;
     ESP_LOGD(TAG, "OV2640 Attached");
     return 0;
 }
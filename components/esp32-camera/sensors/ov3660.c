@@ -6,6 +6,7 @@
  * OV3660 driver.
  *
  */
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,6 +17,7 @@
 #include "ov3660_settings.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -26,6 +28,13 @@ static const char *TAG = "ov3660";
 
 //#define REG_DEBUG_ON
 
+#if CONFIG_SCCB_BURST_WRITE && !defined(REG_DEBUG_ON)
+#define SCCB_BURST_WRITE 1
+#endif
+
+// SCCB time of the register tables written since reset(), without their delays
+static int64_t table_write_us;
+
 static int read_reg(uint8_t slv_addr, const uint16_t reg){
     int ret = SCCB_Read16(slv_addr, reg);
 #ifdef REG_DEBUG_ON
@@ -99,10 +108,23 @@ static int write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
     while (!ret && regs[i][0] != REGLIST_TAIL) {
         if (regs[i][0] == REG_DLY) {
             vTaskDelay(regs[i][1] / portTICK_PERIOD_MS);
-        } else {
-            ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
+            i++;
+            continue;
+        }
+        int64_t start_us = esp_timer_get_time();
+#if SCCB_BURST_WRITE
+        // hand everything up to the next delay or tail to SCCB in one go
+        int n = 0;
+        while (regs[i + n][0] != REG_DLY && regs[i + n][0] != REGLIST_TAIL) {
+            n++;
         }
+        ret = SCCB_Write16_Seq(slv_addr, &regs[i], n);
+        i += n;
+#else
+        ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
         i++;
+#endif
+        table_write_us += esp_timer_get_time() - start_us;
     }
     return ret;
 }
@@ -117,10 +139,18 @@ static int write_reg16(uint8_t slv_addr, const uint16_t reg, uint16_t value)
 
 static int write_addr_reg(uint8_t slv_addr, const uint16_t reg, uint16_t x_value, uint16_t y_value)
 {
+#if SCCB_BURST_WRITE
+    const uint16_t regs[4][2] = {
+        {reg, x_value >> 8}, {reg + 1, x_value & 0xFF},
+        {reg + 2, y_value >> 8}, {reg + 3, y_value & 0xFF},
+    };
+    return SCCB_Write16_Seq(slv_addr, regs, 4);
+#else
     if (write_reg16(slv_addr, reg, x_value) || write_reg16(slv_addr, reg + 2, y_value)) {
         return -1;
     }
     return 0;
+#endif
 }
 
 #define write_reg_bits(slv_addr, reg, mask, enable) set_reg_bits(slv_addr, reg, 0, mask, enable?mask:0)
@@ -190,9 +220,10 @@ static int reset(sensor_t *sensor)
         return ret;
     }
     vTaskDelay(100 / portTICK_PERIOD_MS);
+    table_write_us = 0;
     ret = write_regs(sensor->slv_addr, sensor_default_regs);
     if (ret == 0) {
-        ESP_LOGD(TAG, "Camera defaults loaded");
+        ESP_LOGI(TAG, "Camera defaults loaded, %" PRId64 " us on SCCB", table_write_us);
         ret = set_ae_level(sensor, 0);
         vTaskDelay(100 / portTICK_PERIOD_MS);
     }
@@ -311,6 +342,7 @@ static int set_image_options(sensor_t *sensor)
 static int set_framesize(sensor_t *sensor, framesize_t framesize)
 {
     int ret = 0;
+    int64_t start_us = esp_timer_get_time();
 
     if(framesize > FRAMESIZE_QXGA){
         ESP_LOGW(TAG, "Invalid framesize: %u", framesize);
@@ -378,7 +410,7 @@ static int set_framesize(sensor_t *sensor, framesize_t framesize)
     }
 
     if (ret == 0) {
-        ESP_LOGD(TAG, "Set framesize to: %ux%u", w, h);
+        ESP_LOGD(TAG, "Set framesize to: %ux%u in %" PRId64 " us", w, h, esp_timer_get_time() - start_us);
     }
     return ret;
 
@@ -966,6 +998,12 @@ static int set_xclk(sensor_t *sensor, int timer, int xclk)
     return ret;
 }
 
+static int set_standby(sensor_t *sensor, int enable)
+{
+    // SYSTEM_CTROL0 bit[6]: software power down, registers are retained
+    return set_reg_bits(sensor->slv_addr, SYSTEM_CTROL0, 6, 1, enable ? 1 : 0);
+}
+
 static int init_status(sensor_t *sensor)
 {
     sensor->status.brightness = 0;
@@ -1049,5 +1087,6 @@ int ov3660_init(sensor_t *sensor)
     sensor->set_res_raw = set_res_raw;
     sensor->set_pll = _set_pll;
     sensor->set_xclk = set_xclk;
+    sensor->set_standby = set_standby;
     return 0;
 }
@@ -6,6 +6,7 @@
  * OV3660 driver.
  *
  */
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,6 +17,7 @@
 #include "ov5640_settings.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -26,6 +28,13 @@ static const char *TAG = "ov5640";
 
 //#define REG_DEBUG_ON
 
+#if CONFIG_SCCB_BURST_WRITE && !defined(REG_DEBUG_ON)
+#define SCCB_BURST_WRITE 1
+#endif
+
+// SCCB time of the register tables written since reset(), without their delays
+static int64_t table_write_us;
+
 static int read_reg(uint8_t slv_addr, const uint16_t reg){
     int ret = SCCB_Read16(slv_addr, reg);
 #ifdef REG_DEBUG_ON
@@ -148,10 +157,23 @@ static int write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
     while (!ret && regs[i][0] != REGLIST_TAIL) {
         if (regs[i][0] == REG_DLY) {
             vTaskDelay(regs[i][1] / portTICK_PERIOD_MS);
-        } else {
-            ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
+            i++;
+            continue;
         }
+        int64_t start_us = esp_timer_get_time();
+#if SCCB_BURST_WRITE
+        // hand everything up to the next delay or tail to SCCB in one go
+        int n = 0;
+        while (regs[i + n][0] != REG_DLY && regs[i + n][0] != REGLIST_TAIL) {
+            n++;
+        }
+        ret = SCCB_Write16_Seq(slv_addr, &regs[i], n);
+        i += n;
+#else
+        ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
         i++;
+#endif
+        table_write_us += esp_timer_get_time() - start_us;
     }
     return ret;
 }
@@ -166,10 +188,18 @@ static int write_reg16(uint8_t slv_addr, const uint16_t reg, uint16_t value)
 
 static int write_addr_reg(uint8_t slv_addr, const uint16_t reg, uint16_t x_value, uint16_t y_value)
 {
+#if SCCB_BURST_WRITE
+    const uint16_t regs[4][2] = {
+        {reg, x_value >> 8}, {reg + 1, x_value & 0xFF},
+        {reg + 2, y_value >> 8}, {reg + 3, y_value & 0xFF},
+    };
+    return SCCB_Write16_Seq(slv_addr, regs, 4);
+#else
     if (write_reg16(slv_addr, reg, x_value) || write_reg16(slv_addr, reg + 2, y_value)) {
         return -1;
     }
     return 0;
+#endif
 }
 
 #define write_reg_bits(slv_addr, reg, mask, enable) set_reg_bits(slv_addr, reg, 0, mask, (enable)?(mask):0)
@@ -214,31 +244,19 @@ static int set_pll(sensor_t *sensor, bool bypass, uint8_t multiplier, uint8_t sy
 
     calc_sysclk(sensor->xclk_freq_hz, bypass, multiplier, sys_div, pre_div, root_2x, pclk_root_div, pclk_manual, pclk_div);
 
-    ret = write_reg(sensor->slv_addr, 0x3039, bypass?0x80:0x00);
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, 0x3034, 0x1A);//10bit mode
-    }
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, 0x3035, 0x01 | ((sys_div & 0x0f) << 4));
-    }
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, 0x3036, multiplier & 0xff);
-    }
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, 0x3037, (pre_div & 0xf) | (root_2x?0x10:0x00));
-    }
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, 0x3108, (pclk_root_div & 0x3) << 4 | 0x06);
-    }
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, 0x3824, pclk_div & 0x1f);
-    }
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, 0x460C, pclk_manual?0x22:0x20);
-    }
-    if (ret == 0) {
-        ret = write_reg(sensor->slv_addr, 0x3103, 0x13);// system clock from pll, bit[1]
-    }
+    const uint16_t regs[][2] = {
+        {0x3039, bypass?0x80:0x00},
+        {0x3034, 0x1A},//10bit mode
+        {0x3035, 0x01 | ((sys_div & 0x0f) << 4)},
+        {0x3036, multiplier & 0xff},
+        {0x3037, (pre_div & 0xf) | (root_2x?0x10:0x00)},
+        {0x3108, (pclk_root_div & 0x3) << 4 | 0x06},
+        {0x3824, pclk_div & 0x1f},
+        {0x460C, pclk_manual?0x22:0x20},
+        {0x3103, 0x13},// system clock from pll, bit[1]
+        {REGLIST_TAIL, 0x00}
+    };
+    ret = write_regs(sensor->slv_addr, regs);
     if(ret){
         ESP_LOGE(TAG, "set_sensor_pll FAILED!");
     }
@@ -259,9 +277,10 @@ static int reset(sensor_t *sensor)
         return ret;
     }
     vTaskDelay(100 / portTICK_PERIOD_MS);
+    table_write_us = 0;
     ret = write_regs(sensor->slv_addr, sensor_default_regs);
     if (ret == 0) {
-        ESP_LOGD(TAG, "Camera defaults loaded");
+        ESP_LOGI(TAG, "Camera defaults loaded, %" PRId64 " us on SCCB", table_write_us);
         vTaskDelay(100 / portTICK_PERIOD_MS);
         //write_regs(sensor->slv_addr, sensor_regs_awb0);
         //write_regs(sensor->slv_addr, sensor_regs_gamma1);
@@ -381,6 +400,7 @@ static int set_image_options(sensor_t *sensor)
 static int set_framesize(sensor_t *sensor, framesize_t framesize)
 {
     int ret = 0;
+    int64_t start_us = esp_timer_get_time();
     framesize_t old_framesize = sensor->status.framesize;
     sensor->status.framesize = framesize;
 
@@ -453,7 +473,7 @@ static int set_framesize(sensor_t *sensor, framesize_t framesize)
     }
 
     if (ret == 0) {
-        ESP_LOGD(TAG, "Set framesize to: %ux%u", w, h);
+        ESP_LOGD(TAG, "Set framesize to: %ux%u in %" PRId64 " us", w, h, esp_timer_get_time() - start_us);
     }
     return ret;
 
@@ -1043,6 +1063,12 @@ static int set_xclk(sensor_t *sensor, int timer, int xclk)
     return ret;
 }
 
+static int set_standby(sensor_t *sensor, int enable)
+{
+    // SYSTEM_CTROL0 bit[6]: software power down, registers are retained
+    return set_reg_bits(sensor->slv_addr, SYSTEM_CTROL0, 6, 1, enable ? 1 : 0);
+}
+
 static int init_status(sensor_t *sensor)
 {
     sensor->status.brightness = 0;
@@ -1126,5 +1152,6 @@ int ov5640_init(sensor_t *sensor)
     sensor->set_res_raw = set_res_raw;
     sensor->set_pll = _set_pll;
     sensor->set_xclk = set_xclk;
+    sensor->set_standby = set_standby;
     return 0;
 }
@@ -85,12 +85,16 @@ typedef enum {
     CAM_STATE_READ_BUF = 1,
 } cam_state_t;
 
+#define CAM_JPEG_SIZE_WINDOW        32
+#define CAM_JPEG_SIZE_MIN_SAMPLES   8
+
 typedef struct {
     camera_fb_t fb;
     uint8_t en;
     //for RGB/YUV modes
     lldesc_t *dma;
     size_t fb_offset;
+    size_t size;//allocated bytes, starting at fb.buf
 } cam_frame_t;
 
 typedef struct {
@@ -139,6 +143,18 @@ typedef struct {
     uint8_t fb_bytes_per_pixel;
 #endif
     uint32_t fb_size;
+    uint32_t fb_caps;
+    uint8_t fb_dma_align; // frame buffers are allocated this much larger in PSRAM mode
+
+#if CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_ADAPTIVE
+    //for JPEG mode with adaptive frame buffers, guarded by fb_size_lock in cam_hal.c
+    bool fb_adaptive;
+    size_t fb_target;
+    uint32_t jpeg_sizes[CAM_JPEG_SIZE_WINDOW];
+    uint8_t jpeg_size_pos;
+    uint8_t jpeg_size_cnt;
+    uint32_t jpeg_size_gen; // bumped on overflow, a target computed before is stale
+#endif
 
     cam_state_t state;
 } cam_obj_t;
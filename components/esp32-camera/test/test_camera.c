@@ -536,3 +536,47 @@ TEST_CASE("Camera driver uses an i2c port initialized by other devices test", "[
     TEST_ESP_OK(esp_camera_deinit());
     TEST_ESP_OK(i2c_driver_delete(I2C_MASTER_NUM));
 }
+
+static void img_jpeg_optimize_test(const uint8_t *jpg, uint32_t length, uint16_t w, uint16_t h)
+{
+    size_t rgb_len = w * h * 3;
+    uint8_t *rgb = heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *back = heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(rgb);
+    TEST_ASSERT_NOT_NULL(back);
+
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+    const uint32_t times = 8;
+    uint64_t t_total = 0;
+    for (uint32_t i = 0; i < times; i++) {
+        free(out);
+        uint64_t t1 = esp_timer_get_time();
+        TEST_ASSERT_TRUE(jpg_optimize_huffman(jpg, length, &out, &out_len));
+        t_total += esp_timer_get_time() - t1;
+    }
+    TEST_ASSERT_TRUE(fmt2rgb888(jpg, length, PIXFORMAT_JPEG, rgb));
+    TEST_ASSERT_TRUE(fmt2rgb888(out, out_len, PIXFORMAT_JPEG, back));
+    TEST_ASSERT_EQUAL_MEMORY(rgb, back, rgb_len);
+    printf("%4d x %4d %6u -> %6u bytes, saved %5u (%4.1f%%) in %6.2f ms\n", w, h, length, out_len, length - out_len,
+           100.0f * (length - out_len) / length, t_total / 1000.0f / times);
+    TEST_ASSERT_LESS_OR_EQUAL(length, out_len);
+
+    free(out);
+    heap_caps_free(rgb);
+    heap_caps_free(back);
+}
+
+TEST_CASE("Conversions jpeg huffman optimization test", "[camera]")
+{
+    extern const uint8_t img1_start[] asm("_binary_testimg_jpeg_start");
+    extern const uint8_t img1_end[]   asm("_binary_testimg_jpeg_end");
+    extern const uint8_t img2_start[] asm("_binary_test_inside_jpeg_start");
+    extern const uint8_t img2_end[]   asm("_binary_test_inside_jpeg_end");
+    extern const uint8_t img3_start[] asm("_binary_test_outside_jpeg_start");
+    extern const uint8_t img3_end[]   asm("_binary_test_outside_jpeg_end");
+
+    img_jpeg_optimize_test(img1_start, img1_end - img1_start, 227, 149);
+    img_jpeg_optimize_test(img2_start, img2_end - img2_start, 320, 240);
+    img_jpeg_optimize_test(img3_start, img3_end - img3_start, 480, 320);
+}
@@ -0,0 +1,554 @@
+// Conversion tests that need no camera. They also build on the host, see test/host in the firmware.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
+
+#include "img_converters.h"
+#include "yuv.h"
+#include "rgb.h"
+#include "jpge_block.h"
+
+typedef void (*line_func_t)(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+static void ref_yuv422_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels / 2; i++) {
+        yuv2rgb(src[0], src[1], src[3], &dst[0], &dst[1], &dst[2]);
+        yuv2rgb(src[2], src[1], src[3], &dst[3], &dst[4], &dst[5]);
+        src += 4;
+        dst += 6;
+    }
+}
+
+static void ref_rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++) {
+        dst[0] = src[0] & 0xF8;
+        dst[1] = (src[0] & 0x07) << 5 | (src[1] & 0xE0) >> 3;
+        dst[2] = (src[1] & 0x1F) << 3;
+        src += 2;
+        dst += 3;
+    }
+}
+
+static void ref_rgb888_swap_rb(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        src += 3;
+        dst += 3;
+    }
+}
+
+static float line_convert_mpix(line_func_t func, const uint8_t *src, uint8_t *dst, size_t pixels, uint32_t times)
+{
+    uint64_t t1 = esp_timer_get_time();
+    for (uint32_t i = 0; i < times; i++) {
+        func(src, dst, pixels);
+    }
+    uint64_t t = esp_timer_get_time() - t1;
+    return (float)pixels * times / t;
+}
+
+static void line_convert_test(const char *name, line_func_t func, line_func_t ref)
+{
+    const size_t width = 1280;
+    uint8_t *src = heap_caps_malloc(width * 3, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    uint8_t *out = heap_caps_calloc(1, width * 3, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    uint8_t *expected = heap_caps_calloc(1, width * 3, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_NOT_NULL(expected);
+
+    for (int n = 0; n < 64; n++) {
+        esp_fill_random(src, width * 3);
+        size_t pixels = width - n;
+        ref(src, expected, pixels);
+        func(src, out, pixels);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, width * 3);
+    }
+
+    float ref_mpix = line_convert_mpix(ref, src, expected, width, 200);
+    float mpix = line_convert_mpix(func, src, out, width, 200);
+    printf("%-18s reference %6.2f MPix/s, line kernel %6.2f MPix/s\n", name, ref_mpix, mpix);
+
+    free(src);
+    free(out);
+    free(expected);
+}
+
+// Every Y with every U/V pair, one line of 256 pixels per pair
+static void yuv422_exhaustive_test(void)
+{
+    uint8_t *src = heap_caps_malloc(256 * 2, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    uint8_t *out = heap_caps_malloc(256 * 3, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    uint8_t *expected = heap_caps_malloc(256 * 3, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_NOT_NULL(expected);
+
+    for (int uv = 0; uv < 65536; uv++) {
+        for (int i = 0; i < 256; i += 2) {
+            src[i * 2] = i;
+            src[i * 2 + 1] = uv >> 8;
+            src[i * 2 + 2] = i + 1;
+            src[i * 2 + 3] = uv & 0xFF;
+        }
+        ref_yuv422_to_rgb888(src, expected, 256);
+        yuv422_to_rgb888(src, out, 256);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, 256 * 3);
+    }
+
+    free(src);
+    free(out);
+    free(expected);
+}
+
+TEST_CASE("Conversions pixel format line kernels", "[camera]")
+{
+    yuv422_exhaustive_test();
+    line_convert_test("YUV422 -> RGB888", yuv422_to_rgb888, ref_yuv422_to_rgb888);
+    line_convert_test("RGB565 -> RGB888", rgb565_to_rgb888, ref_rgb565_to_rgb888);
+    line_convert_test("BGR888 -> RGB888", rgb888_swap_rb, ref_rgb888_swap_rb);
+}
+
+static float rgb888_psnr(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    uint64_t se = 0;
+    for (size_t i = 0; i < len; i++) {
+        int d = a[i] - b[i];
+        se += d * d;
+    }
+    if (se == 0) {
+        return 99.0f;
+    }
+    return 10.0f * log10f(255.0f * 255.0f * len / se);
+}
+
+static void img_jpeg_encode_test(const uint8_t *jpg, uint32_t length, uint16_t w, uint16_t h, uint8_t quality)
+{
+    size_t rgb_len = w * h * 3;
+    uint8_t *rgb = heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *bgr = heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *back = heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(rgb);
+    TEST_ASSERT_NOT_NULL(bgr);
+    TEST_ASSERT_NOT_NULL(back);
+    TEST_ASSERT_TRUE(fmt2rgb888(jpg, length, PIXFORMAT_JPEG, rgb));
+    // The decoder gives R, G, B, while RGB888 frames hold B, G, R
+    rgb888_swap_rb(rgb, bgr, w * h);
+
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+    const uint32_t times = 8;
+    uint64_t t_total = 0;
+    for (uint32_t i = 0; i < times; i++) {
+        free(out);
+        uint64_t t1 = esp_timer_get_time();
+        TEST_ASSERT_TRUE(fmt2jpg(bgr, rgb_len, w, h, PIXFORMAT_RGB888, quality, &out, &out_len));
+        t_total += esp_timer_get_time() - t1;
+    }
+    TEST_ASSERT_TRUE(fmt2rgb888(out, out_len, PIXFORMAT_JPEG, back));
+    float psnr = rgb888_psnr(rgb, back, rgb_len);
+    float ms_per_mpix = t_total / 1000.0f / times / (w * h / 1000000.0f);
+    printf("%4d x %4d q%-3d %6zu bytes, PSNR %5.2f dB, %7.2f ms/MPix\n", w, h, quality, out_len, psnr, ms_per_mpix);
+    TEST_ASSERT_GREATER_THAN(20, (int)psnr);
+
+    free(out);
+    heap_caps_free(rgb);
+    heap_caps_free(bgr);
+    heap_caps_free(back);
+}
+
+TEST_CASE("Conversions jpeg encode quality and speed test", "[camera]")
+{
+    extern const uint8_t img2_start[] asm("_binary_test_inside_jpeg_start");
+    extern const uint8_t img2_end[]   asm("_binary_test_inside_jpeg_end");
+    extern const uint8_t img3_start[] asm("_binary_test_outside_jpeg_start");
+    extern const uint8_t img3_end[]   asm("_binary_test_outside_jpeg_end");
+
+    img_jpeg_encode_test(img2_start, img2_end - img2_start, 320, 240, 80);
+    img_jpeg_encode_test(img3_start, img3_end - img3_start, 480, 320, 80);
+    img_jpeg_encode_test(img3_start, img3_end - img3_start, 480, 320, 10);
+}
+
+// Level shifted 8x8 luma blocks of an RGB888 picture
+static int32_t *luma_blocks(const uint8_t *rgb, uint16_t w, uint16_t h, size_t *count)
+{
+    *count = (w / 8) * (h / 8);
+    int32_t *blocks = malloc(*count * 64 * sizeof(int32_t));
+    TEST_ASSERT_NOT_NULL(blocks);
+    int32_t *b = blocks;
+    for (int by = 0; by + 8 <= h; by += 8) {
+        for (int bx = 0; bx + 8 <= w; bx += 8) {
+            for (int y = 0; y < 8; y++) {
+                const uint8_t *p = rgb + ((by + y) * w + bx) * 3;
+                for (int x = 0; x < 8; x++, p += 3) {
+                    *b++ = ((p[0] * 19595 + p[1] * 38470 + p[2] * 7471 + 32768) >> 16) - 128;
+                }
+            }
+        }
+    }
+    return blocks;
+}
+
+// The AAN DCT only differs from jfdctint by rounding, so a quantized coefficient may be off by one.
+// Up to 8% of them are at high quality, where the quantizer steps are small.
+static void dct_compare_test(const char *name, const int32_t *blocks, size_t count, int quality, bool chroma)
+{
+    int16_t slow[64], fast[64];
+    size_t differing = 0;
+    int max_diff = 0;
+    for (size_t i = 0; i < count; i++) {
+        jpge_quantize_block(blocks + i * 64, quality, chroma, false, slow);
+        jpge_quantize_block(blocks + i * 64, quality, chroma, true, fast);
+        for (int k = 0; k < 64; k++) {
+            int d = abs(fast[k] - slow[k]);
+            differing += d != 0;
+            max_diff = d > max_diff ? d : max_diff;
+        }
+    }
+    float percent = 100.0f * differing / (count * 64);
+    printf("%-18s q%-3d %-6s %6zu blocks, %5.3f%% coefficients differ, max %d\n", name, quality,
+           chroma ? "chroma" : "luma", count, percent, max_diff);
+    TEST_ASSERT_LESS_OR_EQUAL(1, max_diff);
+    TEST_ASSERT_TRUE(percent < 10.0f);
+}
+
+TEST_CASE("Conversions jpeg AAN DCT against jfdctint", "[camera]")
+{
+    extern const uint8_t img3_start[] asm("_binary_test_outside_jpeg_start");
+    extern const uint8_t img3_end[]   asm("_binary_test_outside_jpeg_end");
+    const uint16_t w = 480, h = 320;
+    static const int qualities[] = {10, 50, 80, 95, 100};
+
+    uint8_t *rgb = heap_caps_malloc(w * h * 3, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(rgb);
+    TEST_ASSERT_TRUE(fmt2rgb888(img3_start, img3_end - img3_start, PIXFORMAT_JPEG, rgb));
+    size_t count;
+    int32_t *blocks = luma_blocks(rgb, w, h, &count);
+    heap_caps_free(rgb);
+
+    // Full range noise, the worst case for rounding
+    const size_t random_count = 4096;
+    int32_t *noise = malloc(random_count * 64 * sizeof(int32_t));
+    TEST_ASSERT_NOT_NULL(noise);
+    for (size_t i = 0; i < random_count * 64; i++) {
+        noise[i] = (int32_t)(esp_random() & 0xFF) - 128;
+    }
+
+    for (size_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+        for (int chroma = 0; chroma < 2; chroma++) {
+            dct_compare_test("test_outside.jpeg", blocks, count, qualities[q], chroma);
+            dct_compare_test("random", noise, random_count, qualities[q], chroma);
+        }
+    }
+
+    free(blocks);
+    free(noise);
+}
+
+static void ref_luma_hist_add(luma_hist_t *hist, const uint8_t *gray, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hist->bins[gray[i]]++;
+    }
+    hist->count += len;
+}
+
+static void img_luma_hist_test(const uint8_t *jpg, uint32_t length, uint16_t w, uint16_t h)
+{
+    size_t rgb_len = w * h * 3;
+    uint8_t *rgb = heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(rgb);
+    TEST_ASSERT_TRUE(fmt2rgb888(jpg, length, PIXFORMAT_JPEG, rgb));
+    uint64_t luma_sum = 0;
+    for (size_t i = 0; i < rgb_len; i += 3) {
+        luma_sum += (77 * rgb[i] + 150 * rgb[i + 1] + 29 * rgb[i + 2]) >> 8;
+    }
+    float full_mean = (float)luma_sum / (w * h);
+    heap_caps_free(rgb);
+
+    camera_fb_t fb = {
+        .buf = (uint8_t *)jpg,
+        .len = length,
+        .width = w,
+        .height = h,
+        .format = PIXFORMAT_JPEG,
+    };
+    luma_hist_t hist;
+    const uint32_t times = 8;
+    uint64_t t1 = esp_timer_get_time();
+    for (uint32_t i = 0; i < times; i++) {
+        TEST_ASSERT_TRUE(frame2luma_hist(&fb, JPEG_IMAGE_SCALE_1_8, &hist));
+    }
+    uint64_t t = esp_timer_get_time() - t1;
+    TEST_ASSERT_EQUAL_UINT32((w >> 3) * (h >> 3), hist.count);
+
+    uint64_t sum = 0;
+    for (int i = 0; i < 256; i++) {
+        sum += (uint64_t)hist.bins[i] * i;
+    }
+    float mean = (float)sum / hist.count;
+    uint8_t p5 = luma_hist_percentile(&hist, 5);
+    uint8_t p50 = luma_hist_percentile(&hist, 50);
+    uint8_t p95 = luma_hist_percentile(&hist, 95);
+    printf("%4d x %4d mean %6.2f (full decode %6.2f), p5 %3u p50 %3u p95 %3u in %6.2f ms\n",
+           w, h, mean, full_mean, p5, p50, p95, t / 1000.0f / times);
+    TEST_ASSERT_FLOAT_WITHIN(4.0f, full_mean, mean);
+    TEST_ASSERT_TRUE(p5 <= p50 && p50 <= p95);
+    // None of the sample pictures is blank
+    TEST_ASSERT_GREATER_THAN(32, p95 - p5);
+}
+
+TEST_CASE("Conversions luminance histogram test", "[camera]")
+{
+    extern const uint8_t img1_start[] asm("_binary_testimg_jpeg_start");
+    extern const uint8_t img1_end[]   asm("_binary_testimg_jpeg_end");
+    extern const uint8_t img2_start[] asm("_binary_test_inside_jpeg_start");
+    extern const uint8_t img2_end[]   asm("_binary_test_inside_jpeg_end");
+    extern const uint8_t img3_start[] asm("_binary_test_outside_jpeg_start");
+    extern const uint8_t img3_end[]   asm("_binary_test_outside_jpeg_end");
+
+    img_luma_hist_test(img1_start, img1_end - img1_start, 227, 149);
+    img_luma_hist_test(img2_start, img2_end - img2_start, 320, 240);
+    img_luma_hist_test(img3_start, img3_end - img3_start, 480, 320);
+
+    // Flat raw frames land in a single bin
+    const size_t w = 64, h = 48;
+    uint8_t *gray = heap_caps_malloc(w * h, MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(gray);
+    camera_fb_t fb = {
+        .buf = gray,
+        .len = w * h,
+        .width = w,
+        .height = h,
+        .format = PIXFORMAT_GRAYSCALE,
+    };
+    luma_hist_t hist;
+    const uint8_t levels[] = {0, 255};
+    for (int i = 0; i < 2; i++) {
+        memset(gray, levels[i], w * h);
+        TEST_ASSERT_TRUE(frame2luma_hist(&fb, JPEG_IMAGE_SCALE_1_4, &hist));
+        TEST_ASSERT_EQUAL_UINT32((w / 4) * (h / 4), hist.count);
+        TEST_ASSERT_EQUAL_UINT32(hist.count, hist.bins[levels[i]]);
+        TEST_ASSERT_EQUAL_UINT8(levels[i], luma_hist_percentile(&hist, 5));
+        TEST_ASSERT_EQUAL_UINT8(levels[i], luma_hist_percentile(&hist, 95));
+    }
+    heap_caps_free(gray);
+}
+
+TEST_CASE("Conversions luminance histogram kernel", "[camera]")
+{
+    const size_t len = 160 * 90 + 3;
+    uint8_t *gray = heap_caps_malloc(len, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    TEST_ASSERT_NOT_NULL(gray);
+    esp_fill_random(gray, len);
+
+    static luma_hist_t hist, expected;
+    memset(&hist, 0, sizeof(hist));
+    memset(&expected, 0, sizeof(expected));
+    for (size_t n = 0; n < 4; n++) {
+        luma_hist_add(&hist, gray + n, len - n);
+        ref_luma_hist_add(&expected, gray + n, len - n);
+    }
+    TEST_ASSERT_EQUAL_UINT32(expected.count, hist.count);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected.bins, hist.bins, 256);
+
+    const uint32_t times = 200;
+    uint64_t t1 = esp_timer_get_time();
+    for (uint32_t i = 0; i < times; i++) {
+        ref_luma_hist_add(&expected, gray, len);
+    }
+    uint64_t t_ref = esp_timer_get_time() - t1;
+    t1 = esp_timer_get_time();
+    for (uint32_t i = 0; i < times; i++) {
+        luma_hist_add(&hist, gray, len);
+    }
+    uint64_t t = esp_timer_get_time() - t1;
+    printf("luma histogram    reference %6.2f MPix/s, kernel %6.2f MPix/s\n",
+           (float)len * times / t_ref, (float)len * times / t);
+
+    heap_caps_free(gray);
+}
+
+static size_t ref_luma_diff_update(uint8_t *reference, const uint8_t *frame, size_t len, uint8_t threshold, uint8_t adapt_shift)
+{
+    size_t changed = 0;
+    for (size_t i = 0; i < len; i++) {
+        int d = frame[i] - reference[i];
+        if (abs(d) > threshold) {
+            changed++;
+        }
+        reference[i] = reference[i] + d / (1 << adapt_shift);
+    }
+    return changed;
+}
+
+TEST_CASE("Conversions luminance frame difference kernel", "[camera]")
+{
+    // A VGA frame decoded at 1:8
+    const size_t len = 80 * 60;
+    uint8_t *frame = heap_caps_malloc(len, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    uint8_t *reference = heap_caps_malloc(len, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    uint8_t *expected = heap_caps_malloc(len, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    TEST_ASSERT_NOT_NULL(frame);
+    TEST_ASSERT_NOT_NULL(reference);
+    TEST_ASSERT_NOT_NULL(expected);
+
+    const uint8_t thresholds[] = {0, 16, 255};
+    for (int t = 0; t < 3; t++) {
+        for (uint8_t shift = 0; shift < 8; shift++) {
+            esp_fill_random(frame, len);
+            esp_fill_random(reference, len);
+            memcpy(expected, reference, len);
+            size_t changed = luma_diff_update(reference, frame, len, thresholds[t], shift);
+            TEST_ASSERT_EQUAL_UINT32(ref_luma_diff_update(expected, frame, len, thresholds[t], shift), changed);
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, reference, len);
+        }
+    }
+
+    // A static scene converges and then reports no change
+    esp_fill_random(frame, len);
+    memset(reference, 128, len);
+    for (int i = 0; i < 64; i++) {
+        luma_diff_update(reference, frame, len, 16, 2);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, luma_diff_update(reference, frame, len, 16, 2));
+
+    const uint32_t times = 1000;
+    uint64_t t1 = esp_timer_get_time();
+    for (uint32_t i = 0; i < times; i++) {
+        luma_diff_update(reference, frame, len, 16, 3);
+    }
+    uint64_t t = esp_timer_get_time() - t1;
+    printf("luma difference   %6.2f MPix/s, %6.2f us per %zu pixel frame\n",
+           (float)len * times / t, (float)t / times, len);
+
+    heap_caps_free(frame);
+    heap_caps_free(reference);
+    heap_caps_free(expected);
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    const uint8_t *src;
+    size_t src_len;
+    size_t copied;  // bytes not handed through from the source buffer
+} splice_sink_t;
+
+static size_t splice_sink_cb(void *arg, size_t index, const void *data, size_t len)
+{
+    splice_sink_t *sink = (splice_sink_t *)arg;
+    TEST_ASSERT_EQUAL_UINT32(sink->len, index);
+    TEST_ASSERT_TRUE(sink->len + len <= sink->cap);
+    const uint8_t *p = (const uint8_t *)data;
+    if (p < sink->src || p + len > sink->src + sink->src_len) {
+        sink->copied += len;
+    }
+    memcpy(sink->buf + sink->len, data, len);
+    sink->len += len;
+    return len;
+}
+
+static void img_jpeg_splice_test(const uint8_t *jpg, uint32_t length, uint16_t w, uint16_t h)
+{
+    const jpg_exif_entry_t entries[] = {
+        {0x010E, "volume=0.512 l rate=3.07 l/min duration=10.01 s"},
+        {0x0132, "2025:06:01 12:34:56"},
+        {0x013C, "abc"},
+    };
+    uint8_t segment[256];
+    size_t segment_len = jpg_exif_build(segment, sizeof(segment), entries, 3);
+    TEST_ASSERT_GREATER_THAN(0, segment_len);
+    TEST_ASSERT_EQUAL_UINT32(segment_len - 2, (segment[2] << 8) | segment[3]);
+
+    // Expected position is behind SOI and the JFIF APP0 segment
+    size_t pos = 2;
+    if (jpg[2] == 0xFF && jpg[3] == 0xE0) {
+        pos += 2 + ((jpg[4] << 8) | jpg[5]);
+    }
+
+    splice_sink_t sink = {
+        .cap = length + segment_len,
+        .src = jpg,
+        .src_len = length,
+    };
+    sink.buf = heap_caps_malloc(sink.cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(sink.buf);
+
+    // Whole buffer at once, then in pieces that split the markers at every offset
+    const size_t pieces[] = {length, 1, 3, 7, 512};
+    for (int i = 0; i < 5; i++) {
+        sink.len = 0;
+        sink.copied = 0;
+        jpg_splice_t splice;
+        jpg_splice_init(&splice, segment, segment_len, splice_sink_cb, &sink);
+        for (size_t off = 0; off < length; off += pieces[i]) {
+            size_t n = pieces[i] < length - off ? pieces[i] : length - off;
+            TEST_ASSERT_EQUAL_UINT32(n, jpg_splice_write(&splice, off, jpg + off, n));
+        }
+        TEST_ASSERT_TRUE(jpg_splice_finish(&splice));
+        TEST_ASSERT_EQUAL_UINT32(length + segment_len, sink.len);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(jpg, sink.buf, pos);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(segment, sink.buf + pos, segment_len);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(jpg + pos, sink.buf + pos + segment_len, length - pos);
+        // Only held back marker bytes may be written from the splice state
+        TEST_ASSERT_TRUE(sink.copied <= segment_len + 3 * 6);
+    }
+
+    // The image is unchanged
+    size_t rgb_len = w * h * 3;
+    uint8_t *rgb = heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *spliced_rgb = heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(rgb);
+    TEST_ASSERT_NOT_NULL(spliced_rgb);
+    TEST_ASSERT_TRUE(fmt2rgb888(jpg, length, PIXFORMAT_JPEG, rgb));
+    TEST_ASSERT_TRUE(fmt2rgb888(sink.buf, sink.len, PIXFORMAT_JPEG, spliced_rgb));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(rgb, spliced_rgb, rgb_len);
+
+    heap_caps_free(rgb);
+    heap_caps_free(spliced_rgb);
+    heap_caps_free(sink.buf);
+}
+
+TEST_CASE("Conversions jpeg metadata splice test", "[camera]")
+{
+    extern const uint8_t img1_start[] asm("_binary_testimg_jpeg_start");
+    extern const uint8_t img1_end[]   asm("_binary_testimg_jpeg_end");
+    extern const uint8_t img2_start[] asm("_binary_test_inside_jpeg_start");
+    extern const uint8_t img2_end[]   asm("_binary_test_inside_jpeg_end");
+    extern const uint8_t img3_start[] asm("_binary_test_outside_jpeg_start");
+    extern const uint8_t img3_end[]   asm("_binary_test_outside_jpeg_end");
+
+    img_jpeg_splice_test(img1_start, img1_end - img1_start, 227, 149);
+    img_jpeg_splice_test(img2_start, img2_end - img2_start, 320, 240);
+    img_jpeg_splice_test(img3_start, img3_end - img3_start, 480, 320);
+
+    // Tags out of order and segments that do not fit are refused
+    uint8_t segment[64];
+    const jpg_exif_entry_t unordered[] = {{0x0132, "x"}, {0x010E, "y"}};
+    TEST_ASSERT_EQUAL_UINT32(0, jpg_exif_build(segment, sizeof(segment), unordered, 2));
+    const jpg_exif_entry_t large[] = {{0x010E, "a value that does not fit into the small buffer above"}};
+    TEST_ASSERT_EQUAL_UINT32(0, jpg_exif_build(segment, sizeof(segment), large, 1));
+
+    // Anything else passes through untouched
+    const uint8_t data[] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A};
+    uint8_t out[sizeof(data) + sizeof(segment)];
+    splice_sink_t sink = {.buf = out, .cap = sizeof(out)};
+    jpg_splice_t splice;
+    jpg_splice_init(&splice, segment, 8, splice_sink_cb, &sink);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(data), jpg_splice_write(&splice, 0, data, sizeof(data)));
+    TEST_ASSERT_FALSE(jpg_splice_finish(&splice));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(data), sink.len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(data, out, sizeof(data));
+}
@@ -30,6 +30,8 @@ typedef enum {
 typedef enum {
     JPEG_IMAGE_FORMAT_RGB888 = 0,   /*!< Format RGB888 */
     JPEG_IMAGE_FORMAT_RGB565,       /*!< Format RGB565 */
+    JPEG_IMAGE_FORMAT_GRAY8,        /*!< Format 8-bit luminance. Chroma is not decoded */
+    JPEG_IMAGE_FORMAT_MONO1,        /*!< Format 1-bit luminance with ordered dithering. Rows start at a byte boundary, MSB is the left pixel, 1 is white */
 } esp_jpeg_image_format_t;
 
 /**
@@ -46,6 +48,8 @@ typedef struct esp_jpeg_image_cfg_s {
 
     struct {
         uint8_t swap_color_bytes: 1; /*!< Swap first and last color bytes */
+        uint8_t parallel_decode: 1;  /*!< Decode the top and bottom half of images with restart markers on both cores.
+                                          Images without restart markers are decoded on the calling core only */
     } flags;
 
     struct {
@@ -80,6 +84,7 @@ typedef struct esp_jpeg_image_output_s {
  * @return
  *      - ESP_OK            on success
  *      - ESP_ERR_NO_MEM    if there is no memory for allocating main structure
+ *      - ESP_ERR_NOT_SUPPORTED if the JPEG coding is not supported for grayscale output (progressive, arithmetic)
  *      - ESP_FAIL          if there is an error in decoding JPEG
  */
 esp_err_t esp_jpeg_decode(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img);
@@ -0,0 +1,583 @@
+/*
+ * SPDX-FileCopyrightText: 2015-2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_rom_caps.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_check.h"
+#include "jpeg_decoder.h"
+#include "jpeg_gray_decoder.h"
+
+#if CONFIG_JD_USE_ROM
+/* When supported in ROM, use ROM functions */
+#if defined(ESP_ROM_HAS_JPEG_DECODE)
+#include "rom/tjpgd.h"
+#else
+#error Using JPEG decoder from ROM is not supported for selected target. Please select external code in menuconfig.
+#endif
+
+/* The ROM code of TJPGD is older and has different return type in decode callback */
+typedef unsigned int jpeg_decode_out_t;
+typedef unsigned int jpeg_decode_in_t;
+#else
+/* When Tiny JPG Decoder is not in ROM or selected external code */
+#include "tjpgd.h"
+
+/* The TJPGD outside the ROM code is newer and has different return type in decode callback */
+typedef int jpeg_decode_out_t;
+typedef size_t jpeg_decode_in_t;
+#endif
+
+static const char *TAG = "JPEG";
+
+#define LOBYTE(u16)     ((uint8_t)(((uint16_t)(u16)) & 0xff))
+#define HIBYTE(u16)     ((uint8_t)((((uint16_t)(u16))>>8) & 0xff))
+
+#if defined(JD_FASTDECODE) && (JD_FASTDECODE == 2)
+#define JPEG_WORK_BUF_SIZE  65472
+#else
+#define JPEG_WORK_BUF_SIZE  3100    /* Recommended buffer size; Independent on the size of the image */
+#endif
+
+/* If not set JD_FORMAT, it is set in ROM to RGB888, otherwise, it can be set in config */
+#ifndef JD_FORMAT
+#define JD_FORMAT 0
+#endif
+
+/* Output color bytes from tjpgd (depends on JD_FORMAT) */
+#if (JD_FORMAT==0)
+#define ESP_JPEG_COLOR_BYTES    3
+#elif  (JD_FORMAT==1)
+#define ESP_JPEG_COLOR_BYTES    2
+#elif  (JD_FORMAT==2)
+#error Grayscale image output format is not supported
+#define ESP_JPEG_COLOR_BYTES    1
+#endif
+
+#define JPEG_SLICE_TASK_STACK   4096
+#define JPEG_IS_RST(m)          (((m) & 0xF8) == 0xD0)
+
+/**
+ * @brief Horizontal band of the image between two restart markers
+ *
+ * TJpgDec decodes the band as a standalone image: the input callback serves the original
+ * headers with the band height in the SOF segment, followed by the entropy-coded data of the band.
+ */
+typedef struct {
+    esp_jpeg_image_cfg_t cfg;   /* Caller's config with outbuf moved to the band. Must be first, the output callback uses it */
+    uint32_t header_len;        /* Length of the image headers up to the end of the SOS segment */
+    uint32_t height_ofs;        /* Offset of the image height in the SOF segment */
+    uint16_t height;            /* Height of the band (pixel) */
+    const uint8_t *data;        /* Entropy-coded data of the band */
+    uint32_t data_len;          /* Length of the entropy-coded data */
+    bool add_eoi;               /* Terminate the data with EOI, it ends at a restart marker */
+    uint8_t rst_base;           /* Number of the first restart marker in the band, renumbered to RST0 */
+    bool last_ff;               /* Last byte passed to TJpgDec was 0xFF */
+    void *workbuf;              /* TJpgDec working buffer */
+    size_t workbuf_size;        /* Size of the working buffer */
+    JRESULT res;                /* Result of the band decoding */
+    SemaphoreHandle_t done;     /* Given when the band is decoded by the helper task */
+} jpeg_slice_t;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+static uint8_t jpeg_get_div_by_scale(esp_jpeg_image_scale_t scale);
+static uint8_t jpeg_get_color_bytes(esp_jpeg_image_format_t format);
+
+static jpeg_decode_in_t jpeg_decode_in_cb(JDEC *jd, uint8_t *buff, jpeg_decode_in_t nbyte);
+static jpeg_decode_out_t jpeg_decode_out_cb(JDEC *jd, void *bitmap, JRECT *rect);
+static esp_err_t jpeg_decode_parallel(esp_jpeg_image_cfg_t *cfg, const JDEC *jd, void *workbuf, size_t workbuf_size);
+static inline uint16_t ldb_word(const void *ptr);
+/*******************************************************************************
+* Public API functions
+*******************************************************************************/
+
+esp_err_t esp_jpeg_decode(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t *workbuf = NULL;
+    JRESULT res;
+    JDEC JDEC;
+
+    assert(cfg != NULL);
+    assert(img != NULL);
+
+    if (cfg->out_format == JPEG_IMAGE_FORMAT_GRAY8 || cfg->out_format == JPEG_IMAGE_FORMAT_MONO1) {
+        /* Luminance only, TJpgDec always decodes the chroma too */
+        return jpeg_gray_decode(cfg, img);
+    }
+
+    const bool allocate_buffer = (cfg->advanced.working_buffer == NULL);
+    const size_t workbuf_size = allocate_buffer ? JPEG_WORK_BUF_SIZE : cfg->advanced.working_buffer_size;
+    if (allocate_buffer) {
+        workbuf = heap_caps_malloc(JPEG_WORK_BUF_SIZE, MALLOC_CAP_DEFAULT);
+        ESP_GOTO_ON_FALSE(workbuf, ESP_ERR_NO_MEM, err, TAG, "no mem for JPEG work buffer");
+    } else {
+        workbuf = cfg->advanced.working_buffer;
+        ESP_RETURN_ON_FALSE(workbuf_size != 0, ESP_ERR_INVALID_ARG, TAG, "Working buffer size not defined!");
+    }
+
+
+    cfg->priv.read = 0;
+
+    /* Prepare image */
+    res = jd_prepare(&JDEC, jpeg_decode_in_cb, workbuf, workbuf_size, cfg);
+    ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in preparing JPEG image! %d", res);
+
+    const uint8_t scale_div       = jpeg_get_div_by_scale(cfg->out_scale);
+    const uint8_t out_color_bytes = jpeg_get_color_bytes(cfg->out_format);
+
+    /* Size of output image */
+    const uint32_t outsize = (JDEC.height / scale_div) * (JDEC.width / scale_div) * out_color_bytes;
+    ESP_GOTO_ON_FALSE((outsize <= cfg->outbuf_size), ESP_ERR_NO_MEM, err, TAG, "Not enough size in output buffer!");
+
+    /* Size of output image */
+    img->height = JDEC.height / scale_div;
+    img->width = JDEC.width / scale_div;
+    img->output_len = outsize;
+
+    /* Decode the halves of the image on both cores if it can be split at a restart marker */
+    if (cfg->flags.parallel_decode) {
+        ret = jpeg_decode_parallel(cfg, &JDEC, workbuf, workbuf_size);
+        if (ret != ESP_ERR_NOT_SUPPORTED) {
+            goto err;
+        }
+        /* Not split, JDEC is still prepared for the whole image */
+        ret = ESP_OK;
+    }
+
+    /* Decode JPEG */
+    res = jd_decomp(&JDEC, jpeg_decode_out_cb, cfg->out_scale);
+    ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in decoding JPEG image! %d", res);
+
+err:
+    if (workbuf && allocate_buffer) {
+        free(workbuf);
+    }
+
+    return ret;
+}
+
+esp_err_t esp_jpeg_get_image_info(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img)
+{
+    if (cfg == NULL || img == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (cfg->indata == NULL || cfg->indata_size < 5) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_FAIL;
+
+    if (ldb_word(cfg->indata) != 0xFFD8) {
+        return ESP_FAIL;    /* Err: SOI is not detected */
+    }
+    unsigned ofs = 2; // Start after SOI marker
+
+    while (true) {
+        /* Get a JPEG marker */
+        uint8_t *seg = cfg->indata + ofs;       /* Segment pointer */
+        unsigned short marker = ldb_word(seg);  /* Marker */
+        unsigned int len = ldb_word(seg + 2);   /* Length field */
+        if (len <= 2 || (marker >> 8) != 0xFF) {
+            return ESP_FAIL;
+        }
+        ofs += 2 + len; /* Number of bytes loaded */
+        if (ofs > cfg->indata_size) {
+            return ESP_FAIL; // No more data
+        }
+
+        if ((marker & 0xFF) == 0xC0) {  /* SOF0 (baseline JPEG) */
+            seg += 4; /* Skip marker and length field */
+
+            /* Size of output image */
+            img->height = ldb_word(seg + 1);
+            img->width = ldb_word(seg + 3);
+            const uint8_t scale_div       = jpeg_get_div_by_scale(cfg->out_scale);
+            const uint8_t out_color_bytes = jpeg_get_color_bytes(cfg->out_format);
+            if (cfg->out_format == JPEG_IMAGE_FORMAT_MONO1) {
+                img->output_len = (img->height / scale_div) * ((img->width / scale_div + 7) / 8);
+            } else {
+                img->output_len = (img->height / scale_div) * (img->width / scale_div) * out_color_bytes;
+            }
+            ret = ESP_OK;
+            break;
+        }
+    }
+    return ret;
+}
+
+/*******************************************************************************
+* Private API functions
+*******************************************************************************/
+
+static jpeg_decode_in_t jpeg_decode_in_cb(JDEC *dec, uint8_t *buff, jpeg_decode_in_t nbyte)
+{
+    assert(dec != NULL);
+
+    uint32_t to_read = nbyte;
+    esp_jpeg_image_cfg_t *cfg = (esp_jpeg_image_cfg_t *)dec->device;
+    assert(cfg != NULL);
+
+    if (buff) {
+        if (cfg->priv.read + to_read > cfg->indata_size) {
+            to_read = cfg->indata_size - cfg->priv.read;
+        }
+
+        /* Copy data from JPEG image */
+        memcpy(buff, &cfg->indata[cfg->priv.read], to_read);
+        cfg->priv.read += to_read;
+    } else if (buff == NULL) {
+        /* Skip data */
+        cfg->priv.read += to_read;
+    }
+
+    return to_read;
+}
+
+static jpeg_decode_out_t jpeg_decode_out_cb(JDEC *dec, void *bitmap, JRECT *rect)
+{
+    uint16_t color = 0;
+    assert(dec != NULL);
+
+    esp_jpeg_image_cfg_t *cfg = (esp_jpeg_image_cfg_t *)dec->device;
+    assert(cfg != NULL);
+    assert(bitmap != NULL);
+    assert(rect != NULL);
+
+    uint8_t scale_div = jpeg_get_div_by_scale(cfg->out_scale);
+    uint8_t out_color_bytes = jpeg_get_color_bytes(cfg->out_format);
+
+    /* Copy decoded image data to output buffer */
+    uint8_t *in = (uint8_t *)bitmap;
+    uint32_t line = dec->width / scale_div;
+    uint8_t *dst = (uint8_t *)cfg->outbuf;
+    for (int y = rect->top; y <= rect->bottom; y++) {
+        for (int x = rect->left; x <= rect->right; x++) {
+            if ( (JD_FORMAT == 0 && cfg->out_format == JPEG_IMAGE_FORMAT_RGB888) ||
+                    (JD_FORMAT == 1 && cfg->out_format == JPEG_IMAGE_FORMAT_RGB565) ) {
+                /* Output image format is same as set in TJPGD */
+                for (int b = 0; b < ESP_JPEG_COLOR_BYTES; b++) {
+                    if (cfg->flags.swap_color_bytes) {
+                        dst[(y * line * out_color_bytes) + x * out_color_bytes + b] = in[out_color_bytes - b - 1];
+                    } else {
+                        dst[(y * line * out_color_bytes) + x * out_color_bytes + b] = in[b];
+                    }
+                }
+            } else if (JD_FORMAT == 0 && cfg->out_format == JPEG_IMAGE_FORMAT_RGB565) {
+                /* Output image format is not same as set in TJPGD */
+                /* We need to convert the 3 bytes in `in` to a rgb565 value */
+                color = ((in[0] & 0xF8) << 8);
+                color |= ((in[1] & 0xFC) << 3);
+                color |= (in[2] >> 3);
+
+                if (cfg->flags.swap_color_bytes) {
+                    dst[(y * line * out_color_bytes) + (x * out_color_bytes)] = HIBYTE(color);
+                    dst[(y * line * out_color_bytes) + (x * out_color_bytes) + 1] = LOBYTE(color);
+                } else {
+                    dst[(y * line * out_color_bytes) + (x * out_color_bytes) + 1] = HIBYTE(color);
+                    dst[(y * line * out_color_bytes) + (x * out_color_bytes)] = LOBYTE(color);
+                }
+            } else {
+                ESP_LOGE(TAG, "Selected output format is not supported!");
+                assert(0);
+            }
+            in += ESP_JPEG_COLOR_BYTES;
+        }
+    }
+
+    return 1;
+}
+
+#if !CONFIG_FREERTOS_UNICORE
+static jpeg_decode_in_t jpeg_slice_in_cb(JDEC *dec, uint8_t *buff, jpeg_decode_in_t nbyte)
+{
+    static const uint8_t eoi[] = {0xFF, 0xD9};
+    assert(dec != NULL);
+
+    jpeg_slice_t *slice = (jpeg_slice_t *)dec->device;
+    assert(slice != NULL);
+
+    /* The band is read as headers, entropy-coded data and optional EOI */
+    const uint32_t start = slice->cfg.priv.read;
+    const uint32_t data_end = slice->header_len + slice->data_len;
+    const uint32_t total = data_end + (slice->add_eoi ? sizeof(eoi) : 0);
+    if (nbyte > total - start) {
+        nbyte = total - start;
+    }
+    slice->cfg.priv.read += nbyte;
+    if (buff == NULL) {
+        /* Skip data */
+        slice->last_ff = false;
+        return nbyte;
+    }
+
+    const uint32_t end = start + nbyte;
+    for (uint32_t pos = start; pos < end;) {
+        const uint8_t *src;
+        uint32_t avail;
+        if (pos < slice->header_len) {
+            src = &slice->cfg.indata[pos];
+            avail = slice->header_len - pos;
+        } else if (pos < data_end) {
+            src = &slice->data[pos - slice->header_len];
+            avail = data_end - pos;
+        } else {
+            src = &eoi[pos - data_end];
+            avail = total - pos;
+        }
+        if (avail > end - pos) {
+            avail = end - pos;
+        }
+        memcpy(&buff[pos - start], src, avail);
+        pos += avail;
+    }
+
+    /* Present the band height instead of the image height */
+    for (uint32_t i = 0; i < 2; i++) {
+        const uint32_t pos = slice->height_ofs + i;
+        if (pos >= start && pos < end) {
+            buff[pos - start] = i ? LOBYTE(slice->height) : HIBYTE(slice->height);
+        }
+    }
+
+    /* TJpgDec expects the restart markers to count from RST0 */
+    const uint32_t data_from = start > slice->header_len ? start : slice->header_len;
+    const uint32_t data_to = end < data_end ? end : data_end;
+    if (slice->rst_base && data_from < data_to) {
+        uint8_t *p = &buff[data_from - start];
+        uint8_t *const p_end = &buff[data_to - start];
+        if (slice->last_ff && JPEG_IS_RST(*p)) {
+            *p = 0xD0 | ((*p - slice->rst_base) & 7);
+        }
+        while ((p = memchr(p, 0xFF, p_end - p)) != NULL && ++p < p_end) {
+            if (JPEG_IS_RST(*p)) {
+                *p = 0xD0 | ((*p - slice->rst_base) & 7);
+            }
+        }
+        slice->last_ff = (p_end[-1] == 0xFF);
+    }
+
+    return nbyte;
+}
+
+static JRESULT jpeg_decode_slice(jpeg_slice_t *slice)
+{
+    JDEC jd;
+
+    slice->cfg.priv.read = 0;
+    slice->last_ff = false;
+    JRESULT res = jd_prepare(&jd, jpeg_slice_in_cb, slice->workbuf, slice->workbuf_size, slice);
+    if (res == JDR_OK) {
+        res = jd_decomp(&jd, jpeg_decode_out_cb, slice->cfg.out_scale);
+    }
+    return res;
+}
+
+static void jpeg_slice_task(void *arg)
+{
+    jpeg_slice_t *slice = (jpeg_slice_t *)arg;
+
+    slice->res = jpeg_decode_slice(slice);
+    xSemaphoreGive(slice->done);
+    vTaskDelete(NULL);
+}
+
+/* Offsets of the image height in the SOF0 segment and of the end of the SOS segment */
+static bool jpeg_get_layout(const esp_jpeg_image_cfg_t *cfg, uint32_t *height_ofs, uint32_t *header_len)
+{
+    uint32_t ofs = 2; // Start after SOI marker
+
+    *height_ofs = 0;
+    while (ofs + 4 <= cfg->indata_size) {
+        if (cfg->indata[ofs] == 0xFF && cfg->indata[ofs + 1] == 0xFF) {
+            ofs++;  /* Skip fill byte */
+            continue;
+        }
+        const uint16_t marker = ldb_word(&cfg->indata[ofs]);
+        const uint32_t len = ldb_word(&cfg->indata[ofs + 2]);
+        if (len <= 2 || (marker >> 8) != 0xFF) {
+            return false;
+        }
+        if ((marker & 0xFF) == 0xC0) {
+            *height_ofs = ofs + 5;  /* Marker, length and sample precision */
+        } else if ((marker & 0xFF) == 0xDA) {
+            *header_len = ofs + 2 + len;
+            return *height_ofs != 0 && *header_len < cfg->indata_size;
+        }
+        ofs += 2 + len;
+    }
+    return false;
+}
+
+/* Position of the count-th restart marker, NULL if the data ends or another marker comes first */
+static const uint8_t *jpeg_find_rst(const uint8_t *p, const uint8_t *end, uint32_t count)
+{
+    while ((p = memchr(p, 0xFF, end - p)) != NULL && p + 1 < end) {
+        if (p[1] == 0x00 || p[1] == 0xFF) {
+            p++;    /* Stuffed byte or fill byte */
+        } else if (JPEG_IS_RST(p[1])) {
+            if (--count == 0) {
+                return p;
+            }
+            p += 2;
+        } else {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Split the image at the restart marker closest to the middle that starts an MCU row and decode
+ * the top band on this core and the bottom band on the other one.
+ * Returns ESP_ERR_NOT_SUPPORTED without touching the working buffer if the image cannot be split.
+ */
+static esp_err_t jpeg_decode_parallel(esp_jpeg_image_cfg_t *cfg, const JDEC *jd, void *workbuf, size_t workbuf_size)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t height_ofs, header_len;
+
+    if (jd->nrst == 0 || !jpeg_get_layout(cfg, &height_ofs, &header_len)) {
+        ESP_LOGD(TAG, "No restart markers, decoding on one core");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /* Bands must start at an MCU row. Every rows_per_step MCU rows start with a restart interval. */
+    const uint32_t mcu_height = jd->msy * 8;
+    const uint32_t mcus_per_row = (jd->width + jd->msx * 8 - 1) / (jd->msx * 8);
+    const uint32_t mcu_rows = (jd->height + mcu_height - 1) / mcu_height;
+    uint32_t a = jd->nrst, b = mcus_per_row;
+    while (b) {
+        const uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    const uint32_t rows_per_step = jd->nrst / a;
+    const uint32_t split_row = (mcu_rows + rows_per_step) / (2 * rows_per_step) * rows_per_step;
+    if (split_row == 0 || split_row >= mcu_rows) {
+        ESP_LOGD(TAG, "Restart interval too long to split the image");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    const uint32_t split_interval = split_row * mcus_per_row / jd->nrst;
+
+    const uint8_t *data = &cfg->indata[header_len];
+    const uint8_t *data_end = &cfg->indata[cfg->indata_size];
+    const uint8_t *rst = jpeg_find_rst(data, data_end, split_interval);
+    if (rst == NULL || (rst[1] & 7) != ((split_interval - 1) & 7)) {
+        ESP_LOGD(TAG, "Restart marker %"PRIu32" not found", split_interval);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    const uint8_t scale_div = jpeg_get_div_by_scale(cfg->out_scale);
+    const uint32_t top_height = split_row * mcu_height;
+    const uint32_t top_len = (top_height / scale_div) * (jd->width / scale_div) * jpeg_get_color_bytes(cfg->out_format);
+
+    jpeg_slice_t slices[2] = {
+        {
+            .cfg = *cfg,
+            .header_len = header_len,
+            .height_ofs = height_ofs,
+            .height = top_height,
+            .data = data,
+            .data_len = rst - data,
+            .add_eoi = true,
+            .workbuf = workbuf,
+            .workbuf_size = workbuf_size,
+        },
+        {
+            .cfg = *cfg,
+            .header_len = header_len,
+            .height_ofs = height_ofs,
+            .height = jd->height - top_height,
+            .data = rst + 2,
+            .data_len = data_end - (rst + 2),
+            .rst_base = split_interval & 7,
+            .workbuf_size = workbuf_size,
+        },
+    };
+    slices[1].cfg.outbuf += top_len;
+    slices[1].cfg.outbuf_size -= top_len;
+
+    StaticSemaphore_t done_buf;
+    slices[1].done = xSemaphoreCreateBinaryStatic(&done_buf);
+    slices[1].workbuf = heap_caps_malloc(workbuf_size, MALLOC_CAP_DEFAULT);
+    if (slices[1].workbuf == NULL) {
+        ESP_LOGD(TAG, "no mem for second JPEG work buffer, decoding on one core");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (xTaskCreatePinnedToCore(jpeg_slice_task, "jpeg_slice", JPEG_SLICE_TASK_STACK, &slices[1],
+                                uxTaskPriorityGet(NULL), NULL, !xPortGetCoreID()) != pdPASS) {
+        free(slices[1].workbuf);
+        ESP_LOGD(TAG, "no mem for JPEG slice task, decoding on one core");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    slices[0].res = jpeg_decode_slice(&slices[0]);
+    xSemaphoreTake(slices[1].done, portMAX_DELAY);
+    free(slices[1].workbuf);
+
+    ESP_GOTO_ON_FALSE(slices[0].res == JDR_OK && slices[1].res == JDR_OK, ESP_FAIL, err, TAG,
+                      "Error in decoding JPEG image! %d %d", slices[0].res, slices[1].res);
+err:
+    return ret;
+}
+#else
+static esp_err_t jpeg_decode_parallel(esp_jpeg_image_cfg_t *cfg, const JDEC *jd, void *workbuf, size_t workbuf_size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
+
+static uint8_t jpeg_get_div_by_scale(esp_jpeg_image_scale_t scale)
+{
+    switch (scale) {
+    /* Not scaled */
+    case JPEG_IMAGE_SCALE_0:
+        return 1;
+    /* Scaled 1:2 */
+    case JPEG_IMAGE_SCALE_1_2:
+        return 2;
+    /* Scaled 1:4 */
+    case JPEG_IMAGE_SCALE_1_4:
+        return 4;
+    /* Scaled 1:8 */
+    case JPEG_IMAGE_SCALE_1_8:
+        return 8;
+    }
+
+    return 1;
+}
+
+static uint8_t jpeg_get_color_bytes(esp_jpeg_image_format_t format)
+{
+    switch (format) {
+    /* RGB888 (24-bit/pix) */
+    case JPEG_IMAGE_FORMAT_RGB888:
+        return 3;
+    /* RGB565 (16-bit/pix) */
+    case JPEG_IMAGE_FORMAT_RGB565:
+        return 2;
+    /* Grayscale (8-bit/pix) */
+    case JPEG_IMAGE_FORMAT_GRAY8:
+    /* Monochrome (1-bit/pix), packed by the caller */
+    case JPEG_IMAGE_FORMAT_MONO1:
+        return 1;
+    }
+
+    return 1;
+}
+
+static inline uint16_t ldb_word(const void *ptr)
+{
+    const uint8_t *p = (const uint8_t *)ptr;
+    return ((uint16_t)p[0] << 8) | p[1];
+}
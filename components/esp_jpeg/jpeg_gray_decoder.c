@@ -0,0 +1,627 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "jpeg_gray_decoder.h"
+
+static const char *TAG = "JPEG_GRAY";
+
+#define JPEG_GRAY_LOOKAHEAD   8       /* Huffman codes up to this length are decoded with one table lookup */
+#define JPEG_GRAY_TABLES      2       /* Table IDs 0 and 1, the same limit as TJpgDec */
+#define JPEG_GRAY_COMPONENTS  3
+
+/* Zigzag-order to raster-order conversion table */
+static const uint8_t jpeg_gray_zig[64] = {
+    0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/* Scale factors of the Arai IDCT in raster order, the same as TJpgDec applies to the de-quantizers */
+static const uint16_t jpeg_gray_ipsf[64] = {
+    (uint16_t)(1.00000 * 8192), (uint16_t)(1.38704 * 8192), (uint16_t)(1.30656 * 8192), (uint16_t)(1.17588 * 8192), (uint16_t)(1.00000 * 8192), (uint16_t)(0.78570 * 8192), (uint16_t)(0.54120 * 8192), (uint16_t)(0.27590 * 8192),
+    (uint16_t)(1.38704 * 8192), (uint16_t)(1.92388 * 8192), (uint16_t)(1.81226 * 8192), (uint16_t)(1.63099 * 8192), (uint16_t)(1.38704 * 8192), (uint16_t)(1.08979 * 8192), (uint16_t)(0.75066 * 8192), (uint16_t)(0.38268 * 8192),
+    (uint16_t)(1.30656 * 8192), (uint16_t)(1.81226 * 8192), (uint16_t)(1.70711 * 8192), (uint16_t)(1.53636 * 8192), (uint16_t)(1.30656 * 8192), (uint16_t)(1.02656 * 8192), (uint16_t)(0.70711 * 8192), (uint16_t)(0.36048 * 8192),
+    (uint16_t)(1.17588 * 8192), (uint16_t)(1.63099 * 8192), (uint16_t)(1.53636 * 8192), (uint16_t)(1.38268 * 8192), (uint16_t)(1.17588 * 8192), (uint16_t)(0.92388 * 8192), (uint16_t)(0.63638 * 8192), (uint16_t)(0.32442 * 8192),
+    (uint16_t)(1.00000 * 8192), (uint16_t)(1.38704 * 8192), (uint16_t)(1.30656 * 8192), (uint16_t)(1.17588 * 8192), (uint16_t)(1.00000 * 8192), (uint16_t)(0.78570 * 8192), (uint16_t)(0.54120 * 8192), (uint16_t)(0.27590 * 8192),
+    (uint16_t)(0.78570 * 8192), (uint16_t)(1.08979 * 8192), (uint16_t)(1.02656 * 8192), (uint16_t)(0.92388 * 8192), (uint16_t)(0.78570 * 8192), (uint16_t)(0.61732 * 8192), (uint16_t)(0.42522 * 8192), (uint16_t)(0.21677 * 8192),
+    (uint16_t)(0.54120 * 8192), (uint16_t)(0.75066 * 8192), (uint16_t)(0.70711 * 8192), (uint16_t)(0.63638 * 8192), (uint16_t)(0.54120 * 8192), (uint16_t)(0.42522 * 8192), (uint16_t)(0.29290 * 8192), (uint16_t)(0.14932 * 8192),
+    (uint16_t)(0.27590 * 8192), (uint16_t)(0.38268 * 8192), (uint16_t)(0.36048 * 8192), (uint16_t)(0.32442 * 8192), (uint16_t)(0.27590 * 8192), (uint16_t)(0.21678 * 8192), (uint16_t)(0.14932 * 8192), (uint16_t)(0.07612 * 8192)
+};
+
+/* 8x8 Bayer matrix as thresholds for the ordered dithering of JPEG_IMAGE_FORMAT_MONO1 */
+static const uint8_t jpeg_gray_bayer[8][8] = {
+    {  2, 130,  34, 162,  10, 138,  42, 170},
+    {194,  66, 226,  98, 202,  74, 234, 106},
+    { 50, 178,  18, 146,  58, 186,  26, 154},
+    {242, 114, 210,  82, 250, 122, 218,  90},
+    { 14, 142,  46, 174,   6, 134,  38, 166},
+    {206,  78, 238, 110, 198,  70, 230, 102},
+    { 62, 190,  30, 158,  54, 182,  22, 150},
+    {254, 126, 222,  94, 246, 118, 214,  86},
+};
+
+typedef struct {
+    uint8_t look_len[1 << JPEG_GRAY_LOOKAHEAD];   /* Code length of the code prefixed by the index, 0: longer code */
+    uint8_t look_sym[1 << JPEG_GRAY_LOOKAHEAD];   /* Symbol of that code */
+    uint8_t vals[256];
+    int32_t maxcode[17];
+    int32_t valoffset[17];
+    bool loaded;
+} jpeg_gray_huff_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h, v;
+    uint8_t tq;
+} jpeg_gray_frame_comp_t;
+
+typedef struct {
+    uint8_t frame_idx;      /* Index into the frame components, 0 is luminance */
+    const jpeg_gray_huff_t *dc;
+    const jpeg_gray_huff_t *ac;
+    int pred;               /* DC predictor */
+} jpeg_gray_scan_comp_t;
+
+typedef struct {
+    jpeg_gray_huff_t dc[JPEG_GRAY_TABLES];
+    jpeg_gray_huff_t ac[JPEG_GRAY_TABLES];
+    int32_t qt[4][64];      /* De-quantizers in raster order, pre-scaled for the Arai IDCT */
+    jpeg_gray_frame_comp_t frame[JPEG_GRAY_COMPONENTS];
+    jpeg_gray_scan_comp_t scan[JPEG_GRAY_COMPONENTS];
+    uint8_t nframe, nscan;
+    uint16_t width, height;
+    uint16_t nrst;
+
+    /* Bit reader over the entropy coded data */
+    const uint8_t *ptr;
+    const uint8_t *end;
+    uint32_t wreg;
+    int dbit;
+    bool marker;
+
+    /* Output image */
+    uint8_t *out;
+    uint16_t out_w, out_h;
+    uint16_t stride;        /* Bytes per output row */
+    uint8_t shift;          /* Output scale 1:(1 << shift) */
+    bool mono;              /* JPEG_IMAGE_FORMAT_MONO1 */
+} jpeg_gray_ctx_t;
+
+static inline uint16_t jpeg_gray_word(const uint8_t *p)
+{
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static bool jpeg_gray_build_huff(jpeg_gray_huff_t *h, const uint8_t *bits, const uint8_t *vals)
+{
+    int code = 0, k = 0;
+
+    memset(h->look_len, 0, sizeof(h->look_len));
+    for (int l = 1; l <= 16; l++) {
+        if (code + bits[l - 1] > (1 << l)) {
+            return false;   /* Over-subscribed code */
+        }
+        h->valoffset[l] = k - code;
+        for (int i = 0; i < bits[l - 1]; i++, k++, code++) {
+            h->vals[k] = vals[k];
+            if (l <= JPEG_GRAY_LOOKAHEAD) {
+                int shift = JPEG_GRAY_LOOKAHEAD - l;
+                for (int j = 0; j < (1 << shift); j++) {
+                    h->look_len[(code << shift) | j] = l;
+                    h->look_sym[(code << shift) | j] = vals[k];
+                }
+            }
+        }
+        h->maxcode[l] = bits[l - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    h->loaded = true;
+    return true;
+}
+
+#if CONFIG_JD_DEFAULT_HUFFMAN
+extern const unsigned char esp_jpeg_lum_dc_num_bits[16];
+extern const unsigned char esp_jpeg_lum_dc_values[12];
+extern const unsigned char esp_jpeg_chrom_dc_num_bits[16];
+extern const unsigned char esp_jpeg_chrom_dc_values[12];
+extern const unsigned char esp_jpeg_lum_ac_num_bits[16];
+extern const unsigned char esp_jpeg_lum_ac_values[162];
+extern const unsigned char esp_jpeg_chrom_ac_num_bits[16];
+extern const unsigned char esp_jpeg_chrom_ac_values[162];
+
+static void jpeg_gray_load_default_huff(jpeg_gray_ctx_t *ctx)
+{
+    jpeg_gray_build_huff(&ctx->dc[0], esp_jpeg_lum_dc_num_bits, esp_jpeg_lum_dc_values);
+    jpeg_gray_build_huff(&ctx->dc[1], esp_jpeg_chrom_dc_num_bits, esp_jpeg_chrom_dc_values);
+    jpeg_gray_build_huff(&ctx->ac[0], esp_jpeg_lum_ac_num_bits, esp_jpeg_lum_ac_values);
+    jpeg_gray_build_huff(&ctx->ac[1], esp_jpeg_chrom_ac_num_bits, esp_jpeg_chrom_ac_values);
+}
+#endif
+
+static esp_err_t jpeg_gray_parse_dqt(jpeg_gray_ctx_t *ctx, const uint8_t *p, size_t len)
+{
+    while (len) {
+        uint8_t pq = p[0] >> 4, tq = p[0] & 0x0F;
+        size_t n = 1 + (pq ? 128 : 64);
+        ESP_RETURN_ON_FALSE(tq < 4 && n <= len, ESP_FAIL, TAG, "Bad DQT");
+        for (int i = 0; i < 64; i++) {
+            uint32_t q = pq ? jpeg_gray_word(p + 1 + i * 2) : p[1 + i];
+            ctx->qt[tq][jpeg_gray_zig[i]] = (int32_t)(q * jpeg_gray_ipsf[jpeg_gray_zig[i]]);
+        }
+        p += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t jpeg_gray_parse_dht(jpeg_gray_ctx_t *ctx, const uint8_t *p, size_t len)
+{
+    while (len >= 17) {
+        uint8_t tc = p[0] >> 4, th = p[0] & 0x0F;
+        size_t n = 0;
+        for (int i = 1; i <= 16; i++) {
+            n += p[i];
+        }
+        ESP_RETURN_ON_FALSE(tc < 2 && th < JPEG_GRAY_TABLES && n <= 256 && 17 + n <= len, ESP_FAIL, TAG, "Bad DHT");
+        jpeg_gray_huff_t *h = tc ? &ctx->ac[th] : &ctx->dc[th];
+        ESP_RETURN_ON_FALSE(jpeg_gray_build_huff(h, p + 1, p + 17), ESP_FAIL, TAG, "Bad DHT");
+        p += 17 + n;
+        len -= 17 + n;
+    }
+    return len ? ESP_FAIL : ESP_OK;
+}
+
+static esp_err_t jpeg_gray_parse_sof(jpeg_gray_ctx_t *ctx, const uint8_t *p, size_t len)
+{
+    ESP_RETURN_ON_FALSE(len >= 6 && p[0] == 8, ESP_FAIL, TAG, "Bad SOF");
+    ctx->height = jpeg_gray_word(p + 1);
+    ctx->width = jpeg_gray_word(p + 3);
+    ctx->nframe = p[5];
+    ESP_RETURN_ON_FALSE((ctx->nframe == 1 || ctx->nframe == 3) && len >= 6 + 3 * (size_t)ctx->nframe, ESP_FAIL, TAG, "Bad SOF");
+    for (int i = 0; i < ctx->nframe; i++) {
+        jpeg_gray_frame_comp_t *fc = &ctx->frame[i];
+        fc->id = p[6 + i * 3];
+        fc->h = p[7 + i * 3] >> 4;
+        fc->v = p[7 + i * 3] & 0x0F;
+        fc->tq = p[8 + i * 3];
+        ESP_RETURN_ON_FALSE(fc->h && fc->v && fc->h <= 4 && fc->v <= 4 && fc->tq < 4, ESP_FAIL, TAG, "Bad SOF");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t jpeg_gray_parse_sos(jpeg_gray_ctx_t *ctx, const uint8_t *p, size_t len)
+{
+    ctx->nscan = len ? p[0] : 0;
+    ESP_RETURN_ON_FALSE(ctx->nframe && ctx->nscan && ctx->nscan <= ctx->nframe && len >= 1 + 2 * (size_t)ctx->nscan, ESP_FAIL, TAG, "Bad SOS");
+    bool has_y = false;
+    for (int i = 0; i < ctx->nscan; i++) {
+        uint8_t id = p[1 + i * 2], td = p[2 + i * 2] >> 4, ta = p[2 + i * 2] & 0x0F;
+        int f = 0;
+        while (f < ctx->nframe && ctx->frame[f].id != id) {
+            f++;
+        }
+        ESP_RETURN_ON_FALSE(f < ctx->nframe && td < JPEG_GRAY_TABLES && ta < JPEG_GRAY_TABLES, ESP_FAIL, TAG, "Bad SOS");
+#if CONFIG_JD_DEFAULT_HUFFMAN
+        if (!ctx->dc[td].loaded || !ctx->ac[ta].loaded) {
+            jpeg_gray_load_default_huff(ctx);
+        }
+#endif
+        ESP_RETURN_ON_FALSE(ctx->dc[td].loaded && ctx->ac[ta].loaded, ESP_FAIL, TAG, "Huffman table not loaded");
+        ctx->scan[i].frame_idx = f;
+        ctx->scan[i].dc = &ctx->dc[td];
+        ctx->scan[i].ac = &ctx->ac[ta];
+        ctx->scan[i].pred = 0;
+        has_y |= (f == 0);
+    }
+    /* The luminance has to be in the first scan, following scans are not read */
+    ESP_RETURN_ON_FALSE(has_y, ESP_ERR_NOT_SUPPORTED, TAG, "First scan has no luminance");
+    return ESP_OK;
+}
+
+/* Walk the segments up to the first SOS, leaves ctx->ptr at the entropy coded data */
+static esp_err_t jpeg_gray_parse_header(jpeg_gray_ctx_t *ctx, const uint8_t *data, size_t size)
+{
+    size_t ofs = 2;
+
+    ESP_RETURN_ON_FALSE(size > 4 && jpeg_gray_word(data) == 0xFFD8, ESP_FAIL, TAG, "SOI is not detected");
+    while (ofs + 4 <= size) {
+        if (data[ofs] != 0xFF) {
+            return ESP_FAIL;
+        }
+        uint8_t marker = data[ofs + 1];
+        if (marker == 0xFF) {
+            ofs++;          /* Fill byte or broken 0xFFFF marker */
+            continue;
+        }
+        size_t len = jpeg_gray_word(data + ofs + 2);
+        ESP_RETURN_ON_FALSE(len >= 2 && ofs + 2 + len <= size, ESP_FAIL, TAG, "Truncated segment");
+        const uint8_t *seg = data + ofs + 4;
+        len -= 2;
+        esp_err_t ret = ESP_OK;
+        switch (marker) {
+        case 0xDB:
+            ret = jpeg_gray_parse_dqt(ctx, seg, len);
+            break;
+        case 0xC4:
+            ret = jpeg_gray_parse_dht(ctx, seg, len);
+            break;
+        case 0xC0:
+        case 0xC1:
+            ret = jpeg_gray_parse_sof(ctx, seg, len);
+            break;
+        case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+        case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+            return ESP_ERR_NOT_SUPPORTED;   /* Progressive, lossless or arithmetic coding */
+        case 0xDD:
+            ESP_RETURN_ON_FALSE(len >= 2, ESP_FAIL, TAG, "Bad DRI");
+            ctx->nrst = jpeg_gray_word(seg);
+            break;
+        case 0xDA:
+            ret = jpeg_gray_parse_sos(ctx, seg, len);
+            ctx->ptr = seg + len;
+            ctx->end = data + size;
+            return ret;
+        default:
+            break;
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        ofs += 4 + len;
+    }
+    return ESP_FAIL;
+}
+
+static inline uint8_t jpeg_gray_clip(int32_t v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline void jpeg_gray_fill(jpeg_gray_ctx_t *ctx)
+{
+    while (ctx->dbit <= 24) {
+        uint32_t b = 0;
+        if (!ctx->marker && ctx->ptr < ctx->end) {
+            b = *ctx->ptr;
+            if (b == 0xFF) {
+                if (ctx->ptr + 1 < ctx->end && ctx->ptr[1] == 0x00) {
+                    ctx->ptr += 2;      /* Stuffed zero */
+                } else {
+                    ctx->marker = true; /* Marker reached, feed zeros until it is handled */
+                    b = 0;
+                }
+            } else {
+                ctx->ptr++;
+            }
+        }
+        ctx->wreg |= b << (24 - ctx->dbit);
+        ctx->dbit += 8;
+    }
+}
+
+static inline void jpeg_gray_skip(jpeg_gray_ctx_t *ctx, int n)
+{
+    ctx->wreg <<= n;
+    ctx->dbit -= n;
+}
+
+static inline int jpeg_gray_huff(jpeg_gray_ctx_t *ctx, const jpeg_gray_huff_t *h)
+{
+    jpeg_gray_fill(ctx);
+    uint32_t look = ctx->wreg >> (32 - JPEG_GRAY_LOOKAHEAD);
+    int l = h->look_len[look];
+    if (l) {
+        jpeg_gray_skip(ctx, l);
+        return h->look_sym[look];
+    }
+    uint32_t code16 = ctx->wreg >> 16;
+    for (l = JPEG_GRAY_LOOKAHEAD + 1; l <= 16; l++) {
+        int32_t code = code16 >> (16 - l);
+        if (code <= h->maxcode[l]) {
+            jpeg_gray_skip(ctx, l);
+            return h->vals[h->valoffset[l] + code];
+        }
+    }
+    return -1;
+}
+
+static esp_err_t jpeg_gray_restart(jpeg_gray_ctx_t *ctx)
+{
+    const uint8_t *p = ctx->ptr;
+    while (p + 1 < ctx->end && p[0] == 0xFF && p[1] == 0xFF) {
+        p++;
+    }
+    ESP_RETURN_ON_FALSE(p + 1 < ctx->end && p[0] == 0xFF && (p[1] & 0xF8) == 0xD0, ESP_FAIL, TAG, "RST marker not found");
+    ctx->ptr = p + 2;
+    ctx->wreg = 0;
+    ctx->dbit = 0;
+    ctx->marker = false;
+    for (int i = 0; i < ctx->nscan; i++) {
+        ctx->scan[i].pred = 0;
+    }
+    return ESP_OK;
+}
+
+/* Arai IDCT of a de-quantized block, the same arithmetic as TJpgDec */
+static void jpeg_gray_idct(int32_t *src, uint8_t *dst)
+{
+    const int32_t M13 = (int32_t)(1.41421 * 4096), M2 = (int32_t)(1.08239 * 4096), M4 = (int32_t)(2.61313 * 4096), M5 = (int32_t)(1.84776 * 4096);
+    int32_t v0, v1, v2, v3, v4, v5, v6, v7;
+    int32_t t10, t11, t12, t13;
+
+    /* Columns */
+    for (int i = 0; i < 8; i++, src++) {
+        v0 = src[8 * 0];
+        v1 = src[8 * 2];
+        v2 = src[8 * 4];
+        v3 = src[8 * 6];
+        t10 = v0 + v2;
+        t12 = v0 - v2;
+        t11 = (v1 - v3) * M13 >> 12;
+        v3 += v1;
+        t11 -= v3;
+        v0 = t10 + v3;
+        v3 = t10 - v3;
+        v1 = t11 + t12;
+        v2 = t12 - t11;
+
+        v4 = src[8 * 7];
+        v5 = src[8 * 1];
+        v6 = src[8 * 5];
+        v7 = src[8 * 3];
+        t10 = v5 - v4;
+        t11 = v5 + v4;
+        t12 = v6 - v7;
+        v7 += v6;
+        v5 = (t11 - v7) * M13 >> 12;
+        v7 += t11;
+        t13 = (t10 + t12) * M5 >> 12;
+        v4 = t13 - (t10 * M2 >> 12);
+        v6 = t13 - (t12 * M4 >> 12) - v7;
+        v5 -= v6;
+        v4 -= v5;
+
+        src[8 * 0] = v0 + v7;
+        src[8 * 7] = v0 - v7;
+        src[8 * 1] = v1 + v6;
+        src[8 * 6] = v1 - v6;
+        src[8 * 2] = v2 + v5;
+        src[8 * 5] = v2 - v5;
+        src[8 * 3] = v3 + v4;
+        src[8 * 4] = v3 - v4;
+    }
+
+    /* Rows, removing the DC offset and descaling 8 bits */
+    src -= 8;
+    for (int i = 0; i < 8; i++, src += 8, dst += 8) {
+        v0 = src[0] + (128L << 8);
+        v1 = src[2];
+        v2 = src[4];
+        v3 = src[6];
+        t10 = v0 + v2;
+        t12 = v0 - v2;
+        t11 = (v1 - v3) * M13 >> 12;
+        v3 += v1;
+        t11 -= v3;
+        v0 = t10 + v3;
+        v3 = t10 - v3;
+        v1 = t11 + t12;
+        v2 = t12 - t11;
+
+        v4 = src[7];
+        v5 = src[1];
+        v6 = src[5];
+        v7 = src[3];
+        t10 = v5 - v4;
+        t11 = v5 + v4;
+        t12 = v6 - v7;
+        v7 += v6;
+        v5 = (t11 - v7) * M13 >> 12;
+        v7 += t11;
+        t13 = (t10 + t12) * M5 >> 12;
+        v4 = t13 - (t10 * M2 >> 12);
+        v6 = t13 - (t12 * M4 >> 12) - v7;
+        v5 -= v6;
+        v4 -= v5;
+
+        dst[0] = jpeg_gray_clip((v0 + v7) >> 8);
+        dst[7] = jpeg_gray_clip((v0 - v7) >> 8);
+        dst[1] = jpeg_gray_clip((v1 + v6) >> 8);
+        dst[6] = jpeg_gray_clip((v1 - v6) >> 8);
+        dst[2] = jpeg_gray_clip((v2 + v5) >> 8);
+        dst[5] = jpeg_gray_clip((v2 - v5) >> 8);
+        dst[3] = jpeg_gray_clip((v3 + v4) >> 8);
+        dst[4] = jpeg_gray_clip((v3 - v4) >> 8);
+    }
+}
+
+static inline void jpeg_gray_put(jpeg_gray_ctx_t *ctx, unsigned x, unsigned y, uint8_t v)
+{
+    if (ctx->mono) {
+        if (v > jpeg_gray_bayer[y & 7][x & 7]) {
+            ctx->out[y * ctx->stride + x / 8] |= 0x80 >> (x & 7);
+        }
+    } else {
+        ctx->out[y * ctx->stride + x] = v;
+    }
+}
+
+/* Write a luminance block at block position bx, by. pix is NULL for a flat block of value dc. */
+static void jpeg_gray_output(jpeg_gray_ctx_t *ctx, unsigned bx, unsigned by, const uint8_t *pix, uint8_t dc)
+{
+    const unsigned n = 8 >> ctx->shift;     /* Output pixels per block side */
+    const unsigned x0 = bx * n, y0 = by * n;
+    if (x0 >= ctx->out_w || y0 >= ctx->out_h) {
+        return;
+    }
+    const unsigned nx = (ctx->out_w - x0) < n ? (ctx->out_w - x0) : n;
+    const unsigned ny = (ctx->out_h - y0) < n ? (ctx->out_h - y0) : n;
+
+    for (unsigned y = 0; y < ny; y++) {
+        for (unsigned x = 0; x < nx; x++) {
+            uint8_t v = dc;
+            if (pix) {
+                /* Average of the pixels covered by the output pixel */
+                unsigned sum = 0;
+                const uint8_t *p = &pix[(y << ctx->shift) * 8 + (x << ctx->shift)];
+                for (unsigned j = 0; j < (1u << ctx->shift); j++, p += 8) {
+                    for (unsigned i = 0; i < (1u << ctx->shift); i++) {
+                        sum += p[i];
+                    }
+                }
+                v = sum >> (2 * ctx->shift);
+            }
+            jpeg_gray_put(ctx, x0 + x, y0 + y, v);
+        }
+    }
+}
+
+static esp_err_t jpeg_gray_scan(jpeg_gray_ctx_t *ctx)
+{
+    unsigned hmax = 1, vmax = 1;
+    for (int i = 0; i < ctx->nframe; i++) {
+        hmax = ctx->frame[i].h > hmax ? ctx->frame[i].h : hmax;
+        vmax = ctx->frame[i].v > vmax ? ctx->frame[i].v : vmax;
+    }
+
+    /* An interleaved scan has h x v blocks of each component per MCU, a single component scan one block */
+    const bool interleaved = ctx->nscan > 1;
+    unsigned mcux, mcuy;
+    if (interleaved) {
+        mcux = (ctx->width + 8 * hmax - 1) / (8 * hmax);
+        mcuy = (ctx->height + 8 * vmax - 1) / (8 * vmax);
+    } else {
+        const jpeg_gray_frame_comp_t *fc = &ctx->frame[ctx->scan[0].frame_idx];
+        mcux = ((ctx->width * fc->h + hmax - 1) / hmax + 7) / 8;
+        mcuy = ((ctx->height * fc->v + vmax - 1) / vmax + 7) / 8;
+    }
+
+    /* At 1:8 a block is its DC value, AC coefficients are needed only to be skipped */
+    const bool dc_only = (ctx->shift == 3);
+    const int32_t *qt = ctx->qt[ctx->frame[0].tq];
+    int32_t coef[64];
+    uint8_t pix[64];
+    unsigned mcu = 0;
+    for (unsigned my = 0; my < mcuy; my++) {
+        for (unsigned mx = 0; mx < mcux; mx++, mcu++) {
+            if (ctx->nrst && mcu && (mcu % ctx->nrst) == 0 && jpeg_gray_restart(ctx) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            for (int i = 0; i < ctx->nscan; i++) {
+                jpeg_gray_scan_comp_t *sc = &ctx->scan[i];
+                const jpeg_gray_frame_comp_t *fc = &ctx->frame[sc->frame_idx];
+                const bool luma = (sc->frame_idx == 0);
+                const bool keep_ac = luma && !dc_only;
+                const unsigned nblk = interleaved ? fc->h * fc->v : 1;
+                for (unsigned b = 0; b < nblk; b++) {
+                    /* DC difference */
+                    int s = jpeg_gray_huff(ctx, sc->dc);
+                    ESP_RETURN_ON_FALSE(s >= 0 && s <= 15, ESP_FAIL, TAG, "Bad DC code");
+                    if (s) {
+                        jpeg_gray_fill(ctx);
+                        int d = ctx->wreg >> (32 - s);
+                        jpeg_gray_skip(ctx, s);
+                        if (d < (1 << (s - 1))) {
+                            d -= (1 << s) - 1;      /* Restore negative value */
+                        }
+                        sc->pred += d;
+                    }
+
+                    /* AC coefficients, de-quantized for luminance and skipped for chroma */
+                    bool has_ac = false;
+                    if (keep_ac) {
+                        memset(&coef[1], 0, 63 * sizeof(int32_t));
+                    }
+                    for (int k = 1; k < 64; k++) {
+                        int rs = jpeg_gray_huff(ctx, sc->ac);
+                        ESP_RETURN_ON_FALSE(rs >= 0, ESP_FAIL, TAG, "Bad AC code");
+                        s = rs & 0x0F;
+                        if (s) {
+                            k += rs >> 4;
+                            ESP_RETURN_ON_FALSE(k < 64, ESP_FAIL, TAG, "Too long zero run");
+                            jpeg_gray_fill(ctx);
+                            if (keep_ac) {
+                                int d = ctx->wreg >> (32 - s);
+                                if (d < (1 << (s - 1))) {
+                                    d -= (1 << s) - 1;
+                                }
+                                const unsigned z = jpeg_gray_zig[k];
+                                coef[z] = d * qt[z] >> 8;
+                                has_ac = true;
+                            }
+                            jpeg_gray_skip(ctx, s);
+                        } else if (rs == 0xF0) {
+                            k += 15;                /* ZRL */
+                        } else {
+                            break;                  /* EOB */
+                        }
+                    }
+
+                    if (luma) {
+                        unsigned bx = interleaved ? mx * fc->h + b % fc->h : mx;
+                        unsigned by = interleaved ? my * fc->v + b / fc->h : my;
+                        coef[0] = sc->pred * qt[0] >> 8;
+                        if (has_ac) {
+                            jpeg_gray_idct(coef, pix);
+                            jpeg_gray_output(ctx, bx, by, pix, 0);
+                        } else {
+                            /* Same descaling as TJpgDec uses for a block without AC coefficients */
+                            jpeg_gray_output(ctx, bx, by, NULL, jpeg_gray_clip(coef[0] / 256 + 128));
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t jpeg_gray_decode(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img)
+{
+    esp_err_t ret = ESP_OK;
+    jpeg_gray_ctx_t *ctx = NULL;
+
+    /* The decoder state is bigger than the TJpgDec default working buffer, use the user buffer only if it fits */
+    const bool allocate_buffer = (cfg->advanced.working_buffer == NULL || cfg->advanced.working_buffer_size < sizeof(jpeg_gray_ctx_t));
+    if (allocate_buffer) {
+        ctx = heap_caps_malloc(sizeof(jpeg_gray_ctx_t), MALLOC_CAP_DEFAULT);
+        ESP_RETURN_ON_FALSE(ctx, ESP_ERR_NO_MEM, TAG, "no mem for JPEG grayscale decoder");
+    } else {
+        ctx = cfg->advanced.working_buffer;
+    }
+    memset(ctx, 0, sizeof(jpeg_gray_ctx_t));
+
+    ESP_GOTO_ON_ERROR(jpeg_gray_parse_header(ctx, cfg->indata, cfg->indata_size), err, TAG, "Error in parsing JPEG header!");
+
+    ctx->shift = cfg->out_scale;
+    ctx->mono = (cfg->out_format == JPEG_IMAGE_FORMAT_MONO1);
+    ctx->out = cfg->outbuf;
+    ctx->out_w = ctx->width >> ctx->shift;
+    ctx->out_h = ctx->height >> ctx->shift;
+    ctx->stride = ctx->mono ? (ctx->out_w + 7) / 8 : ctx->out_w;
+
+    img->width = ctx->out_w;
+    img->height = ctx->out_h;
+    img->output_len = ctx->stride * ctx->out_h;
+    ESP_GOTO_ON_FALSE(img->output_len <= cfg->outbuf_size, ESP_ERR_NO_MEM, err, TAG, "Not enough size in output buffer!");
+    if (ctx->mono) {
+        memset(cfg->outbuf, 0, img->output_len);    /* Only white pixels are set */
+    }
+
+    ESP_GOTO_ON_ERROR(jpeg_gray_scan(ctx), err, TAG, "Error in decoding JPEG image!");
+
+err:
+    if (allocate_buffer) {
+        free(ctx);
+    }
+    return ret;
+}
@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "jpeg_decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Decode the luminance of a JPEG image to 8-bit grayscale or dithered 1-bit output
+ *
+ * Chroma blocks are entropy decoded only to be skipped, they are neither de-quantized nor transformed.
+ * Luminance blocks without AC coefficients and all blocks at 1:8 scale are filled from the DC coefficient without IDCT.
+ * The decoder does not depend on TJpgDec, so it also works when the ROM decoder is used.
+ *
+ * @note Called by esp_jpeg_decode() for JPEG_IMAGE_FORMAT_GRAY8 and JPEG_IMAGE_FORMAT_MONO1.
+ *
+ * @param[in]  cfg: Configuration structure
+ * @param[out] img: Output image info
+ *
+ * @return
+ *      - ESP_OK                on success
+ *      - ESP_ERR_NO_MEM        if there is no memory for the decoder state or the output buffer is too small
+ *      - ESP_ERR_NOT_SUPPORTED if the image is progressive, arithmetic coded or its first scan has no luminance
+ *      - ESP_FAIL              if there is an error in decoding JPEG
+ */
+esp_err_t jpeg_gray_decode(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img);
+
+#ifdef __cplusplus
+}
+#endif
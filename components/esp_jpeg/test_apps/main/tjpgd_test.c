@@ -3,12 +3,14 @@
  *
  * SPDX-License-Identifier: Unlicense OR CC0-1.0
  */
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include "sdkconfig.h"
 #include "unity.h"
+#include "esp_timer.h"
 
 
 #include "jpeg_decoder.h"
@@ -280,6 +282,58 @@ TEST_CASE("Test JPEG decompression library: No Huffman tables", "[esp_jpeg]")
     free(decoded);
 }
 
+/**
+ * @brief Test for JPEG decompression on both cores
+ *
+ * The USB camera frame has a restart marker after every MCU row, so it is split
+ * into two bands decoded in parallel. The output must be identical to
+ * the single-core decode for every scale.
+ */
+TEST_CASE("Test JPEG decompression library: Parallel decode with restart markers", "[esp_jpeg]")
+{
+    const int times = 20;
+    int decoded_outsize = 160 * 120 * 3;
+    uint8_t *single = malloc(decoded_outsize);
+    uint8_t *parallel = malloc(decoded_outsize);
+    TEST_ASSERT_NOT_NULL(single);
+    TEST_ASSERT_NOT_NULL(parallel);
+
+    for (esp_jpeg_image_scale_t scale = JPEG_IMAGE_SCALE_0; scale <= JPEG_IMAGE_SCALE_1_8; scale++) {
+        esp_jpeg_image_cfg_t jpeg_cfg = {
+            .indata = (uint8_t *)jpeg_no_huffman,
+            .indata_size = jpeg_no_huffman_len,
+            .outbuf = single,
+            .outbuf_size = decoded_outsize,
+            .out_format = JPEG_IMAGE_FORMAT_RGB888,
+            .out_scale = scale,
+        };
+        esp_jpeg_image_output_t outimg;
+        memset(single, 0x00, decoded_outsize);
+        memset(parallel, 0xff, decoded_outsize);
+
+        int64_t t = esp_timer_get_time();
+        for (int i = 0; i < times; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+        }
+        int64_t t_single = (esp_timer_get_time() - t) / times;
+
+        jpeg_cfg.outbuf = parallel;
+        jpeg_cfg.flags.parallel_decode = 1;
+        t = esp_timer_get_time();
+        for (int i = 0; i < times; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+        }
+        int64_t t_parallel = (esp_timer_get_time() - t) / times;
+
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(single, parallel, outimg.output_len);
+        printf("%dx%d single core %" PRId64 " us, parallel %" PRId64 " us\n", outimg.width, outimg.height,
+               t_single, t_parallel);
+    }
+
+    free(single);
+    free(parallel);
+}
+
 #endif
 
 /**
@@ -326,3 +380,85 @@ TEST_CASE("Test JPEG invalid marker 0xFFFF", "[esp_jpeg]")
     free(decoded);
 }
 
+
+static void test_gray_decode(const uint8_t *jpg, size_t jpg_len, uint16_t width, uint16_t height)
+{
+    const int times = 20;
+    uint8_t *rgb = malloc(width * height * 3);
+    uint8_t *gray = malloc(width * height);
+    uint8_t *mono = malloc((width + 7) / 8 * height);
+    TEST_ASSERT_NOT_NULL(rgb);
+    TEST_ASSERT_NOT_NULL(gray);
+    TEST_ASSERT_NOT_NULL(mono);
+
+    for (esp_jpeg_image_scale_t scale = JPEG_IMAGE_SCALE_0; scale <= JPEG_IMAGE_SCALE_1_8; scale++) {
+        const uint16_t w = width >> scale, h = height >> scale;
+        esp_jpeg_image_cfg_t jpeg_cfg = {
+            .indata = (uint8_t *)jpg,
+            .indata_size = jpg_len,
+            .outbuf = rgb,
+            .outbuf_size = width * height * 3,
+            .out_format = JPEG_IMAGE_FORMAT_RGB888,
+            .out_scale = scale,
+        };
+        esp_jpeg_image_output_t outimg;
+        int64_t t = esp_timer_get_time();
+        for (int i = 0; i < times; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+        }
+        int64_t t_rgb = (esp_timer_get_time() - t) / times;
+
+        jpeg_cfg.outbuf = gray;
+        jpeg_cfg.outbuf_size = width * height;
+        jpeg_cfg.out_format = JPEG_IMAGE_FORMAT_GRAY8;
+        t = esp_timer_get_time();
+        for (int i = 0; i < times; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+        }
+        int64_t t_gray = (esp_timer_get_time() - t) / times;
+        TEST_ASSERT_EQUAL(w, outimg.width);
+        TEST_ASSERT_EQUAL(h, outimg.height);
+        TEST_ASSERT_EQUAL(w * h, outimg.output_len);
+
+        /* Luminance of the RGB output. Colors clipped by the YCbCr conversion differ a bit more */
+        for (int i = 0; i < w * h; i++) {
+            const uint8_t *p = &rgb[i * 3];
+            int y = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+            TEST_ASSERT_UINT8_WITHIN(10, y, gray[i]);
+        }
+
+        jpeg_cfg.outbuf = mono;
+        jpeg_cfg.outbuf_size = (width + 7) / 8 * height;
+        jpeg_cfg.out_format = JPEG_IMAGE_FORMAT_MONO1;
+        t = esp_timer_get_time();
+        for (int i = 0; i < times; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+        }
+        int64_t t_mono = (esp_timer_get_time() - t) / times;
+        TEST_ASSERT_EQUAL((w + 7) / 8 * h, outimg.output_len);
+
+        /* Black and white stay black and white after dithering */
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                int bit = (mono[y * ((w + 7) / 8) + x / 8] >> (7 - (x & 7))) & 1;
+                if (gray[y * w + x] == 0) {
+                    TEST_ASSERT_EQUAL(0, bit);
+                } else if (gray[y * w + x] == 255) {
+                    TEST_ASSERT_EQUAL(1, bit);
+                }
+            }
+        }
+        printf("%dx%d RGB888 %" PRId64 " us, GRAY8 %" PRId64 " us, MONO1 %" PRId64 " us\n", w, h,
+               t_rgb, t_gray, t_mono);
+    }
+
+    free(rgb);
+    free(gray);
+    free(mono);
+}
+
+TEST_CASE("Test JPEG grayscale and monochrome decode", "[esp_jpeg]")
+{
+    test_gray_decode(logo_jpg, logo_jpg_len, TESTW, TESTH);
+    test_gray_decode(camera_2_jpg, camera_2_jpg_len, 160, 120);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "http_client.h"
+
+// Sessions that could not be submitted, held in memory until the server is reachable again.
+// When full, the oldest session is dropped.
+
+// Copies the session and its image. With an image resource name in upload_response only the run is pending.
+esp_err_t backlog_add(const session_data_t *session_data, const image_upload_response_t *upload_response);
+
+size_t backlog_count(void);
+
+// Uploads the pending images, then creates the runs with up to batch_size runs per request.
+// Stops at the first connection error or retryable response, and with ESP_ERR_TIMEOUT when
+// budget_ms is used up. No request is started after that, the rest stays for the next drain.
+esp_err_t backlog_drain(size_t batch_size, int budget_ms);
+
+esp_err_t backlog_upload_images(void);
+
+esp_err_t backlog_create_runs(size_t batch_size);
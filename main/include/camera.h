@@ -26,6 +26,26 @@
 
 esp_err_t camera_init_module(void);
 
+esp_err_t camera_suspend(void);
+
+esp_err_t camera_resume(void);
+
+esp_err_t camera_preview_start(void);
+
+void camera_preview_stop(void);
+
+camera_fb_t *camera_preview_get(void);
+
+void camera_preview_return(camera_fb_t *fb);
+
+esp_err_t camera_arm(void);
+
+void camera_disarm(void);
+
+camera_fb_t *camera_pretrigger_get(void);
+
+void camera_pretrigger_put(camera_fb_t *fb);
+
 esp_err_t camera_jpg_image_http_handler(httpd_req_t *req);
 
 camera_fb_t *camera_capture_frame(void);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal CBOR (RFC 8949) writer for definite-length items into a caller's buffer, it never
+// allocates. Writes past the end of the buffer are only counted, so len is the size the encoding
+// needs and a pass with a NULL buffer measures it.
+typedef struct
+{
+  uint8_t *buf;
+  size_t size;
+  size_t len;
+} cbor_writer_t;
+
+void cbor_writer_init(cbor_writer_t *writer, uint8_t *buf, size_t size);
+
+// True when everything written fit into the buffer
+bool cbor_writer_ok(const cbor_writer_t *writer);
+
+void cbor_write_uint(cbor_writer_t *writer, uint64_t value);
+
+void cbor_write_int(cbor_writer_t *writer, int64_t value);
+
+// Half precision when that keeps the value exact, single precision otherwise
+void cbor_write_float(cbor_writer_t *writer, float value);
+
+void cbor_write_text(cbor_writer_t *writer, const char *text);
+
+void cbor_write_bytes(cbor_writer_t *writer, const uint8_t *data, size_t len);
+
+// Tag 64 of RFC 8746, an array of uint8 as a byte string
+void cbor_write_uint8_array(cbor_writer_t *writer, const uint8_t *data, size_t len);
+
+// Followed by count items, or count key and value pairs
+void cbor_write_array(cbor_writer_t *writer, size_t count);
+
+void cbor_write_map(cbor_writer_t *writer, size_t count);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "http_client.h"
+
+typedef struct
+{
+  const char *uri;
+  const char *username;
+  const char *password;
+  const char *topic;
+} event_channel_config_t;
+
+// A persistent connection that announces a run the moment its session ends, ahead of the HTTP
+// submission. The event carries the run's idempotency key, so the backend merges it with the run
+// created over HTTP afterwards, which also brings the image.
+typedef struct
+{
+  const char *name;
+  esp_err_t (*start)(const event_channel_config_t *config);
+  void (*stop)(void);
+  bool (*is_connected)(void);
+  // Queues the event without waiting for the network, fails while disconnected.
+  // Needs session_data->idempotency_key.
+  esp_err_t (*publish_run)(const session_data_t *session_data);
+  // True once every queued event was acknowledged
+  bool (*is_flushed)(void);
+} event_channel_t;
+
+#if CONFIG_EVENT_CHANNEL_MQTT
+extern const event_channel_t event_channel_mqtt;
+#endif
@@ -1,14 +1,23 @@
 #pragma once
 
+#include <time.h>
 #include "esp_err.h"
 #include "esp_camera.h"
 
+// 128 random bits in hex
+#define HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE 33
+
+// Room for the Exif segment with the session values, device ID and timestamp
+#define HTTP_CLIENT_IMAGE_METADATA_SIZE 192
+
 typedef struct
 {
   const char *host;
   int port;
   const char *auth_header;
-  int timeout_ms;
+  int timeout_ms; // upper bound, the timeouts in use follow the measured round trip times
+  bool use_tls;
+  const char *ca_cert_pem; // CA of the server certificate, kept by reference. NULL uses the certificate bundle
 } http_client_config_t;
 
 typedef struct
@@ -16,7 +25,12 @@ typedef struct
   float rate;
   float duration;
   float volume;
+  time_t timestamp; // 0 while the clock is unset
   camera_fb_t *image_fb;
+  const char *idempotency_key; // NULL to have one generated per submission
+  const uint8_t *flow;         // pulses per interval since the first pulse, sent with the run
+  size_t flow_len;
+  uint16_t flow_interval_ms;
 } session_data_t;
 
 typedef struct
@@ -33,19 +47,49 @@ typedef struct
   char *response_body;
 } run_create_response_t;
 
+typedef struct
+{
+  uint32_t connections;      // new connections, each with a full or resumed handshake over TLS
+  uint32_t sessions_offered; // new TLS connections that offered the saved session, resumed or not
+  uint32_t reused;           // requests sent on a kept connection
+  int64_t last_connect_us;   // connect and handshake time of the latest new connection
+} http_client_stats_t;
+
 esp_err_t http_client_init(void);
 
 esp_err_t http_client_set_config(const http_client_config_t *config);
 
-esp_err_t http_client_upload_image(const camera_fb_t *image_fb, image_upload_response_t *response);
+esp_err_t http_client_upload_image(const session_data_t *session_data, image_upload_response_t *response);
 
 esp_err_t http_client_create_run(const session_data_t *session_data,
                                  const char *image_resource_name,
                                  run_create_response_t *response);
+// Creates several runs with one request, an array body to /api/v1/runs. Each session that has an
+// idempotency key sends it per run, so runs created by an earlier request are not duplicated.
+// Not retried, the caller decides whether to repeat the batch or fall back to single creates.
+esp_err_t http_client_create_runs(const session_data_t *const *sessions,
+                                  const char *const *image_resource_names,
+                                  size_t count,
+                                  run_create_response_t *response);
+// Retries each phase with backoff. When upload_response already holds an image resource name
+// from an earlier submission of the same session, only the run is created.
 esp_err_t http_client_submit_session(const session_data_t *session_data,
                                      image_upload_response_t *upload_response,
                                      run_create_response_t *run_response);
 
+void http_client_get_stats(http_client_stats_t *stats);
+
+void http_client_make_idempotency_key(char *key, size_t size);
+
+// The Exif segment spliced into uploaded images, 0 if no metadata is added
+size_t http_client_build_metadata(const session_data_t *session_data, uint8_t *segment, size_t size);
+
+// "trichter-" and the station MAC, valid after http_client_init()
+const char *http_client_device_id(void);
+
+// True for connection errors, timeouts and responses worth repeating (408, 425, 429, 5xx)
+bool http_client_is_retryable(esp_err_t err, int http_status);
+
 void http_client_free_image_response(image_upload_response_t *response);
 
 void http_client_free_run_response(run_create_response_t *response);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "http_client.h"
+
+#define RUN_ENCODING_JSON "application/json"
+#define RUN_ENCODING_CBOR "application/cbor"
+
+// Body of POST /api/v1/runs: one run, or with array set an array of runs that each carry their
+// idempotency key. Returns NULL when out of memory, free() the result.
+char *run_encoding_json(const session_data_t *const *sessions,
+                        const char *const *image_resource_names,
+                        size_t count, bool array, bool formatted);
+
+// The same runs as CBOR into buf, without allocating. Returns the length of the encoding, which is
+// larger than size when buf is too small, so a call with a NULL buf measures it.
+size_t run_encoding_cbor(uint8_t *buf, size_t size,
+                         const session_data_t *const *sessions,
+                         const char *const *image_resource_names,
+                         size_t count, bool array);
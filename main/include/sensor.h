@@ -14,6 +14,9 @@ typedef struct
     float rate_lpm;
     float volume_l;
     camera_fb_t *image_fb; // Camera frame buffer captured during session
+    const uint8_t *flow;    // Pulses per interval since the first pulse, valid until the next session
+    uint16_t flow_len;
+    uint16_t flow_interval_ms;
 } SessionResult;
 
 esp_err_t sensor_init(gpio_num_t pulse_gpio);
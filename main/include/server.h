@@ -2,8 +2,12 @@
 
 #include "esp_err.h"
 #include "esp_http_server.h"
+#include "esp_camera.h"
 
 httpd_handle_t server_start(void);
 
 esp_err_t server_stop(httpd_handle_t server);
 
+// Retains a copy for /sessions/latest.jpg with segment spliced in as in the upload. The upload
+// may still differ in its Huffman tables, which are optimized on slow links.
+void server_set_session_image(camera_fb_t *fb, const uint8_t *segment, size_t segment_len);
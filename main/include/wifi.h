@@ -1,6 +1,13 @@
 #pragma once
 
 #include "esp_err.h"
+#include <time.h>
 
 esp_err_t wifi_init_sta(void);
 
+esp_err_t wifi_wake(void);
+
+esp_err_t wifi_idle(void);
+
+// Current time, 0 until SNTP has set the clock
+time_t wifi_time(void);
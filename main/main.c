@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "camera.h"
@@ -22,9 +23,15 @@
 #include "soc/gpio_num.h"
 #include "wifi.h"
 #include "http_client.h"
+#include "backlog.h"
+#include "event_channel.h"
+#include "presence.h"
 
 static const char *TAG = "app_main";
 
+// NULL when runs are only created over HTTP
+static const event_channel_t *event_channel = NULL;
+
 #define MAX_HTTP_RECV_BUFFER 512
 #define MAX_HTTP_OUTPUT_BUFFER 2048
 
@@ -37,6 +44,26 @@ static esp_err_t initialize_system(void)
   ESP_ERROR_CHECK(wifi_init_sta());
   ESP_ERROR_CHECK(sensor_init(GPIO_NUM_4));
   ESP_ERROR_CHECK(http_client_init());
+#if CONFIG_EVENT_CHANNEL_MQTT
+  const event_channel_config_t channel_config = {
+      .uri = CONFIG_EVENT_CHANNEL_MQTT_URI,
+      .username = CONFIG_EVENT_CHANNEL_MQTT_USERNAME,
+      .password = CONFIG_EVENT_CHANNEL_MQTT_PASSWORD,
+      .topic = CONFIG_EVENT_CHANNEL_MQTT_TOPIC};
+  if (event_channel_mqtt.start(&channel_config) == ESP_OK)
+  {
+    event_channel = &event_channel_mqtt;
+  }
+  else
+  {
+    ESP_LOGW(TAG, "Event channel not started, runs are announced over HTTP only");
+  }
+#endif
+  ESP_ERROR_CHECK(presence_init());
+  if (!server_start())
+  {
+    ESP_LOGW(TAG, "HTTP server not started, /jpg and /stream are unavailable");
+  }
 
   ESP_LOGI(TAG, "System initialization complete");
   return ESP_OK;
@@ -60,22 +87,51 @@ static esp_err_t submit_session_to_server(const SessionResult *session_result)
       .rate = session_result->rate_lpm,
       .duration = session_result->duration_us / 1e6f,
       .volume = session_result->volume_l,
-      .image_fb = session_result->image_fb};
+      .timestamp = wifi_time(),
+      .image_fb = session_result->image_fb,
+      .flow = session_result->flow,
+      .flow_len = session_result->flow_len,
+      .flow_interval_ms = session_result->flow_interval_ms};
+
+  // Retained with the Exif segment the upload gets, so /sessions/latest.jpg describes the session too
+  uint8_t metadata[HTTP_CLIENT_IMAGE_METADATA_SIZE];
+  server_set_session_image(session_result->image_fb, metadata,
+                           http_client_build_metadata(&session_data, metadata, sizeof(metadata)));
 
   ESP_LOGI(TAG, "Submitting session to server: Rate=%.2f L/min, Duration=%.2fs, Volume=%.2f L",
            session_data.rate, session_data.duration, session_data.volume);
 
-  esp_err_t err = http_client_submit_session(&session_data, NULL, NULL);
+  // The key stays with the session if it is held for a later submission
+  char idempotency_key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE];
+  http_client_make_idempotency_key(idempotency_key, sizeof(idempotency_key));
+  session_data.idempotency_key = idempotency_key;
+
+  // Announced right away on the open connection, the submission below brings the image and
+  // creates the run under the same key
+  if (event_channel && event_channel->publish_run(&session_data) != ESP_OK)
+  {
+    ESP_LOGW(TAG, "Run not announced over %s", event_channel->name);
+  }
+
+  image_upload_response_t upload_response = {0};
+  esp_err_t err = http_client_submit_session(&session_data, &upload_response, NULL);
 
   if (err == ESP_OK)
   {
     ESP_LOGI(TAG, "Session submitted successfully to server");
+#if CONFIG_SESSION_BACKLOG_SIZE > 0
+    // The server is reachable again, submit what piled up while it was not. The next session
+    // waits for this, so a large backlog is submitted over several sessions.
+    backlog_drain(CONFIG_HTTP_CLIENT_RUN_BATCH_SIZE, CONFIG_HTTP_CLIENT_RETRY_BUDGET_MS);
+#endif
   }
   else
   {
     ESP_LOGE(TAG, "Failed to submit session to server: %s", esp_err_to_name(err));
+    backlog_add(&session_data, &upload_response);
   }
 
+  http_client_free_image_response(&upload_response);
   return err;
 }
 
@@ -0,0 +1,317 @@
+#include "backlog.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "backlog";
+
+#if CONFIG_SESSION_BACKLOG_SIZE > 0
+// Upper end of the HTTP_CLIENT_RUN_BATCH_SIZE range
+#define BACKLOG_MAX_BATCH 100
+
+typedef struct
+{
+  session_data_t session; // image_fb, idempotency_key and flow point into the entry
+  camera_fb_t fb;         // freed once the image is uploaded
+  char idempotency_key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE];
+  char *image_resource_name;
+  uint8_t flow[];
+} backlog_entry_t;
+
+// Oldest first
+static backlog_entry_t *entries[CONFIG_SESSION_BACKLOG_SIZE];
+static size_t entry_count = 0;
+// Cleared when the server rejects an array of runs, runs are then created one per request
+static bool batch_supported = true;
+// Set by backlog_drain(), no further request is started after it
+static int64_t drain_deadline_us = 0;
+
+static bool backlog_out_of_time(void)
+{
+  return drain_deadline_us && esp_timer_get_time() >= drain_deadline_us;
+}
+
+static void backlog_remove(size_t index)
+{
+  backlog_entry_t *entry = entries[index];
+  free(entry->fb.buf);
+  free(entry->image_resource_name);
+  free(entry);
+  entry_count--;
+  memmove(&entries[index], &entries[index + 1], (entry_count - index) * sizeof(entries[0]));
+}
+
+static bool backlog_copy_image(backlog_entry_t *entry, const camera_fb_t *fb)
+{
+  entry->fb = *fb;
+  if (fb->format != PIXFORMAT_JPEG)
+  {
+    // Raw frames are held as JPEG, a fraction of the size
+    entry->fb.buf = NULL;
+    entry->fb.format = PIXFORMAT_JPEG;
+    return frame2jpg((camera_fb_t *)fb, CONFIG_HTTP_CLIENT_STREAM_JPEG_QUALITY, &entry->fb.buf, &entry->fb.len);
+  }
+  entry->fb.buf = malloc(fb->len);
+  if (!entry->fb.buf)
+  {
+    return false;
+  }
+  memcpy(entry->fb.buf, fb->buf, fb->len);
+  return true;
+}
+
+esp_err_t backlog_add(const session_data_t *session_data, const image_upload_response_t *upload_response)
+{
+  if (!session_data || (!session_data->image_fb && !(upload_response && upload_response->image_resource_name)))
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  size_t flow_len = session_data->flow ? session_data->flow_len : 0;
+  backlog_entry_t *entry = calloc(1, sizeof(backlog_entry_t) + flow_len);
+  if (!entry)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  entry->session = *session_data;
+  entry->session.image_fb = &entry->fb;
+  entry->session.idempotency_key = entry->idempotency_key;
+  // the curve belongs to the sensor and is overwritten by the next session
+  if (flow_len)
+  {
+    memcpy(entry->flow, session_data->flow, flow_len);
+  }
+  entry->session.flow = flow_len ? entry->flow : NULL;
+  entry->session.flow_len = flow_len;
+  // Keeping the key lets the server drop what an interrupted submission already created
+  if (session_data->idempotency_key)
+  {
+    snprintf(entry->idempotency_key, sizeof(entry->idempotency_key), "%s", session_data->idempotency_key);
+  }
+  else
+  {
+    http_client_make_idempotency_key(entry->idempotency_key, sizeof(entry->idempotency_key));
+  }
+
+  bool ok;
+  if (upload_response && upload_response->image_resource_name)
+  {
+    entry->image_resource_name = strdup(upload_response->image_resource_name);
+    ok = entry->image_resource_name != NULL;
+  }
+  else
+  {
+    ok = backlog_copy_image(entry, session_data->image_fb);
+  }
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "Out of memory, session not kept");
+    free(entry->fb.buf);
+    free(entry);
+    return ESP_ERR_NO_MEM;
+  }
+
+  if (entry_count == CONFIG_SESSION_BACKLOG_SIZE)
+  {
+    ESP_LOGW(TAG, "Backlog full, dropping the oldest session");
+    backlog_remove(0);
+  }
+  entries[entry_count++] = entry;
+  ESP_LOGI(TAG, "Session kept for later submission, %zu pending", entry_count);
+  return ESP_OK;
+}
+
+size_t backlog_count(void)
+{
+  return entry_count;
+}
+
+esp_err_t backlog_upload_images(void)
+{
+  for (size_t i = 0; i < entry_count;)
+  {
+    backlog_entry_t *entry = entries[i];
+    if (entry->image_resource_name)
+    {
+      i++;
+      continue;
+    }
+    if (backlog_out_of_time())
+    {
+      return ESP_ERR_TIMEOUT;
+    }
+
+    image_upload_response_t response = {0};
+    esp_err_t err = http_client_upload_image(&entry->session, &response);
+    if (err == ESP_OK && !response.image_resource_name)
+    {
+      err = ESP_ERR_INVALID_RESPONSE;
+    }
+    if (err == ESP_OK)
+    {
+      entry->image_resource_name = response.image_resource_name;
+      free(entry->fb.buf);
+      entry->fb.buf = NULL;
+      entry->fb.len = 0;
+      i++;
+      continue;
+    }
+
+    http_client_free_image_response(&response);
+    if (http_client_is_retryable(err, response.http_status_code))
+    {
+      return err;
+    }
+    ESP_LOGW(TAG, "Image rejected (%s, HTTP %d), dropping the session",
+             esp_err_to_name(err), response.http_status_code);
+    backlog_remove(i);
+  }
+  return ESP_OK;
+}
+
+// Returns an error only when the server could not be reached, rejected runs are dropped
+static esp_err_t backlog_create_run(size_t index)
+{
+  backlog_entry_t *entry = entries[index];
+  run_create_response_t response = {0};
+  esp_err_t err = http_client_create_run(&entry->session, entry->image_resource_name, &response);
+  http_client_free_run_response(&response);
+  if (err != ESP_OK && http_client_is_retryable(err, response.http_status_code))
+  {
+    return err;
+  }
+  if (err != ESP_OK)
+  {
+    ESP_LOGW(TAG, "Run rejected (%s, HTTP %d), dropping the session",
+             esp_err_to_name(err), response.http_status_code);
+  }
+  backlog_remove(index);
+  return ESP_OK;
+}
+
+esp_err_t backlog_create_runs(size_t batch_size)
+{
+  static const session_data_t *sessions[BACKLOG_MAX_BATCH];
+  static const char *image_resource_names[BACKLOG_MAX_BATCH];
+  static size_t indices[BACKLOG_MAX_BATCH];
+
+  batch_size = batch_size < 1 ? 1 : batch_size > BACKLOG_MAX_BATCH ? BACKLOG_MAX_BATCH : batch_size;
+  size_t next = 0;
+  while (next < entry_count)
+  {
+    // Sessions whose image is still pending are skipped
+    size_t count = 0;
+    for (; next < entry_count && count < batch_size; next++)
+    {
+      if (entries[next]->image_resource_name)
+      {
+        indices[count] = next;
+        sessions[count] = &entries[next]->session;
+        image_resource_names[count] = entries[next]->image_resource_name;
+        count++;
+      }
+    }
+    if (!count)
+    {
+      break;
+    }
+    if (backlog_out_of_time())
+    {
+      return ESP_ERR_TIMEOUT;
+    }
+
+    if (count > 1 && batch_supported)
+    {
+      run_create_response_t response = {0};
+      esp_err_t err = http_client_create_runs(sessions, image_resource_names, count, &response);
+      http_client_free_run_response(&response);
+      if (err != ESP_OK && http_client_is_retryable(err, response.http_status_code))
+      {
+        return err;
+      }
+      if (err == ESP_OK)
+      {
+        for (size_t i = count; i-- > 0;)
+        {
+          backlog_remove(indices[i]);
+        }
+        next -= count;
+        continue;
+      }
+      ESP_LOGW(TAG, "Server rejected %zu runs in one request (HTTP %d), creating them one by one",
+               count, response.http_status_code);
+      batch_supported = false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+      if (i && backlog_out_of_time())
+      {
+        return ESP_ERR_TIMEOUT;
+      }
+      // earlier entries of this batch are gone by now
+      esp_err_t err = backlog_create_run(indices[i] - i);
+      if (err != ESP_OK)
+      {
+        return err;
+      }
+      next--;
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t backlog_drain(size_t batch_size, int budget_ms)
+{
+  if (!entry_count)
+  {
+    return ESP_OK;
+  }
+  ESP_LOGI(TAG, "Submitting %zu pending sessions", entry_count);
+  drain_deadline_us = esp_timer_get_time() + budget_ms * 1000LL;
+  esp_err_t err = backlog_upload_images();
+  if (err == ESP_OK)
+  {
+    err = backlog_create_runs(batch_size);
+  }
+  drain_deadline_us = 0;
+  if (err == ESP_ERR_TIMEOUT)
+  {
+    ESP_LOGI(TAG, "Out of time, %zu sessions left for the next drain", entry_count);
+  }
+  else
+  {
+    ESP_LOGI(TAG, "%zu sessions still pending", entry_count);
+  }
+  return err;
+}
+#else
+esp_err_t backlog_add(const session_data_t *session_data, const image_upload_response_t *upload_response)
+{
+  ESP_LOGW(TAG, "Session backlog disabled, session dropped");
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+size_t backlog_count(void)
+{
+  return 0;
+}
+
+esp_err_t backlog_upload_images(void)
+{
+  return ESP_OK;
+}
+
+esp_err_t backlog_create_runs(size_t batch_size)
+{
+  return ESP_OK;
+}
+
+esp_err_t backlog_drain(size_t batch_size, int budget_ms)
+{
+  return ESP_OK;
+}
+#endif
@@ -1,10 +1,27 @@
+#include <inttypes.h>
 #include "camera.h"
 #include "esp_camera.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 
 static const char *TAG = "camera";
 
+#define CAMERA_NVS_KEY "camera"
+
+// 640x480 decodes to 80x60 at 1:8, which fits the 128x64 display
+#define CAMERA_PREVIEW_FRAME_SIZE FRAMESIZE_VGA
+
+// A pending frame older than this may miss whoever just stepped in, a new one is captured instead
+#define CAMERA_PENDING_MAX_AGE_MS 100
+
+#ifdef CONFIG_PRESENCE_DETECTION
+// Idle XCLK while presence detection samples, lowers the frame rate and stays within the sensors' input range
+#define CAMERA_IDLE_XCLK_MHZ 8
+#endif
+
 static camera_config_t camera_config = {
     .pin_pwdn = PWDN_GPIO_NUM,
     .pin_reset = RESET_GPIO_NUM,
@@ -30,15 +47,44 @@ static camera_config_t camera_config = {
     .fb_count = 2,
     .grab_mode = CAMERA_GRAB_WHEN_EMPTY};
 
+#ifdef CONFIG_ENABLE_CAMERA
+// Guards the mode below and pending_fb
+static SemaphoreHandle_t camera_lock = NULL;
+static int preview_users = 0;
+static bool preview_size = false;   // sensor is set to the preview frame size
+static bool preview_active = false; // awake and at the preview size for preview users
+static bool in_session = false;
+static bool armed = false;
+static int snapshot_users = 0;
+#ifdef CONFIG_PRESENCE_DETECTION
+static bool idle_clock = false; // XCLK is lowered to CAMERA_IDLE_XCLK_MHZ
+#endif
+// Newest full-size frame, handed to the next capture
+static camera_fb_t *pending_fb = NULL;
+#endif
+
 esp_err_t camera_init_module(void)
 {
 #ifdef CONFIG_ENABLE_CAMERA
-    esp_err_t err = esp_camera_init(&camera_config);
+    esp_err_t err = esp_camera_init_warm(&camera_config, CAMERA_NVS_KEY);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Camera Init Failed (%d)", err);
+        return err;
     }
-    return err;
+
+    // Keep the cached sensor model current so the next boot can skip probing
+    if (esp_camera_save_to_nvs(CAMERA_NVS_KEY) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Failed to cache camera settings");
+    }
+
+    camera_lock = xSemaphoreCreateMutex();
+    if (!camera_lock)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return camera_suspend();
 #else
     {
         ESP_LOGW(TAG, "Camera module is disabled in configuration");
@@ -47,6 +93,340 @@ esp_err_t camera_init_module(void)
 #endif
 }
 
+static esp_err_t camera_wake(void)
+{
+#if defined(CONFIG_ENABLE_CAMERA) && defined(CONFIG_CAMERA_SLEEP_BETWEEN_SESSIONS)
+    esp_err_t err = esp_camera_wake(CONFIG_CAMERA_WAKE_TIMEOUT_MS);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Camera resume failed (%s)", esp_err_to_name(err));
+    }
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
+
+#ifdef CONFIG_ENABLE_CAMERA
+// The helpers below are called with camera_lock held
+
+static void camera_drop_pending(void)
+{
+    if (pending_fb)
+    {
+        esp_camera_fb_return(pending_fb);
+        pending_fb = NULL;
+    }
+}
+
+// The pending frame if it is recent enough, a stale one is dropped
+static camera_fb_t *camera_take_pending(void)
+{
+    camera_fb_t *fb = pending_fb;
+    pending_fb = NULL;
+    if (!fb)
+    {
+        return NULL;
+    }
+    int64_t age_us = esp_timer_get_time() - (fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec);
+    if (age_us > CAMERA_PENDING_MAX_AGE_MS * 1000LL)
+    {
+        ESP_LOGD(TAG, "Pending frame is %" PRId64 " ms old, capturing a new one", age_us / 1000);
+        esp_camera_fb_return(fb);
+        return NULL;
+    }
+    return fb;
+}
+
+// Set before a frame size change, some sensors derive their PLL settings from XCLK
+static void camera_set_idle_clock(bool idle)
+{
+#ifdef CONFIG_PRESENCE_DETECTION
+    sensor_t *s = esp_camera_sensor_get();
+    if (idle == idle_clock || !s->set_xclk)
+    {
+        return;
+    }
+    int mhz = idle ? CAMERA_IDLE_XCLK_MHZ : camera_config.xclk_freq_hz / 1000000;
+    if (s->set_xclk(s, camera_config.ledc_timer, mhz) != 0)
+    {
+        ESP_LOGW(TAG, "Failed to set XCLK to %d MHz", mhz);
+        return;
+    }
+    idle_clock = idle;
+#endif
+}
+
+static esp_err_t camera_enter_preview(void)
+{
+    if (preview_active)
+    {
+        return ESP_OK;
+    }
+    esp_err_t err = camera_wake();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    camera_drop_pending();
+    if (!preview_size)
+    {
+        sensor_t *s = esp_camera_sensor_get();
+        if (s->set_framesize(s, CAMERA_PREVIEW_FRAME_SIZE) != 0)
+        {
+            ESP_LOGW(TAG, "Failed to set preview frame size");
+            s->set_framesize(s, camera_config.frame_size);
+            return ESP_FAIL;
+        }
+        preview_size = true;
+    }
+    preview_active = true;
+    return ESP_OK;
+}
+
+// Full size and awake for a session or while armed
+static esp_err_t camera_enter_full(void)
+{
+    preview_active = false;
+    esp_err_t err = camera_wake();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    camera_set_idle_clock(false);
+    if (!preview_size)
+    {
+        return ESP_OK;
+    }
+    preview_size = false;
+
+    sensor_t *s = esp_camera_sensor_get();
+    s->set_framesize(s, camera_config.frame_size);
+
+    // Frames already queued by the driver still have the preview size
+    for (size_t i = 0; i <= camera_config.fb_count; i++)
+    {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (!fb)
+        {
+            break;
+        }
+        if (fb->width == resolution[camera_config.frame_size].width)
+        {
+            pending_fb = fb;
+            break;
+        }
+        esp_camera_fb_return(fb);
+    }
+    return ESP_OK;
+}
+
+// Lowest mode still needed once neither a session nor arming needs full size
+static esp_err_t camera_enter_idle(void)
+{
+    if (in_session || armed || snapshot_users > 0)
+    {
+        return ESP_OK;
+    }
+    if (preview_users > 0)
+    {
+        camera_set_idle_clock(false);
+        return camera_enter_preview();
+    }
+#ifdef CONFIG_PRESENCE_DETECTION
+    // Presence detection takes idle frames from the preview. Waking the sensor for each sample
+    // would pay the warm resume every interval, a lower XCLK keeps it streaming slowly instead.
+    esp_err_t err = camera_enter_preview();
+    if (err == ESP_OK)
+    {
+        camera_set_idle_clock(true);
+    }
+    return err;
+#else
+    // The sensor keeps the preview size while sleeping, the next wake is most likely for a preview
+    preview_active = false;
+    camera_drop_pending();
+#ifdef CONFIG_CAMERA_SLEEP_BETWEEN_SESSIONS
+    return esp_camera_sleep();
+#else
+    return ESP_OK;
+#endif
+#endif
+}
+#endif
+
+esp_err_t camera_suspend(void)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    in_session = false;
+    esp_err_t err = camera_enter_idle();
+    xSemaphoreGive(camera_lock);
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
+
+esp_err_t camera_resume(void)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    in_session = true;
+    esp_err_t err = camera_enter_full();
+    xSemaphoreGive(camera_lock);
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
+
+esp_err_t camera_preview_start(void)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    preview_users++;
+    if (!in_session && !armed)
+    {
+        err = camera_enter_preview();
+        camera_set_idle_clock(false);
+    }
+    if (err != ESP_OK)
+    {
+        preview_users--;
+        camera_enter_idle();
+    }
+    xSemaphoreGive(camera_lock);
+    return err;
+#else
+    {
+        ESP_LOGW(TAG, "Camera module is disabled in configuration");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#endif
+}
+
+void camera_preview_stop(void)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    if (preview_users > 0)
+    {
+        preview_users--;
+        camera_enter_idle();
+    }
+    xSemaphoreGive(camera_lock);
+#endif
+}
+
+camera_fb_t *camera_preview_get(void)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    bool active = preview_active;
+    xSemaphoreGive(camera_lock);
+    if (!active)
+    {
+        return NULL;
+    }
+    // Waiting for the frame does not hold the lock, so a session never waits for preview users.
+    // The camera only sleeps once every user has stopped.
+    camera_fb_t *fb = esp_camera_fb_get();
+    // Frames from before or after a size change are full size
+    if (fb && fb->width != resolution[CAMERA_PREVIEW_FRAME_SIZE].width)
+    {
+        esp_camera_fb_return(fb);
+        fb = NULL;
+    }
+    return fb;
+#else
+    return NULL;
+#endif
+}
+
+void camera_preview_return(camera_fb_t *fb)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    esp_camera_fb_return(fb);
+#endif
+}
+
+esp_err_t camera_arm(void)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    if (!armed)
+    {
+        armed = true;
+        if (!in_session)
+        {
+            err = camera_enter_full();
+        }
+    }
+    xSemaphoreGive(camera_lock);
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void camera_disarm(void)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    if (armed)
+    {
+        armed = false;
+        camera_enter_idle();
+    }
+    xSemaphoreGive(camera_lock);
+#endif
+}
+
+camera_fb_t *camera_pretrigger_get(void)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    // During a session the capture owns the frames
+    bool usable = armed && !in_session;
+    if (usable)
+    {
+        // Only the newest frame is kept, so the driver always has a buffer to fill
+        camera_drop_pending();
+    }
+    xSemaphoreGive(camera_lock);
+    if (!usable)
+    {
+        return NULL;
+    }
+    // As for the preview, neither the wait nor the caller's decode holds the lock
+    return esp_camera_fb_get();
+#else
+    return NULL;
+#endif
+}
+
+void camera_pretrigger_put(camera_fb_t *fb)
+{
+#ifdef CONFIG_ENABLE_CAMERA
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    // A session that started meanwhile captures its own frame
+    if (armed && !in_session)
+    {
+        camera_drop_pending();
+        pending_fb = fb;
+        fb = NULL;
+    }
+    xSemaphoreGive(camera_lock);
+    if (fb)
+    {
+        esp_camera_fb_return(fb);
+    }
+#endif
+}
+
 typedef struct
 {
     httpd_req_t *req;
@@ -68,18 +448,149 @@ static size_t jpg_encode_stream(void *arg, size_t index, const void *data, size_
     return len;
 }
 
+#ifdef CONFIG_ENABLE_CAMERA
+static void camera_log_stats(void)
+{
+    camera_stats_t stats;
+    if (esp_camera_get_stats(&stats) != ESP_OK)
+    {
+        return;
+    }
+    ESP_LOGW(TAG, "Frames: %" PRIu32 " ok, %" PRIu32 " retried, max wait %" PRIu32 " ms; "
+             "drops: fb-ovf %" PRIu32 ", fbq %" PRIu32 ", no-soi %" PRIu32 ", no-eoi %" PRIu32 ", ev-ovf %" PRIu32 ", timeout %" PRIu32,
+             stats.frames, stats.take_retries, stats.latency_max_ms,
+             stats.drops[CAMERA_DROP_FB_OVF].count,
+             stats.drops[CAMERA_DROP_FBQ_SND].count + stats.drops[CAMERA_DROP_FBQ_RCV].count,
+             stats.drops[CAMERA_DROP_NO_SOI].count,
+             stats.drops[CAMERA_DROP_NO_EOI].count,
+             stats.drops[CAMERA_DROP_EV_OVF].count,
+             stats.drops[CAMERA_DROP_TIMEOUT].count);
+    ESP_LOGW(TAG, "Frame buffers: %zu bytes, %zu bytes saved by adaptive sizing",
+             stats.fb_bytes, stats.fb_bytes_saved);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_CAMERA
+#ifdef CONFIG_CAMERA_EXPOSURE_CHECK
+// contrast is set for rejected frames, to pick the least bad one when none passes
+static bool camera_exposure_ok(camera_fb_t *fb, int *contrast)
+{
+    luma_hist_t hist;
+    int64_t start = esp_timer_get_time();
+    if (!frame2luma_hist(fb, JPEG_IMAGE_SCALE_1_8, &hist))
+    {
+        // Cannot judge, do not throw the frame away
+        return true;
+    }
+    uint8_t p5 = luma_hist_percentile(&hist, 5);
+    uint8_t p95 = luma_hist_percentile(&hist, 95);
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    *contrast = p95 - p5;
+
+    const char *reason = NULL;
+    if (p95 < CONFIG_CAMERA_EXPOSURE_DARK_LEVEL)
+    {
+        reason = "too dark";
+    }
+    else if (p5 > CONFIG_CAMERA_EXPOSURE_BRIGHT_LEVEL)
+    {
+        reason = "blown out";
+    }
+    else if (p95 - p5 < CONFIG_CAMERA_EXPOSURE_MIN_CONTRAST)
+    {
+        reason = "blank";
+    }
+
+    if (reason)
+    {
+        ESP_LOGW(TAG, "Image rejected, %s (p5 %u, p95 %u, %" PRId64 " us)", reason, p5, p95, elapsed_us);
+        return false;
+    }
+    ESP_LOGD(TAG, "Exposure ok (p5 %u, p95 %u, %" PRId64 " us)", p5, p95, elapsed_us);
+    return true;
+}
+#endif
+
+static camera_fb_t *camera_grab(void)
+{
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    camera_fb_t *fb = camera_take_pending();
+    xSemaphoreGive(camera_lock);
+    if (!fb)
+    {
+        fb = esp_camera_fb_get();
+    }
+#ifdef CONFIG_CAMERA_EXPOSURE_CHECK
+    // The rejected frame with the most contrast is kept, a poor photo must not cost the session
+    camera_fb_t *best = NULL;
+    int best_contrast = -1;
+    int contrast;
+    for (int retry = 0; fb && !camera_exposure_ok(fb, &contrast); retry++)
+    {
+        if (contrast > best_contrast)
+        {
+            if (best)
+            {
+                esp_camera_fb_return(best);
+            }
+            best = fb;
+            best_contrast = contrast;
+        }
+        else
+        {
+            esp_camera_fb_return(fb);
+        }
+        fb = NULL;
+        if (retry == CONFIG_CAMERA_EXPOSURE_RETRIES)
+        {
+            ESP_LOGW(TAG, "No well exposed image after %d attempts, keeping the one with contrast %d",
+                     retry + 1, best_contrast);
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_CAMERA_EXPOSURE_RETRY_MS));
+        // Queued frames were taken right after the rejected one
+        for (size_t i = 1; i < camera_config.fb_count; i++)
+        {
+            fb = esp_camera_fb_get();
+            if (fb)
+            {
+                esp_camera_fb_return(fb);
+            }
+        }
+        fb = esp_camera_fb_get();
+    }
+    if (!fb)
+    {
+        return best;
+    }
+    if (best)
+    {
+        esp_camera_fb_return(best);
+    }
+#endif
+    return fb;
+}
+#endif
+
 camera_fb_t *camera_capture_frame(void)
 {
 #ifdef CONFIG_ENABLE_CAMERA
-    camera_fb_t *fb = esp_camera_fb_get();
+    int64_t start = esp_timer_get_time();
+    camera_fb_t *fb = camera_grab();
     if (!fb)
     {
         ESP_LOGE(TAG, "Camera capture failed");
+        camera_log_stats();
         return NULL;
     }
 
-    ESP_LOGI(TAG, "Image captured: %dx%d, %zu bytes",
-             fb->width, fb->height, fb->len);
+    int64_t elapsed_ms = (esp_timer_get_time() - start) / 1000;
+    ESP_LOGI(TAG, "Image captured: %dx%d, %zu bytes in %" PRId64 " ms",
+             fb->width, fb->height, fb->len, elapsed_ms);
+    if (elapsed_ms > CONFIG_CAMERA_CAPTURE_SLOW_MS)
+    {
+        camera_log_stats();
+    }
     return fb;
 #else
     {
@@ -89,15 +600,63 @@ camera_fb_t *camera_capture_frame(void)
 #endif
 }
 
+#ifdef CONFIG_ENABLE_CAMERA
+static void camera_snapshot_return(camera_fb_t *fb)
+{
+    if (fb)
+    {
+        esp_camera_fb_return(fb);
+    }
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    snapshot_users--;
+    camera_enter_idle();
+    xSemaphoreGive(camera_lock);
+}
+
+// A full-size frame outside a session. The camera stays at full size until the frame is given
+// back with camera_snapshot_return(), preview users get no frames meanwhile.
+static camera_fb_t *camera_snapshot_get(void)
+{
+    camera_fb_t *fb = NULL;
+    xSemaphoreTake(camera_lock, portMAX_DELAY);
+    // A session's capture must not lose a frame to a snapshot
+    if (in_session)
+    {
+        xSemaphoreGive(camera_lock);
+        return NULL;
+    }
+    snapshot_users++;
+    esp_err_t err = camera_enter_full();
+    // While armed the pending frame belongs to the next session
+    if (err == ESP_OK && !armed)
+    {
+        fb = camera_take_pending();
+    }
+    xSemaphoreGive(camera_lock);
+    if (err == ESP_OK && !fb)
+    {
+        fb = esp_camera_fb_get();
+    }
+    if (!fb)
+    {
+        camera_snapshot_return(NULL);
+    }
+    return fb;
+}
+#endif
+
+// A full-size snapshot at the configured frame size. It wakes the camera when needed and is
+// refused during a session, which owns the frames.
 esp_err_t camera_jpg_image_http_handler(httpd_req_t *req)
 {
 #ifdef CONFIG_ENABLE_CAMERA
-    camera_fb_t *fb = esp_camera_fb_get();
+    camera_fb_t *fb = camera_snapshot_get();
     if (!fb)
     {
-        ESP_LOGE(TAG, "Camera capture failed");
-        httpd_resp_send_500(req);
-        return ESP_FAIL;
+        ESP_LOGW(TAG, "No frame for /jpg, the camera is busy");
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        return httpd_resp_sendstr(req, "Camera busy");
     }
 
     httpd_resp_set_type(req, "image/jpeg");
@@ -119,7 +678,7 @@ esp_err_t camera_jpg_image_http_handler(httpd_req_t *req)
         httpd_resp_send_chunk(req, NULL, 0);
     }
 
-    esp_camera_fb_return(fb);
+    camera_snapshot_return(fb);
     return res;
 #else
     {
@@ -0,0 +1,166 @@
+#include "cbor.h"
+#include <string.h>
+
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+#define CBOR_TAG_UINT8_ARRAY 64
+
+void cbor_writer_init(cbor_writer_t *writer, uint8_t *buf, size_t size)
+{
+  writer->buf = buf;
+  writer->size = buf ? size : 0;
+  writer->len = 0;
+}
+
+bool cbor_writer_ok(const cbor_writer_t *writer)
+{
+  return writer->len <= writer->size;
+}
+
+static void cbor_put(cbor_writer_t *writer, const void *data, size_t len)
+{
+  if (writer->len + len <= writer->size)
+  {
+    memcpy(writer->buf + writer->len, data, len);
+  }
+  writer->len += len;
+}
+
+// Initial byte and argument in the shortest form
+static void cbor_put_head(cbor_writer_t *writer, uint8_t major, uint64_t value)
+{
+  uint8_t head[9];
+  size_t len;
+  if (value < 24)
+  {
+    head[0] = major << 5 | value;
+    len = 1;
+  }
+  else if (value <= UINT8_MAX)
+  {
+    head[0] = major << 5 | 24;
+    head[1] = value;
+    len = 2;
+  }
+  else if (value <= UINT16_MAX)
+  {
+    head[0] = major << 5 | 25;
+    len = 3;
+  }
+  else if (value <= UINT32_MAX)
+  {
+    head[0] = major << 5 | 26;
+    len = 5;
+  }
+  else
+  {
+    head[0] = major << 5 | 27;
+    len = 9;
+  }
+  // big endian
+  for (size_t i = len - 1; len > 2 && i > 0; i--, value >>= 8)
+  {
+    head[i] = value & 0xFF;
+  }
+  cbor_put(writer, head, len);
+}
+
+void cbor_write_uint(cbor_writer_t *writer, uint64_t value)
+{
+  cbor_put_head(writer, CBOR_UINT, value);
+}
+
+void cbor_write_int(cbor_writer_t *writer, int64_t value)
+{
+  if (value < 0)
+  {
+    cbor_put_head(writer, CBOR_NEGINT, (uint64_t)(-(value + 1)));
+  }
+  else
+  {
+    cbor_put_head(writer, CBOR_UINT, value);
+  }
+}
+
+// The half precision bits of value, or -1 if it has none that are exact
+static int32_t cbor_half_bits(uint32_t bits)
+{
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if ((bits & 0x7FFFFFFF) == 0)
+  {
+    return sign;
+  }
+  if (exponent == 128)
+  {
+    // infinity, NaN keeps only its quiet bit
+    return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+  }
+  if (exponent >= -14 && exponent <= 15 && !(mantissa & 0x1FFF))
+  {
+    return sign | (exponent + 15) << 10 | mantissa >> 13;
+  }
+  if (exponent >= -24 && exponent < -14)
+  {
+    // subnormal half, the implicit bit joins the mantissa
+    uint32_t shift = 13 + (-14 - exponent);
+    uint32_t full = mantissa | 0x800000;
+    if (!(full & ((1u << shift) - 1)))
+    {
+      return sign | full >> shift;
+    }
+  }
+  return -1;
+}
+
+void cbor_write_float(cbor_writer_t *writer, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int32_t half = cbor_half_bits(bits);
+  if (half >= 0)
+  {
+    uint8_t out[3] = {CBOR_SIMPLE << 5 | 25, half >> 8, half & 0xFF};
+    cbor_put(writer, out, sizeof(out));
+    return;
+  }
+  uint8_t out[5] = {CBOR_SIMPLE << 5 | 26, bits >> 24, (bits >> 16) & 0xFF, (bits >> 8) & 0xFF, bits & 0xFF};
+  cbor_put(writer, out, sizeof(out));
+}
+
+void cbor_write_text(cbor_writer_t *writer, const char *text)
+{
+  size_t len = strlen(text);
+  cbor_put_head(writer, CBOR_TEXT, len);
+  cbor_put(writer, text, len);
+}
+
+void cbor_write_bytes(cbor_writer_t *writer, const uint8_t *data, size_t len)
+{
+  cbor_put_head(writer, CBOR_BYTES, len);
+  cbor_put(writer, data, len);
+}
+
+void cbor_write_uint8_array(cbor_writer_t *writer, const uint8_t *data, size_t len)
+{
+  cbor_put_head(writer, CBOR_TAG, CBOR_TAG_UINT8_ARRAY);
+  cbor_write_bytes(writer, data, len);
+}
+
+void cbor_write_array(cbor_writer_t *writer, size_t count)
+{
+  cbor_put_head(writer, CBOR_ARRAY, count);
+}
+
+void cbor_write_map(cbor_writer_t *writer, size_t count)
+{
+  cbor_put_head(writer, CBOR_MAP, count);
+}
@@ -1,3 +1,4 @@
+#include "camera.h"
 #include "driver/i2c_master.h"
 #include "esp_err.h"
 #include "esp_lcd_panel_io.h"
@@ -6,10 +7,13 @@
 #include "esp_lvgl_port.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "jpeg_decoder.h"
 #include "lvgl.h"
 #include "sensor.h"
 #include "img_icon.h"
+#include <inttypes.h>
 #include <stdio.h>
 
 #include "esp_lcd_panel_vendor.h"
@@ -31,6 +35,173 @@ static const char *TAG = "display";
 
 static i2c_master_bus_handle_t i2c_bus_handle = NULL;
 
+#ifdef CONFIG_DISPLAY_CAMERA_PREVIEW
+#define PREVIEW_TASK_STACK 4096
+#define PREVIEW_STATS_INTERVAL_US (5 * 1000 * 1000)
+#define PREVIEW_PALETTE_SIZE 8
+// A VGA frame at 1:8 leaves 48 columns next to the image
+#define PREVIEW_LABEL_WIDTH 48
+
+// Frames are decoded straight into the canvas buffers, one shown while the other is written
+static uint8_t preview_buf[2][LV_CANVAS_BUF_SIZE_INDEXED_1BIT(EXAMPLE_LCD_H_RES, EXAMPLE_LCD_V_RES)];
+static lv_obj_t *preview_canvas = NULL;
+static TaskHandle_t preview_task = NULL;
+static SemaphoreHandle_t preview_done = NULL;
+static volatile bool preview_running = false;
+
+static esp_err_t preview_decode(const camera_fb_t *fb, uint8_t *buf, esp_jpeg_image_output_t *out)
+{
+  if (fb->format != PIXFORMAT_JPEG)
+  {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  // Smallest reduction that fits the display
+  int scale = JPEG_IMAGE_SCALE_0;
+  while (scale < JPEG_IMAGE_SCALE_1_8 &&
+         ((fb->width >> scale) > EXAMPLE_LCD_H_RES || (fb->height >> scale) > EXAMPLE_LCD_V_RES))
+  {
+    scale++;
+  }
+  if ((fb->width >> scale) > EXAMPLE_LCD_H_RES || (fb->height >> scale) > EXAMPLE_LCD_V_RES)
+  {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  esp_jpeg_image_cfg_t cfg = {
+      .indata = fb->buf,
+      .indata_size = fb->len,
+      .outbuf = buf + PREVIEW_PALETTE_SIZE,
+      .outbuf_size = sizeof(preview_buf[0]) - PREVIEW_PALETTE_SIZE,
+      .out_format = JPEG_IMAGE_FORMAT_MONO1,
+      .out_scale = scale,
+  };
+  return esp_jpeg_decode(&cfg, out);
+}
+
+static void preview_task_fn(void *arg)
+{
+  const TickType_t period = pdMS_TO_TICKS(1000 / CONFIG_DISPLAY_CAMERA_PREVIEW_FPS);
+  TickType_t last_wake = xTaskGetTickCount();
+  int back = 0;
+
+  uint32_t frames = 0;
+  int64_t busy_us = 0;
+  int64_t decode_us = 0;
+  int64_t window_start = esp_timer_get_time();
+
+  while (preview_running)
+  {
+    camera_fb_t *fb = camera_preview_get();
+    if (fb)
+    {
+      int64_t start = esp_timer_get_time();
+      esp_jpeg_image_output_t out;
+      esp_err_t err = preview_decode(fb, preview_buf[back], &out);
+      camera_preview_return(fb);
+      int64_t decoded = esp_timer_get_time();
+
+      if (err == ESP_OK)
+      {
+        lvgl_port_lock(0);
+        if (preview_canvas)
+        {
+          lv_canvas_set_buffer(preview_canvas, preview_buf[back], out.width, out.height, LV_IMG_CF_INDEXED_1BIT);
+          lv_canvas_set_palette(preview_canvas, 0, lv_color_black());
+          lv_canvas_set_palette(preview_canvas, 1, lv_color_white());
+          lv_obj_clear_flag(preview_canvas, LV_OBJ_FLAG_HIDDEN);
+        }
+        lvgl_port_unlock();
+        back ^= 1;
+        frames++;
+        decode_us += decoded - start;
+      }
+      else
+      {
+        ESP_LOGD(TAG, "Preview frame skipped (%s)", esp_err_to_name(err));
+      }
+      // Waiting for the frame does not count, the task is blocked meanwhile
+      busy_us += esp_timer_get_time() - start;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (now - window_start >= PREVIEW_STATS_INTERVAL_US)
+    {
+      int64_t elapsed = now - window_start;
+      ESP_LOGI(TAG, "Preview: %.1f fps, decode %" PRId64 " us/frame, CPU %.1f%%",
+               frames * 1e6f / elapsed, frames ? decode_us / frames : 0,
+               busy_us * 100.0f / elapsed);
+      frames = 0;
+      busy_us = 0;
+      decode_us = 0;
+      window_start = now;
+    }
+
+    vTaskDelayUntil(&last_wake, period);
+  }
+
+  xSemaphoreGive(preview_done);
+  vTaskDelete(NULL);
+}
+
+static esp_err_t display_start_preview(lv_obj_t *scr)
+{
+  if (!preview_done)
+  {
+    preview_done = xSemaphoreCreateBinary();
+    if (!preview_done)
+    {
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  esp_err_t err = camera_preview_start();
+  if (err != ESP_OK)
+  {
+    ESP_LOGW(TAG, "Camera preview unavailable (%s)", esp_err_to_name(err));
+    return err;
+  }
+
+  // Shown once the first frame is decoded
+  preview_canvas = lv_canvas_create(scr);
+  lv_obj_add_flag(preview_canvas, LV_OBJ_FLAG_HIDDEN);
+  lv_obj_align(preview_canvas, LV_ALIGN_LEFT_MID, 0, 0);
+
+  lv_obj_t *label = lv_label_create(scr);
+  lv_label_set_long_mode(label, LV_LABEL_LONG_SCROLL_CIRCULAR);
+  lv_label_set_text(label, "Waiting for Session...");
+  lv_obj_set_width(label, PREVIEW_LABEL_WIDTH);
+  lv_obj_align(label, LV_ALIGN_RIGHT_MID, 0, 0);
+
+  // Core 0 runs the sensor loop, keep decoding off it
+  preview_running = true;
+  if (xTaskCreatePinnedToCore(preview_task_fn, "preview", PREVIEW_TASK_STACK, NULL, 1,
+                              &preview_task, portNUM_PROCESSORS - 1) != pdPASS)
+  {
+    preview_running = false;
+    preview_task = NULL;
+    camera_preview_stop();
+    lv_obj_clean(scr);
+    preview_canvas = NULL;
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+static void display_stop_preview(void)
+{
+  if (!preview_task)
+  {
+    return;
+  }
+  preview_running = false;
+  xSemaphoreTake(preview_done, portMAX_DELAY);
+  preview_task = NULL;
+  preview_canvas = NULL;
+  camera_preview_stop();
+}
+#endif
+
 lv_disp_t *display_init(void)
 {
 #ifdef CONFIG_ENABLE_DISPLAY
@@ -111,9 +282,19 @@ lv_disp_t *display_init(void)
 void display_write_await_session(lv_disp_t *disp)
 {
 #ifdef CONFIG_ENABLE_DISPLAY
+#ifdef CONFIG_DISPLAY_CAMERA_PREVIEW
+  display_stop_preview();
+#endif
   lv_obj_t *scr = lv_disp_get_scr_act(disp);
   lv_obj_clean(scr);
 
+#ifdef CONFIG_DISPLAY_CAMERA_PREVIEW
+  if (display_start_preview(scr) == ESP_OK)
+  {
+    return;
+  }
+#endif
+
   lv_obj_t *label = lv_label_create(scr);
   lv_obj_t *img = lv_img_create(scr);
 
@@ -135,6 +316,9 @@ void display_write_await_session(lv_disp_t *disp)
 void display_write_result(lv_disp_t *disp, const SessionResult *res)
 {
 #ifdef CONFIG_ENABLE_DISPLAY
+#ifdef CONFIG_DISPLAY_CAMERA_PREVIEW
+  display_stop_preview();
+#endif
   lv_obj_t *scr = lv_disp_get_scr_act(disp);
   lv_obj_clean(scr);
 
@@ -165,6 +349,9 @@ void display_show_icon(lv_disp_t *disp)
 
 void display_cleanup(void)
 {
+#ifdef CONFIG_DISPLAY_CAMERA_PREVIEW
+  display_stop_preview();
+#endif
   if (i2c_bus_handle != NULL)
   {
     ESP_LOGI(TAG, "Deinitialize I2C master bus");
@@ -0,0 +1,145 @@
+#include "event_channel.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include "mqtt_client.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if CONFIG_EVENT_CHANNEL_MQTT
+static const char *TAG = "event_channel";
+
+static esp_mqtt_client_handle_t client = NULL;
+static volatile bool connected = false;
+static char topic[64];
+
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+  esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+  switch ((esp_mqtt_event_id_t)event_id)
+  {
+  case MQTT_EVENT_CONNECTED:
+    ESP_LOGI(TAG, "Connected");
+    connected = true;
+    break;
+  case MQTT_EVENT_DISCONNECTED:
+    // the client reconnects by itself and resends what was not acknowledged
+    ESP_LOGW(TAG, "Disconnected");
+    connected = false;
+    break;
+  case MQTT_EVENT_PUBLISHED:
+    ESP_LOGD(TAG, "Event %d acknowledged", event->msg_id);
+    break;
+  case MQTT_EVENT_ERROR:
+    ESP_LOGW(TAG, "Connection error");
+    break;
+  default:
+    break;
+  }
+}
+
+static esp_err_t mqtt_start(const event_channel_config_t *config)
+{
+  if (client)
+  {
+    return ESP_OK;
+  }
+  snprintf(topic, sizeof(topic), "%s", config->topic);
+
+  const esp_mqtt_client_config_t mqtt_config = {
+      .broker.address.uri = config->uri,
+      .credentials = {
+          .client_id = http_client_device_id(),
+          .username = config->username,
+          .authentication.password = config->password,
+      },
+      .session.keepalive = CONFIG_EVENT_CHANNEL_MQTT_KEEPALIVE_S,
+  };
+  client = esp_mqtt_client_init(&mqtt_config);
+  if (!client)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+  esp_err_t err = esp_mqtt_client_start(client);
+  if (err != ESP_OK)
+  {
+    esp_mqtt_client_destroy(client);
+    client = NULL;
+    return err;
+  }
+  ESP_LOGI(TAG, "Publishing runs to %s on %s", topic, config->uri);
+  return ESP_OK;
+}
+
+static void mqtt_stop(void)
+{
+  if (client)
+  {
+    esp_mqtt_client_stop(client);
+    esp_mqtt_client_destroy(client);
+    client = NULL;
+    connected = false;
+  }
+}
+
+static bool mqtt_is_connected(void)
+{
+  return connected;
+}
+
+static esp_err_t mqtt_publish_run(const session_data_t *session_data)
+{
+  if (!session_data || !session_data->idempotency_key)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!client || !connected)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  char idempotency_key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE + 4];
+  snprintf(idempotency_key, sizeof(idempotency_key), "%s-run", session_data->idempotency_key);
+
+  cJSON *json = cJSON_CreateObject();
+  bool ok = json &&
+            cJSON_AddStringToObject(json, "device", http_client_device_id()) &&
+            cJSON_AddStringToObject(json, "idempotency_key", idempotency_key) &&
+            // Left out until SNTP has set the clock, it would be in 1970
+            (!session_data->timestamp ||
+             cJSON_AddNumberToObject(json, "timestamp", (double)session_data->timestamp)) &&
+            cJSON_AddNumberToObject(json, "rate", session_data->rate) &&
+            cJSON_AddNumberToObject(json, "duration", session_data->duration) &&
+            cJSON_AddNumberToObject(json, "volume", session_data->volume);
+  char *payload = ok ? cJSON_PrintUnformatted(json) : NULL;
+  cJSON_Delete(json);
+  if (!payload)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+
+  // Stored in the outbox until the broker acknowledges it, the MQTT task does the sending
+  int msg_id = esp_mqtt_client_enqueue(client, topic, payload, 0, CONFIG_EVENT_CHANNEL_MQTT_QOS, 0, true);
+  free(payload);
+  if (msg_id < 0)
+  {
+    ESP_LOGW(TAG, "Run event not queued (%d)", msg_id);
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+static bool mqtt_is_flushed(void)
+{
+  return !client || esp_mqtt_client_get_outbox_size(client) == 0;
+}
+
+const event_channel_t event_channel_mqtt = {
+    .name = "MQTT",
+    .start = mqtt_start,
+    .stop = mqtt_stop,
+    .is_connected = mqtt_is_connected,
+    .publish_run = mqtt_publish_run,
+    .is_flushed = mqtt_is_flushed,
+};
+#endif
@@ -2,8 +2,20 @@
 #include "esp_http_client.h"
 #include "esp_log.h"
 #include "esp_crt_bundle.h"
-#include "cJSON.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_mac.h"
+#endif
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "img_converters.h"
+#include "run_encoding.h"
+#include <inttypes.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 #include <stdlib.h>
 #include <sys/param.h>
 
@@ -11,20 +23,76 @@ static const char *TAG = "http_client";
 
 static http_client_config_t default_config = {
     .host = "4.231.40.213",
+#if CONFIG_HTTP_CLIENT_TLS
+    .port = 443,
+    .use_tls = true,
+#else
     .port = 80,
+#endif
     .auth_header = "Basic dHJpY2h0ZXI6c3VwZXItc2FmZS1wYXNzd29yZA==",
     .timeout_ms = 10000};
 
 static http_client_config_t current_config;
 static bool initialized = false;
+static char device_id[24];
+
+// One client for all requests. It keeps the connection between requests and, over TLS, the session
+// of the last handshake, so a new connection resumes it with a ticket or session ID.
+static esp_http_client_handle_t shared_client = NULL;
+static int64_t shared_client_idle_since = 0;
+// Set by the event handler when the current request had to open a new connection
+static bool connection_opened = false;
+// The previous request left its connection open, and the current request went out on it
+static bool connection_kept = false;
+static bool connection_reused = false;
+// The shared client holds the session of an earlier handshake and offers it on the next connection
+static bool tls_session_saved = false;
+static http_client_stats_t stats;
+#if CONFIG_HTTP_CLIENT_RUN_CBOR
+// Cleared when the server answers a CBOR run with 415, runs are then sent as JSON until the next restart
+static bool run_cbor_supported = true;
+#endif
+
+// Smoothed image upload throughput in bytes per second, 0 until the first upload completed
+static uint32_t upload_rate_bps = 0;
+
+// Smoothed round trip time and its mean deviation (RFC 6298), in microseconds
+typedef struct
+{
+  uint32_t srtt_us;
+  uint32_t rttvar_us;
+  bool valid;
+} http_rtt_t;
+
+// Connection setup, and from the end of the request body to the response headers
+static http_rtt_t connect_rtt;
+static http_rtt_t response_rtt;
+// Doubles the timeouts after each request that failed without a response, like TCP's RTO backoff
+static uint8_t timeout_backoff = 0;
+// End of the retry budget of the session being submitted, 0 outside a submission
+static int64_t retry_deadline_us = 0;
 
 typedef struct
 {
   char *buffer;
   int buffer_size;
   int data_len;
+  bool close; // the server closes the connection after this response
 } http_response_data_t;
 
+// Chunk payload of the streamed upload, a little below one TCP segment
+#define HTTP_STREAM_CHUNK_SIZE 1400
+// Fixed width "%04x\r\n" chunk header, leading zeros are valid chunk-size syntax
+#define HTTP_STREAM_CHUNK_HEADER 6
+
+typedef struct
+{
+  esp_http_client_handle_t client;
+  size_t fill;
+  size_t total;
+  char chunk[HTTP_STREAM_CHUNK_HEADER + HTTP_STREAM_CHUNK_SIZE + 2];
+} http_stream_t;
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
   http_response_data_t *response_data = (http_response_data_t *)evt->user_data;
@@ -36,12 +104,17 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     break;
   case HTTP_EVENT_ON_CONNECTED:
     ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+    connection_opened = true;
     break;
   case HTTP_EVENT_HEADER_SENT:
     ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
     break;
   case HTTP_EVENT_ON_HEADER:
     ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+    if (response_data && strcasecmp(evt->header_key, "Connection") == 0 && strcasecmp(evt->header_value, "close") == 0)
+    {
+      response_data->close = true;
+    }
     break;
   case HTTP_EVENT_ON_HEADERS_COMPLETE:
     ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADERS_COMPLETE");
@@ -72,6 +145,404 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
   return ESP_OK;
 }
 
+static void http_client_update_upload_rate(size_t bytes, int64_t elapsed_us)
+{
+  if (elapsed_us <= 0)
+  {
+    return;
+  }
+  uint32_t rate = (uint32_t)((uint64_t)bytes * 1000000 / elapsed_us);
+  upload_rate_bps = upload_rate_bps ? (upload_rate_bps * 3 + rate) / 4 : rate;
+}
+
+static void http_client_update_rtt(http_rtt_t *rtt, int64_t sample_us)
+{
+  uint32_t sample = (uint32_t)MIN(sample_us, (int64_t)UINT32_MAX);
+  if (!rtt->valid)
+  {
+    rtt->srtt_us = sample;
+    rtt->rttvar_us = sample / 2;
+    rtt->valid = true;
+    return;
+  }
+  uint32_t delta = rtt->srtt_us > sample ? rtt->srtt_us - sample : sample - rtt->srtt_us;
+  rtt->rttvar_us = (rtt->rttvar_us * 3 + delta) / 4;
+  rtt->srtt_us = (rtt->srtt_us * 7 + sample) / 8;
+}
+
+// RTO = SRTT + 4 * RTTVAR, plus twice the expected transfer time of the payload written in one go.
+// Falls back to the configured timeout, which is also the upper bound, until there are samples.
+// During a submission the upper bound is what is left of its retry budget.
+static int http_client_timeout_ms(const http_rtt_t *rtt, size_t payload)
+{
+  int upper_ms = current_config.timeout_ms;
+  if (retry_deadline_us)
+  {
+    int64_t left_ms = (retry_deadline_us - esp_timer_get_time()) / 1000;
+    upper_ms = (int)MAX(MIN(left_ms, (int64_t)upper_ms), (int64_t)MIN(CONFIG_HTTP_CLIENT_MIN_TIMEOUT_MS, upper_ms));
+  }
+  if (!rtt->valid || (payload && !upload_rate_bps))
+  {
+    return upper_ms;
+  }
+  uint64_t rto_us = rtt->srtt_us + 4 * (uint64_t)rtt->rttvar_us;
+  if (payload)
+  {
+    rto_us += (uint64_t)payload * 2 * 1000000 / upload_rate_bps;
+  }
+  rto_us <<= timeout_backoff;
+  return (int)MAX(MIN(rto_us / 1000, (uint64_t)upper_ms), (uint64_t)MIN(CONFIG_HTTP_CLIENT_MIN_TIMEOUT_MS, upper_ms));
+}
+
+static void http_client_note_result(esp_err_t err, int http_status)
+{
+  if (err == ESP_OK || http_status > 0)
+  {
+    timeout_backoff = 0;
+  }
+  else if (timeout_backoff < 6)
+  {
+    timeout_backoff++;
+  }
+}
+
+// Connects with the connect timeout, then switches to the timeout for writing up to payload bytes at once.
+// On a kept connection only the request headers are sent.
+static esp_err_t http_client_open(esp_http_client_handle_t client, int write_len, size_t payload)
+{
+  esp_http_client_set_timeout_ms(client, http_client_timeout_ms(&connect_rtt, 0));
+  connection_opened = false;
+  int64_t start = esp_timer_get_time();
+  esp_err_t err = esp_http_client_open(client, write_len);
+  connection_reused = connection_kept && !connection_opened;
+  connection_kept = err == ESP_OK;
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  if (connection_opened)
+  {
+    // TCP and, over TLS, the full or resumed handshake
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    http_client_update_rtt(&connect_rtt, elapsed_us);
+    stats.connections++;
+    stats.last_connect_us = elapsed_us;
+    if (!current_config.use_tls)
+    {
+      ESP_LOGD(TAG, "Connected in %" PRId64 " us", elapsed_us);
+    }
+    else if (tls_session_saved)
+    {
+      // Whether the server resumed it is not exposed by esp_http_client, a declined session
+      // costs a full handshake
+      stats.sessions_offered++;
+      ESP_LOGI(TAG, "Connected in %" PRId64 " us, saved session offered", elapsed_us);
+    }
+    else
+    {
+      ESP_LOGI(TAG, "Connected in %" PRId64 " us, full handshake", elapsed_us);
+    }
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    tls_session_saved = current_config.use_tls;
+#endif
+  }
+  else
+  {
+    stats.reused++;
+  }
+  esp_http_client_set_timeout_ms(client, http_client_timeout_ms(&connect_rtt, payload));
+  return ESP_OK;
+}
+
+static void http_client_close(esp_http_client_handle_t client)
+{
+  esp_http_client_close(client);
+  connection_kept = false;
+}
+
+static void http_client_reset_connection(void)
+{
+  if (shared_client)
+  {
+    esp_http_client_cleanup(shared_client);
+    shared_client = NULL;
+  }
+  connection_kept = false;
+  tls_session_saved = false;
+}
+
+// Returns the shared client pointed at path, with a new one created on first use
+static esp_http_client_handle_t http_client_acquire(const char *path, http_response_data_t *response_data)
+{
+  char url[160];
+  snprintf(url, sizeof(url), "%s://%s:%d%s", current_config.use_tls ? "https" : "http",
+           current_config.host, current_config.port, path);
+
+  if (!shared_client)
+  {
+    esp_http_client_config_t client_config = {
+        .url = url,
+        .event_handler = http_event_handler,
+        .timeout_ms = current_config.timeout_ms,
+        .buffer_size = 1024,
+        .buffer_size_tx = 1024,
+        .transport_type = current_config.use_tls ? HTTP_TRANSPORT_OVER_SSL : HTTP_TRANSPORT_OVER_TCP,
+        .skip_cert_common_name_check = false,
+        .is_async = false,
+        .use_global_ca_store = false,
+        .cert_pem = current_config.ca_cert_pem,
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        .crt_bundle_attach = current_config.use_tls && !current_config.ca_cert_pem ? esp_crt_bundle_attach : NULL,
+#endif
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        .save_client_session = current_config.use_tls,
+#endif
+    };
+    shared_client = esp_http_client_init(&client_config);
+    if (!shared_client)
+    {
+      ESP_LOGE(TAG, "Failed to initialize HTTP client");
+      return NULL;
+    }
+  }
+  else
+  {
+    // Servers drop idle connections after a few seconds, reusing one after that only costs a retry
+    if (esp_timer_get_time() - shared_client_idle_since > CONFIG_HTTP_CLIENT_KEEP_ALIVE_MS * 1000LL)
+    {
+      http_client_close(shared_client);
+    }
+    esp_http_client_set_url(shared_client, url);
+  }
+  esp_http_client_set_user_data(shared_client, response_data);
+  return shared_client;
+}
+
+// Keeps the connection for the next request if the response was read completely
+static void http_client_release(esp_http_client_handle_t client, bool keep)
+{
+  if (!keep)
+  {
+    http_client_close(client);
+  }
+  esp_http_client_set_user_data(client, NULL);
+  shared_client_idle_since = esp_timer_get_time();
+}
+
+// A kept connection the server closed in the meantime only fails once the request is sent.
+// Such a request is repeated right away on a new connection, without counting as a retry.
+static bool http_client_should_reconnect(esp_http_client_handle_t client, esp_err_t err)
+{
+  if (err == ESP_OK || !connection_reused)
+  {
+    return false;
+  }
+  ESP_LOGI(TAG, "Kept connection failed (%s), reconnecting", esp_err_to_name(err));
+  http_client_close(client);
+  return true;
+}
+
+static bool http_client_link_is_slow(void)
+{
+#if CONFIG_HTTP_CLIENT_OPTIMIZE_JPEG
+  return upload_rate_bps && (uint64_t)upload_rate_bps * 8 / 1000 < CONFIG_HTTP_CLIENT_OPTIMIZE_JPEG_BELOW_KBPS;
+#else
+  return false;
+#endif
+}
+
+// Shrinks the image losslessly when the link is slow enough for the CPU time to pay off.
+// Returns the optimized buffer (to be freed by the caller) or NULL to send the frame as is.
+static uint8_t *http_client_optimize_image(const camera_fb_t *image_fb, size_t *out_len)
+{
+  if (image_fb->format != PIXFORMAT_JPEG || !http_client_link_is_slow())
+  {
+    return NULL;
+  }
+
+  uint8_t *optimized = NULL;
+  size_t optimized_len = 0;
+  int64_t start = esp_timer_get_time();
+  if (!jpg_optimize_huffman(image_fb->buf, image_fb->len, &optimized, &optimized_len))
+  {
+    return NULL;
+  }
+  int64_t cpu_us = esp_timer_get_time() - start;
+
+  if (optimized_len >= image_fb->len)
+  {
+    free(optimized);
+    return NULL;
+  }
+
+  size_t saved = image_fb->len - optimized_len;
+  ESP_LOGI(TAG, "Huffman optimization: %zu -> %zu bytes, saved %zu bytes (~%" PRIu32 " ms at %" PRIu32 " B/s) for %" PRId64 " ms CPU",
+           image_fb->len, optimized_len, saved, (uint32_t)((uint64_t)saved * 1000 / upload_rate_bps), upload_rate_bps, cpu_us / 1000);
+  *out_len = optimized_len;
+  return optimized;
+}
+
+// Builds the Exif segment that makes the uploaded image describe the session on its own
+size_t http_client_build_metadata(const session_data_t *session_data, uint8_t *segment, size_t size)
+{
+#if CONFIG_HTTP_CLIENT_IMAGE_METADATA
+  char description[80];
+  snprintf(description, sizeof(description), "volume=%.3f l rate=%.2f l/min duration=%.2f s",
+           session_data->volume, session_data->rate, session_data->duration);
+
+  // ImageDescription, DateTime, HostComputer in ascending tag order. Without a set clock the
+  // DateTime would be in 1970, so it is left out.
+  jpg_exif_entry_t entries[3];
+  size_t count = 0;
+  entries[count++] = (jpg_exif_entry_t){0x010E, description};
+  char date_time[20];
+  if (session_data->timestamp)
+  {
+    struct tm tm;
+    gmtime_r(&session_data->timestamp, &tm);
+    strftime(date_time, sizeof(date_time), "%Y:%m:%d %H:%M:%S", &tm);
+    entries[count++] = (jpg_exif_entry_t){0x0132, date_time};
+  }
+  entries[count++] = (jpg_exif_entry_t){0x013C, device_id};
+  return jpg_exif_build(segment, size, entries, count);
+#else
+  return 0;
+#endif
+}
+
+// jpg_out_cb: writes straight to the connection
+static size_t http_client_write_cb(void *arg, size_t index, const void *data, size_t len)
+{
+  esp_http_client_handle_t client = (esp_http_client_handle_t)arg;
+  size_t done = 0;
+  while (done < len)
+  {
+    int n = esp_http_client_write(client, (const char *)data + done, len - done);
+    if (n <= 0)
+    {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+static esp_err_t http_client_read_response(esp_http_client_handle_t client)
+{
+  esp_http_client_set_timeout_ms(client, http_client_timeout_ms(&response_rtt, 0));
+  int64_t start = esp_timer_get_time();
+  if (esp_http_client_fetch_headers(client) < 0)
+  {
+    return ESP_ERR_HTTP_FETCH_HEADER;
+  }
+  http_client_update_rtt(&response_rtt, esp_timer_get_time() - start);
+  // the event handler collects the body
+  return esp_http_client_flush_response(client, NULL);
+}
+
+// Sends a JPEG with the metadata segment spliced in behind its header. The image bytes are
+// written from the source buffer as they are, only the segment is added.
+static esp_err_t http_client_send_jpeg(esp_http_client_handle_t client, const uint8_t *jpeg, size_t len,
+                                       const uint8_t *segment, size_t segment_len, size_t *body_len)
+{
+  if (len < 2 || jpeg[0] != 0xFF || jpeg[1] != 0xD8)
+  {
+    segment_len = 0;
+  }
+  *body_len = len + segment_len;
+
+  esp_err_t err = http_client_open(client, *body_len, *body_len);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  jpg_splice_t splice;
+  jpg_splice_init(&splice, segment, segment_len, http_client_write_cb, client);
+  bool ok = jpg_splice_write(&splice, 0, jpeg, len) == len &&
+            (jpg_splice_finish(&splice) || !segment_len);
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "Image upload failed after %zu of %zu bytes", splice.index, *body_len);
+    return ESP_FAIL;
+  }
+  return http_client_read_response(client);
+}
+
+static bool http_stream_flush(http_stream_t *stream)
+{
+  if (!stream->fill)
+  {
+    return true;
+  }
+  char header[HTTP_STREAM_CHUNK_HEADER + 1];
+  snprintf(header, sizeof(header), "%04x\r\n", (unsigned)stream->fill);
+  memcpy(stream->chunk, header, HTTP_STREAM_CHUNK_HEADER);
+  memcpy(stream->chunk + HTTP_STREAM_CHUNK_HEADER + stream->fill, "\r\n", 2);
+  int len = HTTP_STREAM_CHUNK_HEADER + stream->fill + 2;
+  stream->fill = 0;
+  return esp_http_client_write(stream->client, stream->chunk, len) == len;
+}
+
+// jpg_out_cb: collects encoder output into chunks and writes each one as soon as it is full
+static size_t http_stream_jpg_cb(void *arg, size_t index, const void *data, size_t len)
+{
+  http_stream_t *stream = (http_stream_t *)arg;
+  const uint8_t *src = (const uint8_t *)data;
+  size_t left = len;
+  while (left)
+  {
+    size_t n = MIN(left, HTTP_STREAM_CHUNK_SIZE - stream->fill);
+    memcpy(stream->chunk + HTTP_STREAM_CHUNK_HEADER + stream->fill, src, n);
+    stream->fill += n;
+    src += n;
+    left -= n;
+    if (stream->fill == HTTP_STREAM_CHUNK_SIZE && !http_stream_flush(stream))
+    {
+      return 0;
+    }
+  }
+  stream->total += len;
+  return len;
+}
+
+// Encodes a raw frame MCU row by MCU row into a chunked request body, so only the encoder's
+// line buffers and one chunk are held in memory and the first bytes leave while the rest is encoded.
+static esp_err_t http_client_stream_image(esp_http_client_handle_t client, const camera_fb_t *image_fb,
+                                          const uint8_t *segment, size_t segment_len, size_t *body_len)
+{
+  http_stream_t *stream = calloc(1, sizeof(http_stream_t));
+  if (!stream)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  stream->client = client;
+
+  esp_err_t err = http_client_open(client, -1, sizeof(stream->chunk));
+  if (err != ESP_OK)
+  {
+    free(stream);
+    return err;
+  }
+
+  // The metadata segment is spliced into the encoder output on its way to the chunks
+  jpg_splice_t splice;
+  jpg_splice_init(&splice, segment, segment_len, http_stream_jpg_cb, stream);
+  bool ok = fmt2jpg_cb(image_fb->buf, image_fb->len, image_fb->width, image_fb->height, image_fb->format,
+                       CONFIG_HTTP_CLIENT_STREAM_JPEG_QUALITY, jpg_splice_write, &splice) &&
+            jpg_splice_finish(&splice) &&
+            http_stream_flush(stream) &&
+            esp_http_client_write(client, "0\r\n\r\n", 5) == 5;
+  *body_len = stream->total;
+  free(stream);
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "Streaming image upload failed after %zu bytes", *body_len);
+    return ESP_FAIL;
+  }
+  return http_client_read_response(client);
+}
+
 esp_err_t http_client_init(void)
 {
   if (initialized)
@@ -83,6 +554,13 @@ esp_err_t http_client_init(void)
   memcpy(&current_config, &default_config, sizeof(http_client_config_t));
   initialized = true;
 
+  uint8_t mac[6] = {0};
+#if !CONFIG_IDF_TARGET_LINUX
+  esp_read_mac(mac, ESP_MAC_WIFI_STA);
+#endif
+  snprintf(device_id, sizeof(device_id), "trichter-%02x%02x%02x%02x%02x%02x",
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
   ESP_LOGI(TAG, "HTTP client initialized with host: %s:%d", current_config.host, current_config.port);
   return ESP_OK;
 }
@@ -94,6 +572,17 @@ esp_err_t http_client_set_config(const http_client_config_t *config)
     return ESP_ERR_INVALID_ARG;
   }
 
+  // Link estimates belong to the previous backend
+  if (initialized && (strcmp(config->host, current_config.host) || config->port != current_config.port))
+  {
+    memset(&connect_rtt, 0, sizeof(connect_rtt));
+    memset(&response_rtt, 0, sizeof(response_rtt));
+    upload_rate_bps = 0;
+    timeout_backoff = 0;
+  }
+
+  // The kept connection and TLS session belong to the previous settings
+  http_client_reset_connection();
   memcpy(&current_config, config, sizeof(http_client_config_t));
   initialized = true;
 
@@ -101,7 +590,7 @@ esp_err_t http_client_set_config(const http_client_config_t *config)
   return ESP_OK;
 }
 
-esp_err_t http_client_upload_image(const camera_fb_t *image_fb, image_upload_response_t *response)
+esp_err_t http_client_upload_image(const session_data_t *session_data, image_upload_response_t *response)
 {
   if (!initialized)
   {
@@ -109,11 +598,12 @@ esp_err_t http_client_upload_image(const camera_fb_t *image_fb, image_upload_res
     return ESP_ERR_INVALID_STATE;
   }
 
-  if (!image_fb || !response)
+  if (!session_data || !session_data->image_fb || !response)
   {
     ESP_LOGE(TAG, "Invalid parameters");
     return ESP_ERR_INVALID_ARG;
   }
+  const camera_fb_t *image_fb = session_data->image_fb;
 
   // Initialize response
   memset(response, 0, sizeof(image_upload_response_t));
@@ -126,52 +616,71 @@ esp_err_t http_client_upload_image(const camera_fb_t *image_fb, image_upload_res
       .buffer_size = sizeof(response_buffer),
       .data_len = 0};
 
-  // Create URL
-  char url[128];
-  snprintf(url, sizeof(url), "http://%s:%d/api/v1/images",
-           current_config.host, current_config.port);
-
-  // Configure HTTP client
-  esp_http_client_config_t client_config = {
-      .url = url,
-      .event_handler = http_event_handler,
-      .user_data = &response_data,
-      .timeout_ms = current_config.timeout_ms,
-      .buffer_size = 1024,
-      .buffer_size_tx = 1024,
-      .transport_type = HTTP_TRANSPORT_OVER_TCP,
-      .skip_cert_common_name_check = false,
-      .is_async = false,
-      .use_global_ca_store = false,
-      .crt_bundle_attach = NULL};
-
-  esp_http_client_handle_t client = esp_http_client_init(&client_config);
+  esp_http_client_handle_t client = http_client_acquire("/api/v1/images", &response_data);
   if (!client)
   {
-    ESP_LOGE(TAG, "Failed to initialize HTTP client");
     return ESP_ERR_NO_MEM;
   }
 
   esp_err_t err = ESP_OK;
 
-  // Set headers
+  // Set headers, the client keeps them from the previous request
   esp_http_client_set_method(client, HTTP_METHOD_POST);
   esp_http_client_set_header(client, "Authorization", current_config.auth_header);
   esp_http_client_set_header(client, "Content-Type", "image/jpeg");
   esp_http_client_set_header(client, "Accept", "text/plain");
+  char idempotency_key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE + 6];
+  if (session_data->idempotency_key)
+  {
+    snprintf(idempotency_key, sizeof(idempotency_key), "%s-image", session_data->idempotency_key);
+    esp_http_client_set_header(client, "Idempotency-Key", idempotency_key);
+  }
+  else
+  {
+    esp_http_client_delete_header(client, "Idempotency-Key");
+  }
 
-  // Set post data
-  esp_http_client_set_post_field(client, (const char *)image_fb->buf, image_fb->len);
+  uint8_t segment[HTTP_CLIENT_IMAGE_METADATA_SIZE];
+  size_t segment_len = http_client_build_metadata(session_data, segment, sizeof(segment));
 
-  ESP_LOGI(TAG, "Uploading image: %zu bytes to %s", image_fb->len, url);
-  ESP_LOGI(TAG, "HTTP client config: host=%s, port=%d, transport=TCP", current_config.host, current_config.port);
+  size_t body_len = image_fb->len;
+  uint8_t *optimized = NULL;
+  int64_t start = 0;
+  if (image_fb->format == PIXFORMAT_JPEG)
+  {
+    optimized = http_client_optimize_image(image_fb, &body_len);
 
-  // Perform request
-  err = esp_http_client_perform(client);
+    ESP_LOGI(TAG, "Uploading image: %zu bytes + %zu bytes metadata", body_len, segment_len);
+    ESP_LOGI(TAG, "HTTP client config: host=%s, port=%d, transport=%s",
+             current_config.host, current_config.port, current_config.use_tls ? "TLS" : "TCP");
+  }
+  else
+  {
+    // Raw frames are encoded while they are sent
+    ESP_LOGI(TAG, "Streaming %zux%zu raw image as JPEG", image_fb->width, image_fb->height);
+  }
+  size_t jpeg_len = body_len;
+  do
+  {
+    response_data.data_len = 0;
+    start = esp_timer_get_time();
+    if (image_fb->format == PIXFORMAT_JPEG)
+    {
+      err = http_client_send_jpeg(client, optimized ? optimized : image_fb->buf, jpeg_len, segment, segment_len, &body_len);
+    }
+    else
+    {
+      err = http_client_stream_image(client, image_fb, segment, segment_len, &body_len);
+      ESP_LOGI(TAG, "Streamed %zu bytes in %" PRId64 " ms", body_len, (esp_timer_get_time() - start) / 1000);
+    }
+  } while (http_client_should_reconnect(client, err));
+  http_client_release(client, err == ESP_OK && !response_data.close);
+  http_client_note_result(err, esp_http_client_get_status_code(client));
   if (err == ESP_OK)
   {
+    http_client_update_upload_rate(body_len, esp_timer_get_time() - start);
     response->http_status_code = esp_http_client_get_status_code(client);
-    ESP_LOGI(TAG, "Image upload HTTP Status = %d, content_length = %lld",
+    ESP_LOGI(TAG, "Image upload HTTP Status = %d, content_length = %" PRId64,
              response->http_status_code,
              esp_http_client_get_content_length(client));
 
@@ -211,7 +720,7 @@ esp_err_t http_client_upload_image(const camera_fb_t *image_fb, image_upload_res
     ESP_LOGE(TAG, "Image upload request failed: %s", esp_err_to_name(err));
   }
 
-  esp_http_client_cleanup(client);
+  free(optimized);
 
   if (err != ESP_OK)
   {
@@ -221,48 +730,14 @@ esp_err_t http_client_upload_image(const camera_fb_t *image_fb, image_upload_res
   return err;
 }
 
-esp_err_t http_client_create_run(const session_data_t *session_data,
-                                 const char *image_resource_name,
-                                 run_create_response_t *response)
+// Posts a run, or an array of runs, to /api/v1/runs
+static esp_err_t http_client_post_runs(const void *body, size_t body_len, const char *content_type,
+                                       const char *idempotency_key, run_create_response_t *response)
 {
-  if (!initialized)
-  {
-    ESP_LOGE(TAG, "HTTP client not initialized");
-    return ESP_ERR_INVALID_STATE;
-  }
-
-  if (!session_data || !image_resource_name || !response)
-  {
-    ESP_LOGE(TAG, "Invalid parameters");
-    return ESP_ERR_INVALID_ARG;
-  }
-
   // Initialize response
   memset(response, 0, sizeof(run_create_response_t));
   response->result = ESP_FAIL;
 
-  // Create JSON payload
-  cJSON *json = cJSON_CreateObject();
-  if (!json)
-  {
-    ESP_LOGE(TAG, "Failed to create JSON object");
-    return ESP_ERR_NO_MEM;
-  }
-
-  cJSON_AddNumberToObject(json, "rate", session_data->rate);
-  cJSON_AddNumberToObject(json, "duration", session_data->duration);
-  cJSON_AddNumberToObject(json, "volume", session_data->volume);
-  cJSON_AddStringToObject(json, "image", image_resource_name);
-
-  char *json_string = cJSON_Print(json);
-  cJSON_Delete(json);
-
-  if (!json_string)
-  {
-    ESP_LOGE(TAG, "Failed to convert JSON to string");
-    return ESP_ERR_NO_MEM;
-  }
-
   // Prepare response buffer
   char response_buffer[512] = {0};
   http_response_data_t response_data = {
@@ -270,52 +745,44 @@ esp_err_t http_client_create_run(const session_data_t *session_data,
       .buffer_size = sizeof(response_buffer),
       .data_len = 0};
 
-  // Create URL
-  char url[128];
-  snprintf(url, sizeof(url), "http://%s:%d/api/v1/runs",
-           current_config.host, current_config.port);
-
-  // Configure HTTP client
-  esp_http_client_config_t client_config = {
-      .url = url,
-      .event_handler = http_event_handler,
-      .user_data = &response_data,
-      .timeout_ms = current_config.timeout_ms,
-      .buffer_size = 1024,
-      .buffer_size_tx = 1024,
-      .transport_type = HTTP_TRANSPORT_OVER_TCP,
-      .skip_cert_common_name_check = false,
-      .is_async = false,
-      .use_global_ca_store = false,
-      .crt_bundle_attach = NULL};
-
-  esp_http_client_handle_t client = esp_http_client_init(&client_config);
+  esp_http_client_handle_t client = http_client_acquire("/api/v1/runs", &response_data);
   if (!client)
   {
-    ESP_LOGE(TAG, "Failed to initialize HTTP client");
-    free(json_string);
     return ESP_ERR_NO_MEM;
   }
 
   esp_err_t err = ESP_OK;
 
-  // Set headers
+  // Set headers, the client keeps them from the previous request
   esp_http_client_set_method(client, HTTP_METHOD_POST);
   esp_http_client_set_header(client, "Authorization", current_config.auth_header);
-  esp_http_client_set_header(client, "Content-Type", "application/json");
-
-  // Set post data
-  esp_http_client_set_post_field(client, json_string, strlen(json_string));
-
-  ESP_LOGI(TAG, "Creating run with JSON: %s", json_string);
-  ESP_LOGI(TAG, "Sending to: %s", url);
+  esp_http_client_set_header(client, "Content-Type", content_type);
+  esp_http_client_delete_header(client, "Accept");
+  if (idempotency_key)
+  {
+    esp_http_client_set_header(client, "Idempotency-Key", idempotency_key);
+  }
+  else
+  {
+    esp_http_client_delete_header(client, "Idempotency-Key");
+  }
 
-  // Perform request
-  err = esp_http_client_perform(client);
+  do
+  {
+    response_data.data_len = 0;
+    err = http_client_open(client, body_len, body_len);
+    if (err == ESP_OK)
+    {
+      err = http_client_write_cb(client, 0, body, body_len) == body_len ? http_client_read_response(client)
+                                                                        : ESP_ERR_HTTP_WRITE_DATA;
+    }
+  } while (http_client_should_reconnect(client, err));
+  http_client_release(client, err == ESP_OK && !response_data.close);
+  http_client_note_result(err, esp_http_client_get_status_code(client));
   if (err == ESP_OK)
   {
     response->http_status_code = esp_http_client_get_status_code(client);
-    ESP_LOGI(TAG, "Create run HTTP Status = %d, content_length = %lld",
+    ESP_LOGI(TAG, "Create run HTTP Status = %d, content_length = %" PRId64,
              response->http_status_code,
              esp_http_client_get_content_length(client));
 
@@ -348,9 +815,6 @@ esp_err_t http_client_create_run(const session_data_t *session_data,
     ESP_LOGE(TAG, "Create run request failed: %s", esp_err_to_name(err));
   }
 
-  esp_http_client_cleanup(client);
-  free(json_string);
-
   if (err != ESP_OK)
   {
     response->result = err;
@@ -359,31 +823,232 @@ esp_err_t http_client_create_run(const session_data_t *session_data,
   return err;
 }
 
-esp_err_t http_client_submit_session(const session_data_t *session_data,
-                                     image_upload_response_t *upload_response,
-                                     run_create_response_t *run_response)
+#if CONFIG_HTTP_CLIENT_RUN_CBOR
+// Posts the runs as CBOR. A 415 response means the server only takes JSON, the caller then sends
+// them again as JSON and so does every later request.
+static esp_err_t http_client_post_runs_cbor(const session_data_t *const *sessions,
+                                            const char *const *image_resource_names,
+                                            size_t count, bool array,
+                                            const char *idempotency_key, run_create_response_t *response)
 {
-  if (!session_data || !session_data->image_fb)
+  // Fits a run with a full flow curve, larger batches are measured and allocated
+  static uint8_t cbor_buffer[CONFIG_SENSOR_FLOW_MAX_SAMPLES + 256];
+
+  uint8_t *body = cbor_buffer;
+  size_t body_len = run_encoding_cbor(cbor_buffer, sizeof(cbor_buffer), sessions, image_resource_names, count, array);
+  if (body_len > sizeof(cbor_buffer))
   {
-    ESP_LOGE(TAG, "Invalid session data or missing image");
+    body = malloc(body_len);
+    if (!body)
+    {
+      memset(response, 0, sizeof(run_create_response_t));
+      response->result = ESP_ERR_NO_MEM;
+      return ESP_ERR_NO_MEM;
+    }
+    run_encoding_cbor(body, body_len, sessions, image_resource_names, count, array);
+  }
+
+  ESP_LOGI(TAG, "Creating %zu run%s as CBOR, %zu bytes", count, count == 1 ? "" : "s", body_len);
+  esp_err_t err = http_client_post_runs(body, body_len, RUN_ENCODING_CBOR, idempotency_key, response);
+  if (body != cbor_buffer)
+  {
+    free(body);
+  }
+  if (response->http_status_code == 415)
+  {
+    ESP_LOGW(TAG, "Server does not take CBOR runs, sending JSON from now on");
+    run_cbor_supported = false;
+  }
+  return err;
+}
+#endif
+
+esp_err_t http_client_create_run(const session_data_t *session_data,
+                                 const char *image_resource_name,
+                                 run_create_response_t *response)
+{
+  if (!initialized)
+  {
+    ESP_LOGE(TAG, "HTTP client not initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (!session_data || !image_resource_name || !response)
+  {
+    ESP_LOGE(TAG, "Invalid parameters");
     return ESP_ERR_INVALID_ARG;
   }
 
+  char idempotency_key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE + 4];
+  if (session_data->idempotency_key)
+  {
+    snprintf(idempotency_key, sizeof(idempotency_key), "%s-run", session_data->idempotency_key);
+  }
+
+#if CONFIG_HTTP_CLIENT_RUN_CBOR
+  if (run_cbor_supported)
+  {
+    esp_err_t err = http_client_post_runs_cbor(&session_data, &image_resource_name, 1, false,
+                                               session_data->idempotency_key ? idempotency_key : NULL, response);
+    if (response->http_status_code != 415)
+    {
+      return err;
+    }
+    http_client_free_run_response(response);
+  }
+#endif
+
+  char *json_string = run_encoding_json(&session_data, &image_resource_name, 1, false, true);
+  if (!json_string)
+  {
+    ESP_LOGE(TAG, "Failed to create JSON object");
+    return ESP_ERR_NO_MEM;
+  }
+
+  ESP_LOGI(TAG, "Creating run with JSON: %s", json_string);
+  esp_err_t err = http_client_post_runs(json_string, strlen(json_string), RUN_ENCODING_JSON,
+                                        session_data->idempotency_key ? idempotency_key : NULL, response);
+  free(json_string);
+  return err;
+}
+
+esp_err_t http_client_create_runs(const session_data_t *const *sessions,
+                                  const char *const *image_resource_names,
+                                  size_t count,
+                                  run_create_response_t *response)
+{
+  if (!initialized)
+  {
+    ESP_LOGE(TAG, "HTTP client not initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (!sessions || !image_resource_names || !count || !response)
+  {
+    ESP_LOGE(TAG, "Invalid parameters");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Each run carries its own key, so the server can drop runs that an earlier request already created
+#if CONFIG_HTTP_CLIENT_RUN_CBOR
+  if (run_cbor_supported)
+  {
+    esp_err_t err = http_client_post_runs_cbor(sessions, image_resource_names, count, true, NULL, response);
+    if (response->http_status_code != 415)
+    {
+      return err;
+    }
+    http_client_free_run_response(response);
+  }
+#endif
+
+  char *json_string = run_encoding_json(sessions, image_resource_names, count, true, false);
+  if (!json_string)
+  {
+    ESP_LOGE(TAG, "Failed to build JSON for %zu runs", count);
+    return ESP_ERR_NO_MEM;
+  }
+
+  size_t json_len = strlen(json_string);
+  ESP_LOGI(TAG, "Creating %zu runs in one request, %zu bytes", count, json_len);
+  esp_err_t err = http_client_post_runs(json_string, json_len, RUN_ENCODING_JSON, NULL, response);
+  free(json_string);
+  return err;
+}
+
+void http_client_make_idempotency_key(char *key, size_t size)
+{
+  uint32_t words[4];
+  esp_fill_random(words, sizeof(words));
+  snprintf(key, size, "%08" PRIx32 "%08" PRIx32 "%08" PRIx32 "%08" PRIx32, words[0], words[1], words[2], words[3]);
+}
+
+bool http_client_is_retryable(esp_err_t err, int http_status)
+{
+  if (http_status >= 200 && http_status < 300)
+  {
+    // accepted, but the answer was unusable
+    return err == ESP_ERR_INVALID_RESPONSE;
+  }
+  if (http_status)
+  {
+    return http_status == 408 || http_status == 425 || http_status == 429 || http_status >= 500;
+  }
+  // transport errors
+  return err != ESP_ERR_NO_MEM && err != ESP_ERR_INVALID_ARG && err != ESP_ERR_INVALID_STATE;
+}
+
+// Full jitter: a uniform delay below the exponential bound, so devices that failed together do not retry together
+static uint32_t http_client_backoff_ms(int attempt)
+{
+  uint32_t bound = CONFIG_HTTP_CLIENT_RETRY_BASE_MS << MIN(attempt, 16);
+  bound = MIN(bound, (uint32_t)CONFIG_HTTP_CLIENT_RETRY_MAX_MS);
+  return esp_random() % (bound + 1);
+}
+
+// Waits out the backoff and returns true when the failed attempt is worth repeating
+static bool http_client_should_retry(const char *phase, int attempt, esp_err_t err, int http_status)
+{
+  if (attempt + 1 >= CONFIG_HTTP_CLIENT_RETRY_ATTEMPTS || !http_client_is_retryable(err, http_status))
+  {
+    return false;
+  }
+  uint32_t delay_ms = http_client_backoff_ms(attempt);
+  if (retry_deadline_us && esp_timer_get_time() + delay_ms * 1000LL >= retry_deadline_us)
+  {
+    ESP_LOGW(TAG, "%s attempt %d failed (%s), retry budget spent", phase, attempt + 1, esp_err_to_name(err));
+    return false;
+  }
+  ESP_LOGW(TAG, "%s attempt %d failed (%s), retrying in %" PRIu32 " ms",
+           phase, attempt + 1, esp_err_to_name(err), delay_ms);
+  vTaskDelay(pdMS_TO_TICKS(delay_ms));
+  return true;
+}
+
+static esp_err_t http_client_submit_session_retried(const session_data_t *session_data,
+                                                   image_upload_response_t *upload_response,
+                                                   run_create_response_t *run_response)
+{
+
   // Local response structures if not provided
-  image_upload_response_t local_upload_response;
-  run_create_response_t local_run_response;
+  image_upload_response_t local_upload_response = {0};
+  run_create_response_t local_run_response = {0};
 
   image_upload_response_t *upload_resp = upload_response ? upload_response : &local_upload_response;
   run_create_response_t *run_resp = run_response ? run_response : &local_run_response;
 
-  ESP_LOGI(TAG, "Starting session submission...");
+  // One key for all attempts, so the server can tell a retry from a new session
+  session_data_t session = *session_data;
+  char idempotency_key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE];
+  if (!session.idempotency_key)
+  {
+    http_client_make_idempotency_key(idempotency_key, sizeof(idempotency_key));
+    session.idempotency_key = idempotency_key;
+  }
 
-  // Step 1: Upload image
-  esp_err_t err = http_client_upload_image(session_data->image_fb, upload_resp);
-  if (err != ESP_OK)
+  ESP_LOGI(TAG, "Starting session submission %s...", session.idempotency_key);
+
+  // Step 1: Upload image, unless an earlier submission of this session already did
+  esp_err_t err = ESP_OK;
+  if (!upload_resp->image_resource_name)
   {
-    ESP_LOGE(TAG, "Failed to upload image: %s", esp_err_to_name(err));
-    return err;
+    for (int attempt = 0;; attempt++)
+    {
+      err = http_client_upload_image(&session, upload_resp);
+      if (err == ESP_OK || !http_client_should_retry("Image upload", attempt, err, upload_resp->http_status_code))
+      {
+        break;
+      }
+    }
+    if (err != ESP_OK)
+    {
+      ESP_LOGE(TAG, "Failed to upload image: %s", esp_err_to_name(err));
+      return err;
+    }
+  }
+  else
+  {
+    ESP_LOGI(TAG, "Image already uploaded as %s", upload_resp->image_resource_name);
   }
 
   if (!upload_resp->image_resource_name)
@@ -392,8 +1057,16 @@ esp_err_t http_client_submit_session(const session_data_t *session_data,
     return ESP_ERR_INVALID_RESPONSE;
   }
 
-  // Step 2: Create run
-  err = http_client_create_run(session_data, upload_resp->image_resource_name, run_resp);
+  // Step 2: Create run, retries reuse the uploaded image
+  for (int attempt = 0;; attempt++)
+  {
+    http_client_free_run_response(run_resp);
+    err = http_client_create_run(&session, upload_resp->image_resource_name, run_resp);
+    if (err == ESP_OK || !http_client_should_retry("Create run", attempt, err, run_resp->http_status_code))
+    {
+      break;
+    }
+  }
   if (err != ESP_OK)
   {
     ESP_LOGE(TAG, "Failed to create run: %s", esp_err_to_name(err));
@@ -420,6 +1093,34 @@ esp_err_t http_client_submit_session(const session_data_t *session_data,
   return ESP_OK;
 }
 
+// The caller measures sessions in between, so the retries of one submission share a time budget.
+// What does not make it in time is left to the backlog.
+esp_err_t http_client_submit_session(const session_data_t *session_data,
+                                     image_upload_response_t *upload_response,
+                                     run_create_response_t *run_response)
+{
+  if (!session_data || !session_data->image_fb)
+  {
+    ESP_LOGE(TAG, "Invalid session data or missing image");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  retry_deadline_us = esp_timer_get_time() + CONFIG_HTTP_CLIENT_RETRY_BUDGET_MS * 1000LL;
+  esp_err_t err = http_client_submit_session_retried(session_data, upload_response, run_response);
+  retry_deadline_us = 0;
+  return err;
+}
+
+void http_client_get_stats(http_client_stats_t *out)
+{
+  *out = stats;
+}
+
+const char *http_client_device_id(void)
+{
+  return device_id;
+}
+
 void http_client_free_image_response(image_upload_response_t *response)
 {
   if (response && response->image_resource_name)
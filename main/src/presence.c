@@ -0,0 +1,169 @@
+#include "presence.h"
+#include "camera.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "jpeg_decoder.h"
+#include "wifi.h"
+#include <string.h>
+
+static const char *TAG = "presence";
+
+#ifdef CONFIG_PRESENCE_DETECTION
+#define PRESENCE_TASK_STACK 4096
+// Idle frames are VGA and armed frames 720x1280, both decoded at 1:8
+#define PRESENCE_MAX_PIXELS (90 * 160)
+// The reference follows slow lighting changes with 1/8 of each difference
+#define PRESENCE_ADAPT_SHIFT 3
+
+static uint8_t frame_buf[PRESENCE_MAX_PIXELS];
+static uint8_t reference_buf[PRESENCE_MAX_PIXELS];
+static size_t reference_len = 0;
+static bool armed = false;
+
+static size_t presence_decode(const camera_fb_t *fb)
+{
+  if (fb->format != PIXFORMAT_JPEG)
+  {
+    return 0;
+  }
+  esp_jpeg_image_cfg_t cfg = {
+      .indata = fb->buf,
+      .indata_size = fb->len,
+      .outbuf = frame_buf,
+      .outbuf_size = sizeof(frame_buf),
+      .out_format = JPEG_IMAGE_FORMAT_GRAY8,
+      .out_scale = JPEG_IMAGE_SCALE_1_8,
+  };
+  esp_jpeg_image_output_t out;
+  if (esp_jpeg_decode(&cfg, &out) != ESP_OK)
+  {
+    return 0;
+  }
+  return (size_t)out.width * out.height;
+}
+
+// Share of changed pixels in percent, -1 if the frame only seeded the reference
+static int presence_compare(size_t len)
+{
+  if (len != reference_len)
+  {
+    memcpy(reference_buf, frame_buf, len);
+    reference_len = len;
+    return -1;
+  }
+  size_t changed = luma_diff_update(reference_buf, frame_buf, len,
+                                    CONFIG_PRESENCE_PIXEL_THRESHOLD, PRESENCE_ADAPT_SHIFT);
+  return changed * 100 / len;
+}
+
+static int presence_sample_idle(void)
+{
+  // The camera idles at the preview size with a low XCLK while presence detection is enabled,
+  // so the sample needs no preview start. Right after a session the driver may still hand out
+  // full-size frames.
+  camera_fb_t *fb = NULL;
+  for (int i = 0; i < 3 && !fb; i++)
+  {
+    fb = camera_preview_get();
+  }
+  if (!fb)
+  {
+    return -1;
+  }
+  size_t len = presence_decode(fb);
+  camera_preview_return(fb);
+  return len ? presence_compare(len) : -1;
+}
+
+static int presence_sample_armed(void)
+{
+  camera_fb_t *fb = camera_pretrigger_get();
+  if (!fb)
+  {
+    return -1;
+  }
+  size_t len = presence_decode(fb);
+  // Kept as the pre-trigger frame for the next session capture
+  camera_pretrigger_put(fb);
+  return len ? presence_compare(len) : -1;
+}
+
+static void presence_arm(int changed)
+{
+  ESP_LOGI(TAG, "Motion (%d%% of the scene), arming", changed);
+  armed = true;
+  reference_len = 0;
+  if (camera_arm() != ESP_OK)
+  {
+    ESP_LOGW(TAG, "Camera could not be armed");
+  }
+  if (wifi_wake() != ESP_OK)
+  {
+    ESP_LOGW(TAG, "WiFi wake failed");
+  }
+}
+
+static void presence_disarm(void)
+{
+  ESP_LOGI(TAG, "Scene static for %d ms, back to idle", CONFIG_PRESENCE_STATIC_TIMEOUT_MS);
+  armed = false;
+  reference_len = 0;
+  camera_disarm();
+  wifi_idle();
+}
+
+static void presence_task_fn(void *arg)
+{
+  int64_t last_motion_us = 0;
+  TickType_t last_wake = xTaskGetTickCount();
+
+  while (true)
+  {
+    if (!armed)
+    {
+      int changed = presence_sample_idle();
+      if (changed >= CONFIG_PRESENCE_AREA_PERCENT)
+      {
+        presence_arm(changed);
+        last_motion_us = esp_timer_get_time();
+      }
+      vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_PRESENCE_IDLE_INTERVAL_MS));
+      continue;
+    }
+
+    int changed = presence_sample_armed();
+    int64_t now = esp_timer_get_time();
+    // No frame means a session holds the camera, which counts as presence
+    if (changed < 0 || changed >= CONFIG_PRESENCE_AREA_PERCENT)
+    {
+      last_motion_us = now;
+    }
+    else if (now - last_motion_us >= CONFIG_PRESENCE_STATIC_TIMEOUT_MS * 1000LL)
+    {
+      presence_disarm();
+    }
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_PRESENCE_ARMED_INTERVAL_MS));
+  }
+}
+#endif
+
+esp_err_t presence_init(void)
+{
+#ifdef CONFIG_PRESENCE_DETECTION
+  wifi_idle();
+  // Core 0 runs the sensor loop
+  if (xTaskCreatePinnedToCore(presence_task_fn, "presence", PRESENCE_TASK_STACK, NULL, 1,
+                              NULL, portNUM_PROCESSORS - 1) != pdPASS)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+#else
+  {
+    ESP_LOGW(TAG, "Presence detection is disabled in configuration");
+    return ESP_OK;
+  }
+#endif
+}
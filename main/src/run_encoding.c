@@ -0,0 +1,119 @@
+#include "run_encoding.h"
+#include "cJSON.h"
+#include "cbor.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+
+static void run_idempotency_key(char *key, size_t size, const session_data_t *session_data)
+{
+  snprintf(key, size, "%s-run", session_data->idempotency_key);
+}
+
+// Samples of the flow curve to send, none unless the backend is configured to take them
+static size_t run_flow_len(const session_data_t *session_data)
+{
+#if CONFIG_HTTP_CLIENT_RUN_FLOW
+  return session_data->flow_len;
+#else
+  return 0;
+#endif
+}
+
+// Adds the fields of one run, the idempotency key only where several runs share a request
+static bool run_add_json_fields(cJSON *json, const session_data_t *session_data,
+                                const char *image_resource_name, bool with_key)
+{
+  bool ok = cJSON_AddNumberToObject(json, "rate", session_data->rate) &&
+            cJSON_AddNumberToObject(json, "duration", session_data->duration) &&
+            cJSON_AddNumberToObject(json, "volume", session_data->volume) &&
+            cJSON_AddStringToObject(json, "image", image_resource_name);
+  size_t flow_len = run_flow_len(session_data);
+  if (ok && flow_len)
+  {
+    cJSON *flow = cJSON_CreateArray();
+    ok = flow && cJSON_AddItemToObject(json, "flow", flow) &&
+         cJSON_AddNumberToObject(json, "flow_interval_ms", session_data->flow_interval_ms);
+    for (size_t i = 0; ok && i < flow_len; i++)
+    {
+      cJSON *sample = cJSON_CreateNumber(session_data->flow[i]);
+      ok = sample && cJSON_AddItemToArray(flow, sample);
+    }
+  }
+  if (ok && with_key && session_data->idempotency_key)
+  {
+    char idempotency_key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE + 4];
+    run_idempotency_key(idempotency_key, sizeof(idempotency_key), session_data);
+    ok = cJSON_AddStringToObject(json, "idempotency_key", idempotency_key);
+  }
+  return ok;
+}
+
+char *run_encoding_json(const session_data_t *const *sessions,
+                        const char *const *image_resource_names,
+                        size_t count, bool array, bool formatted)
+{
+  cJSON *json = array ? cJSON_CreateArray() : NULL;
+  bool ok = !array || json;
+  for (size_t i = 0; ok && i < (array ? count : 1); i++)
+  {
+    cJSON *run = cJSON_CreateObject();
+    ok = run && (!array || cJSON_AddItemToArray(json, run)) &&
+         run_add_json_fields(run, sessions[i], image_resource_names[i], array);
+    if (!array)
+    {
+      json = run;
+    }
+  }
+  char *out = ok ? (formatted ? cJSON_Print(json) : cJSON_PrintUnformatted(json)) : NULL;
+  cJSON_Delete(json);
+  return out;
+}
+
+// Same keys as the JSON encoding, the flow curve as a uint8 typed array
+static void run_write_cbor(cbor_writer_t *writer, const session_data_t *session_data,
+                           const char *image_resource_name, bool with_key)
+{
+  with_key = with_key && session_data->idempotency_key;
+  size_t flow_len = run_flow_len(session_data);
+  cbor_write_map(writer, 4 + (flow_len ? 2 : 0) + (with_key ? 1 : 0));
+  cbor_write_text(writer, "rate");
+  cbor_write_float(writer, session_data->rate);
+  cbor_write_text(writer, "duration");
+  cbor_write_float(writer, session_data->duration);
+  cbor_write_text(writer, "volume");
+  cbor_write_float(writer, session_data->volume);
+  cbor_write_text(writer, "image");
+  cbor_write_text(writer, image_resource_name);
+  if (flow_len)
+  {
+    cbor_write_text(writer, "flow");
+    cbor_write_uint8_array(writer, session_data->flow, flow_len);
+    cbor_write_text(writer, "flow_interval_ms");
+    cbor_write_uint(writer, session_data->flow_interval_ms);
+  }
+  if (with_key)
+  {
+    char idempotency_key[HTTP_CLIENT_IDEMPOTENCY_KEY_SIZE + 4];
+    run_idempotency_key(idempotency_key, sizeof(idempotency_key), session_data);
+    cbor_write_text(writer, "idempotency_key");
+    cbor_write_text(writer, idempotency_key);
+  }
+}
+
+size_t run_encoding_cbor(uint8_t *buf, size_t size,
+                         const session_data_t *const *sessions,
+                         const char *const *image_resource_names,
+                         size_t count, bool array)
+{
+  cbor_writer_t writer;
+  cbor_writer_init(&writer, buf, size);
+  if (array)
+  {
+    cbor_write_array(&writer, count);
+  }
+  for (size_t i = 0; i < (array ? count : 1); i++)
+  {
+    run_write_cbor(&writer, sessions[i], image_resource_names[i], array);
+  }
+  return writer.len;
+}
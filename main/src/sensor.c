@@ -16,6 +16,9 @@ static SemaphoreHandle_t s_first_sem = NULL;
 static SemaphoreHandle_t s_idle_sem = NULL;
 static esp_timer_handle_t s_idle_timer = NULL;
 static volatile uint64_t s_first_ts = 0;
+static uint8_t s_flow[CONFIG_SENSOR_FLOW_MAX_SAMPLES];
+static uint16_t s_flow_len = 0;
+static int s_flow_count = 0;
 
 #define PULSES_PER_LITER 6.6f
 
@@ -37,6 +40,25 @@ static void IRAM_ATTR idle_timer_cb(void *arg)
     portYIELD_FROM_ISR();
 }
 
+// Closes the intervals that ended before now. Intervals missed while the camera was capturing
+// share the pulses counted since the last closed one.
+static void flow_sample(uint64_t t_start, uint64_t now, int count)
+{
+  const uint64_t interval_us = CONFIG_SENSOR_FLOW_INTERVAL_MS * 1000ULL;
+  if (now < t_start + (s_flow_len + 1) * interval_us || s_flow_len == CONFIG_SENSOR_FLOW_MAX_SAMPLES)
+  {
+    return;
+  }
+  int intervals = (now - t_start) / interval_us - s_flow_len;
+  int pulses = count - s_flow_count;
+  for (int i = 0; i < intervals && s_flow_len < CONFIG_SENSOR_FLOW_MAX_SAMPLES; i++)
+  {
+    int share = pulses * (i + 1) / intervals - pulses * i / intervals;
+    s_flow[s_flow_len++] = share > UINT8_MAX ? UINT8_MAX : share;
+  }
+  s_flow_count = count;
+}
+
 esp_err_t sensor_init(gpio_num_t pulse_gpio)
 {
   s_first_sem = xSemaphoreCreateBinary();
@@ -99,6 +121,8 @@ esp_err_t sensor_measure_session(SessionResult *out_result)
     return ESP_FAIL;
   }
   uint64_t t_start = s_first_ts;
+  s_flow_len = 0;
+  s_flow_count = 0;
   uint64_t startup_deadline =
       t_start + (uint64_t)CONFIG_SENSOR_STARTUP_WINDOW_MS * 1000ULL;
 
@@ -108,6 +132,7 @@ esp_err_t sensor_measure_session(SessionResult *out_result)
     int cnt;
     ESP_ERROR_CHECK(pcnt_unit_get_count(s_pcnt_unit, &cnt));
     startup_count = cnt;
+    flow_sample(t_start, esp_timer_get_time(), cnt);
   }
   if (startup_count < CONFIG_SENSOR_STARTUP_PULSES)
   {
@@ -117,22 +142,27 @@ esp_err_t sensor_measure_session(SessionResult *out_result)
     return ESP_ERR_TIMEOUT;
   }
 
-  esp_timer_start_once(s_idle_timer, CONFIG_SENSOR_IDLE_TIMEOUT_MS * 1000ULL);
-  int last_count = startup_count;
-
   // Capture image after startup phase
   ESP_LOGI(TAG, "Capturing image during session...");
+  camera_resume();
   camera_fb_t *session_image = camera_capture_frame();
   if (!session_image)
   {
     ESP_LOGW(TAG, "Failed to capture image during session");
   }
+  camera_suspend();
+
+  // The capture can outlast the idle timeout, so the timer only starts now
+  int last_count = startup_count;
+  xSemaphoreTake(s_idle_sem, 0);
+  esp_timer_start_once(s_idle_timer, CONFIG_SENSOR_IDLE_TIMEOUT_MS * 1000ULL);
 
   while (true)
   {
     int cnt;
     ESP_ERROR_CHECK(pcnt_unit_get_count(s_pcnt_unit, &cnt));
     ESP_LOGI(TAG, "COUNT: %d, LAST_COUNT: %d", cnt, last_count);
+    flow_sample(t_start, esp_timer_get_time(), cnt);
     if (cnt != last_count)
     {
       last_count = cnt;
@@ -151,6 +181,7 @@ esp_err_t sensor_measure_session(SessionResult *out_result)
   ESP_ERROR_CHECK(pcnt_unit_stop(s_pcnt_unit));
   int total_pulses;
   ESP_ERROR_CHECK(pcnt_unit_get_count(s_pcnt_unit, &total_pulses));
+  flow_sample(t_start, t_end, total_pulses);
 
   uint64_t dur_us = t_end - t_start;
   float secs = dur_us / 1e6f;
@@ -161,6 +192,9 @@ esp_err_t sensor_measure_session(SessionResult *out_result)
   out_result->rate_lpm = rate_lpm;
   out_result->volume_l = volume_l;
   out_result->image_fb = session_image;
+  out_result->flow = s_flow;
+  out_result->flow_len = s_flow_len;
+  out_result->flow_interval_ms = CONFIG_SENSOR_FLOW_INTERVAL_MS;
 
   ESP_LOGI(TAG, "Result: %d pulses, %.2fs, %.2f L/min, %.2f L, image: %s",
            total_pulses, secs, rate_lpm, volume_l,
@@ -1,10 +1,56 @@
 #include "server.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "camera.h"
 
 static const char *TAG = "server";
 
+#define STREAM_BOUNDARY "frame"
+#define STREAM_TASK_STACK 4096
+#define STREAM_STATS_INTERVAL_US (5 * 1000 * 1000)
+// Wake up now and then while no frames arrive, e.g. during a session
+#define STREAM_WAIT_MS 1000
+
+static const char *STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" STREAM_BOUNDARY;
+static const char *STREAM_PART = "--" STREAM_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
+
+// One encoded frame shared by all readers, freed with the last reference
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    uint32_t seq;
+    uint32_t crc; // only set for the session image
+    int refs;
+} shared_frame_t;
+
+typedef struct {
+    httpd_req_t *req;
+    SemaphoreHandle_t ready;
+    uint32_t period_us;
+    int id;
+    bool used;
+} stream_client_t;
+
+// Guards the shared frames, all reference counts and the client table
+static SemaphoreHandle_t frame_lock = NULL;
+static shared_frame_t *stream_latest = NULL;
+static shared_frame_t *session_latest = NULL;
+static stream_client_t stream_clients[CONFIG_SERVER_STREAM_MAX_CLIENTS];
+static int stream_client_count = 0;
+static int stream_next_id = 0;
+static TaskHandle_t stream_producer = NULL;
+
 static const httpd_uri_t jpg_image_uri = {
     .uri       = "/jpg",
     .method    = HTTP_GET,
@@ -12,16 +58,425 @@ static const httpd_uri_t jpg_image_uri = {
     .user_ctx  = NULL
 };
 
+static void shared_frame_release(shared_frame_t *frame)
+{
+    if (!frame) {
+        return;
+    }
+    xSemaphoreTake(frame_lock, portMAX_DELAY);
+    bool last = --frame->refs == 0;
+    xSemaphoreGive(frame_lock);
+    if (last) {
+        free(frame->buf);
+        free(frame);
+    }
+}
+
+static shared_frame_t *shared_frame_acquire(shared_frame_t **slot)
+{
+    xSemaphoreTake(frame_lock, portMAX_DELAY);
+    shared_frame_t *frame = *slot;
+    if (frame) {
+        frame->refs++;
+    }
+    xSemaphoreGive(frame_lock);
+    return frame;
+}
+
+static void stream_publish(shared_frame_t *frame)
+{
+    xSemaphoreTake(frame_lock, portMAX_DELAY);
+    shared_frame_t *old = stream_latest;
+    stream_latest = frame;
+    for (int i = 0; i < CONFIG_SERVER_STREAM_MAX_CLIENTS; i++) {
+        if (stream_clients[i].used) {
+            xSemaphoreGive(stream_clients[i].ready);
+        }
+    }
+    xSemaphoreGive(frame_lock);
+    shared_frame_release(old);
+}
+
+// The camera frame goes back to the driver right after this copy
+static shared_frame_t *shared_frame_from_fb(camera_fb_t *fb)
+{
+    shared_frame_t *frame = calloc(1, sizeof(shared_frame_t));
+    if (!frame) {
+        return NULL;
+    }
+    frame->refs = 1;
+    if (fb->format == PIXFORMAT_JPEG) {
+        frame->buf = heap_caps_malloc(fb->len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (frame->buf) {
+            memcpy(frame->buf, fb->buf, fb->len);
+            frame->len = fb->len;
+        }
+    } else if (!frame2jpg(fb, 80, &frame->buf, &frame->len)) {
+        frame->buf = NULL;
+    }
+    if (!frame->buf) {
+        free(frame);
+        return NULL;
+    }
+    return frame;
+}
+
+static void stream_producer_fn(void *arg)
+{
+    const TickType_t period = pdMS_TO_TICKS(1000 / CONFIG_SERVER_STREAM_FPS);
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t seq = 0;
+
+    // Preview frames stop while a session or an armed capture needs the camera.
+    // Only a successful start is matched by a stop, the preview count is shared with other users.
+    bool previewing = false;
+    while (true) {
+        xSemaphoreTake(frame_lock, portMAX_DELAY);
+        if (stream_client_count == 0) {
+            // Cleared together with the handover, a producer started after this one owns stream_latest
+            shared_frame_t *old = stream_latest;
+            stream_latest = NULL;
+            stream_producer = NULL;
+            xSemaphoreGive(frame_lock);
+            shared_frame_release(old);
+            break;
+        }
+        xSemaphoreGive(frame_lock);
+
+        if (!previewing) {
+            previewing = camera_preview_start() == ESP_OK;
+        }
+        camera_fb_t *fb = previewing ? camera_preview_get() : NULL;
+        if (fb) {
+            shared_frame_t *frame = shared_frame_from_fb(fb);
+            camera_preview_return(fb);
+            if (frame) {
+                frame->seq = ++seq;
+                stream_publish(frame);
+            }
+        }
+        vTaskDelayUntil(&last_wake, period);
+    }
+    if (previewing) {
+        camera_preview_stop();
+    }
+    vTaskDelete(NULL);
+}
+
+static esp_err_t stream_send_frame(httpd_req_t *req, const shared_frame_t *frame)
+{
+    char part[96];
+    int len = snprintf(part, sizeof(part), STREAM_PART, (unsigned) frame->len);
+    esp_err_t err = httpd_resp_send_chunk(req, part, len);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, (const char *) frame->buf, frame->len);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "\r\n", 2);
+    }
+    return err;
+}
+
+// Without frames flowing, a client that went away would only be noticed by the next send
+static bool stream_client_gone(httpd_req_t *req)
+{
+    char c;
+    int n = recv(httpd_req_to_sockfd(req), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+static void stream_client_fn(void *arg)
+{
+    stream_client_t *client = arg;
+    httpd_req_t *req = client->req;
+
+    uint32_t last_seq = 0;
+    uint32_t sent = 0, skipped = 0, dropped = 0;
+    uint32_t total_sent = 0, total_dropped = 0;
+    int64_t next_due = 0;
+    int64_t window_start = esp_timer_get_time();
+
+    httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    while (true) {
+        if (xSemaphoreTake(client->ready, pdMS_TO_TICKS(STREAM_WAIT_MS)) != pdTRUE &&
+                stream_client_gone(req)) {
+            break;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now < next_due) {
+            // Pacing: newer frames replace this one until the client is due
+            vTaskDelay(pdMS_TO_TICKS((next_due - now + 999) / 1000));
+        }
+
+        shared_frame_t *frame = shared_frame_acquire(&stream_latest);
+        if (!frame || frame->seq == last_seq) {
+            shared_frame_release(frame);
+            continue;
+        }
+        if (last_seq) {
+            skipped += frame->seq - last_seq - 1;
+        }
+        last_seq = frame->seq;
+
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = stream_send_frame(req, frame);
+        shared_frame_release(frame);
+        if (err != ESP_OK) {
+            break;
+        }
+        sent++;
+        next_due = start + client->period_us;
+
+        // Frames published while this client was still sending are drops, it fell behind.
+        // The newest of them is still sent next.
+        shared_frame_t *latest = shared_frame_acquire(&stream_latest);
+        if (latest && latest->seq > last_seq + 1) {
+            dropped += latest->seq - last_seq - 1;
+            last_seq = latest->seq - 1;
+        }
+        shared_frame_release(latest);
+
+        now = esp_timer_get_time();
+        if (now - window_start >= STREAM_STATS_INTERVAL_US) {
+            uint32_t offered = sent + dropped;
+            ESP_LOGI(TAG, "Stream client %d: %.1f fps, %" PRIu32 " skipped by pacing, %.1f%% dropped",
+                     client->id, sent * 1e6f / (now - window_start), skipped,
+                     offered ? dropped * 100.0f / offered : 0.0f);
+            total_sent += sent;
+            total_dropped += dropped;
+            sent = skipped = dropped = 0;
+            window_start = now;
+        }
+    }
+
+    total_sent += sent;
+    total_dropped += dropped;
+    ESP_LOGI(TAG, "Stream client %d closed after %" PRIu32 " frames, %" PRIu32 " dropped",
+             client->id, total_sent, total_dropped);
+
+    httpd_req_async_handler_complete(req);
+    xSemaphoreTake(frame_lock, portMAX_DELAY);
+    vSemaphoreDelete(client->ready);
+    client->used = false;
+    stream_client_count--;
+    xSemaphoreGive(frame_lock);
+    vTaskDelete(NULL);
+}
+
+static uint32_t stream_requested_fps(httpd_req_t *req)
+{
+    uint32_t fps = CONFIG_SERVER_STREAM_FPS;
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "fps", value, sizeof(value)) == ESP_OK) {
+        int requested = atoi(value);
+        if (requested > 0 && requested < (int) fps) {
+            fps = requested;
+        }
+    }
+    return fps;
+}
+
+static esp_err_t stream_handler(httpd_req_t *req)
+{
+    uint32_t fps = stream_requested_fps(req);
+
+    xSemaphoreTake(frame_lock, portMAX_DELAY);
+    stream_client_t *client = NULL;
+    for (int i = 0; i < CONFIG_SERVER_STREAM_MAX_CLIENTS && !client; i++) {
+        if (!stream_clients[i].used) {
+            client = &stream_clients[i];
+        }
+    }
+    if (!client) {
+        xSemaphoreGive(frame_lock);
+        ESP_LOGW(TAG, "Stream client limit reached");
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Too many stream clients");
+    }
+    client->ready = xSemaphoreCreateBinary();
+    if (!client->ready) {
+        xSemaphoreGive(frame_lock);
+        return httpd_resp_send_500(req);
+    }
+    client->used = true;
+    client->id = ++stream_next_id;
+    client->period_us = 1000000 / fps;
+    stream_client_count++;
+    xSemaphoreGive(frame_lock);
+
+    // The stream outlives this handler, so the server keeps serving other requests
+    esp_err_t err = httpd_req_async_handler_begin(req, &client->req);
+    if (err == ESP_OK &&
+        xTaskCreatePinnedToCore(stream_client_fn, "stream_client", STREAM_TASK_STACK, client, 1,
+                                NULL, portNUM_PROCESSORS - 1) != pdPASS) {
+        httpd_req_async_handler_complete(client->req);
+        err = ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(frame_lock, portMAX_DELAY);
+    if (err != ESP_OK) {
+        vSemaphoreDelete(client->ready);
+        client->used = false;
+        stream_client_count--;
+    } else if (!stream_producer &&
+               xTaskCreatePinnedToCore(stream_producer_fn, "stream", STREAM_TASK_STACK, NULL, 1,
+                                       &stream_producer, portNUM_PROCESSORS - 1) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the stream producer");
+    }
+    xSemaphoreGive(frame_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start stream client (%s)", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Stream client %d connected at up to %" PRIu32 " fps", client->id, fps);
+    return ESP_OK;
+}
+
+// jpg_out_cb: appends to the buffer in arg
+static size_t session_copy_cb(void *arg, size_t index, const void *data, size_t len)
+{
+    memcpy((uint8_t *) arg + index, data, len);
+    return len;
+}
+
+static bool shared_frame_splice(shared_frame_t *frame, const uint8_t *segment, size_t segment_len)
+{
+    uint8_t *buf = heap_caps_malloc(frame->len + segment_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) {
+        return false;
+    }
+    jpg_splice_t splice;
+    jpg_splice_init(&splice, segment, segment_len, session_copy_cb, buf);
+    if (jpg_splice_write(&splice, 0, frame->buf, frame->len) != frame->len || !jpg_splice_finish(&splice)) {
+        free(buf);
+        return false;
+    }
+    free(frame->buf);
+    frame->buf = buf;
+    frame->len = splice.index;
+    return true;
+}
+
+void server_set_session_image(camera_fb_t *fb, const uint8_t *segment, size_t segment_len)
+{
+    if (!frame_lock) {
+        return;
+    }
+    shared_frame_t *frame = shared_frame_from_fb(fb);
+    if (!frame) {
+        ESP_LOGW(TAG, "Failed to retain the session image");
+        return;
+    }
+    if (segment_len && !shared_frame_splice(frame, segment, segment_len)) {
+        ESP_LOGW(TAG, "Session image retained without its Exif segment");
+    }
+    frame->crc = esp_rom_crc32_le(0, frame->buf, frame->len);
+
+    xSemaphoreTake(frame_lock, portMAX_DELAY);
+    shared_frame_t *old = session_latest;
+    session_latest = frame;
+    xSemaphoreGive(frame_lock);
+    shared_frame_release(old);
+}
+
+// If-None-Match is "*" or a comma separated list of entity tags. Weak W/"..." tags compare
+// like strong ones (weak comparison, RFC 9110 13.1.2).
+static bool session_etag_matches(httpd_req_t *req, const char *etag)
+{
+    char value[128];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) != ESP_OK) {
+        return false;
+    }
+    size_t etag_len = strlen(etag);
+    const char *p = value;
+    while (*p) {
+        p += strspn(p, " \t,");
+        if (*p == '*') {
+            return true;
+        }
+        if (strncmp(p, "W/", 2) == 0) {
+            p += 2;
+        }
+        if (*p != '"') {
+            return false;
+        }
+        const char *end = strchr(p + 1, '"');
+        if (!end) {
+            return false;
+        }
+        if ((size_t) (end + 1 - p) == etag_len && strncmp(p, etag, etag_len) == 0) {
+            return true;
+        }
+        p = end + 1;
+    }
+    return false;
+}
+
+// Served from the retained copy, polling never costs a camera frame
+static esp_err_t session_image_handler(httpd_req_t *req)
+{
+    shared_frame_t *frame = shared_frame_acquire(&session_latest);
+    if (!frame) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No session yet");
+    }
+
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08" PRIx32 "-%x\"", frame->crc, (unsigned) frame->len);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    esp_err_t err;
+    if (session_etag_matches(req, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        err = httpd_resp_send(req, NULL, 0);
+    } else {
+        httpd_resp_set_type(req, "image/jpeg");
+        err = httpd_resp_send(req, (const char *) frame->buf, frame->len);
+    }
+    shared_frame_release(frame);
+    return err;
+}
+
+static const httpd_uri_t session_image_uri = {
+    .uri       = "/sessions/latest.jpg",
+    .method    = HTTP_GET,
+    .handler   = session_image_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t stream_uri = {
+    .uri       = "/stream",
+    .method    = HTTP_GET,
+    .handler   = stream_handler,
+    .user_ctx  = NULL
+};
+
 httpd_handle_t server_start(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
 
+    if (!frame_lock) {
+        frame_lock = xSemaphoreCreateMutex();
+        if (!frame_lock) {
+            ESP_LOGE(TAG, "Failed to create stream lock");
+            return NULL;
+        }
+    }
+
     ESP_LOGI(TAG, "Starting server on port %d", config.server_port);
     httpd_handle_t server = NULL;
     if (httpd_start(&server, &config) == ESP_OK) {
         ESP_LOGI(TAG, "Registering URI handlers");
         httpd_register_uri_handler(server, &jpg_image_uri);
+        httpd_register_uri_handler(server, &stream_uri);
+        httpd_register_uri_handler(server, &session_image_uri);
         return server;
     }
     ESP_LOGE(TAG, "Failed to start HTTP server");
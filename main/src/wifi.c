@@ -4,8 +4,10 @@
 #include "esp_event.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
+#include "esp_netif_sntp.h"
 #include "freertos/event_groups.h"
 #include "sdkconfig.h"
+#include <time.h>
 
 static const char *TAG = "wifi";
 
@@ -83,6 +85,13 @@ esp_err_t wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_wifi_start());
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
+    // Syncs in the background once the station has an address
+    esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_WIFI_SNTP_SERVER);
+    if (esp_netif_sntp_init(&sntp_config) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "SNTP not started, sessions carry no time");
+    }
+
     /* block until either connected or fail */
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
                                            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
@@ -96,3 +105,42 @@ esp_err_t wifi_init_sta(void)
     }
 #endif
 }
+
+esp_err_t wifi_wake(void)
+{
+#ifdef CONFIG_ENABLE_WIFI
+    esp_err_t err = esp_wifi_set_ps(WIFI_PS_NONE);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    // Retries may have run out while nobody needed the link
+    if (xEventGroupGetBits(s_wifi_event_group) & WIFI_FAIL_BIT)
+    {
+        ESP_LOGI(TAG, "Reconnecting to the AP");
+        s_retry_num = 0;
+        xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        err = esp_wifi_connect();
+    }
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
+
+esp_err_t wifi_idle(void)
+{
+#ifdef CONFIG_ENABLE_WIFI
+    // Stays associated, the radio only wakes for DTIM beacons
+    return esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+#else
+    return ESP_OK;
+#endif
+}
+
+time_t wifi_time(void)
+{
+    time_t now = time(NULL);
+    // The clock starts at 1970 and only SNTP moves it past this (2025-01-01)
+    return now >= 1735689600 ? now : 0;
+}
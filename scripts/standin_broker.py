@@ -0,0 +1,280 @@
+#!/usr/bin/env python3
+"""
+Local stand-in for the MQTT broker of the event channel described in ENDPOINTS.md
+
+A minimal MQTT 3.1.1 broker: CONNECT with the backend credentials, PUBLISH at
+QoS 0 and 1, SUBSCRIBE with + and # wildcards, PINGREQ and DISCONNECT. Run
+events are checked against the run fields and counted, and can be delayed,
+left unacknowledged or have their connection dropped to exercise the client's
+outbox. Retained messages, QoS 2, wills and persistent sessions are not supported.
+
+Usage: standin_broker.py [--port 1883] [--latency-ms 20] [--drop-rate 0.01]
+                         [--no-ack-rate 0.05]
+
+Watch the events with `mosquitto_sub -h 127.0.0.1 -u trichter -P super-safe-password -t 'trichter/#'`
+"""
+
+import argparse
+import json
+import random
+import socket
+import socketserver
+import sys
+import threading
+import time
+
+from standin_server import RUN_FIELDS, Stats
+
+USERNAME = "trichter"
+PASSWORD = "super-safe-password"
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+SUBSCRIBE, SUBACK, UNSUBSCRIBE, UNSUBACK = 8, 9, 10, 11
+PINGREQ, PINGRESP, DISCONNECT = 12, 13, 14
+
+
+def encode_length(n):
+    out = bytearray()
+    while True:
+        byte, n = n % 128, n // 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def packet(kind, body=b"", flags=0):
+    return bytes([kind << 4 | flags]) + encode_length(len(body)) + body
+
+
+def utf8(data, off):
+    n = int.from_bytes(data[off:off + 2], "big")
+    return data[off + 2:off + 2 + n].decode(), off + 2 + n
+
+
+def topic_matches(pattern, topic):
+    parts, levels = pattern.split("/"), topic.split("/")
+    for i, part in enumerate(parts):
+        if part == "#":
+            return True
+        if i >= len(levels) or (part != "+" and part != levels[i]):
+            return False
+    return len(parts) == len(levels)
+
+
+class Broker:
+    def __init__(self, args):
+        self.args = args
+        self.random = random.Random(args.seed)
+        self.stats = Stats()
+        self.lock = threading.Lock()
+        self.clients = set()
+        self.run_keys = set()
+
+    def chance(self, rate):
+        with self.lock:
+            return self.random.random() < rate
+
+    def forward(self, topic, payload):
+        message = packet(PUBLISH, len(topic).to_bytes(2, "big") + topic.encode() + payload)
+        with self.lock:
+            receivers = [c for c in self.clients if any(topic_matches(p, topic) for p in c.subscriptions)]
+        for client in receivers:
+            client.send(message)
+
+    def check_run(self, topic, payload):
+        if not topic.endswith("/runs") and topic != self.args.run_topic:
+            return
+        try:
+            run = json.loads(payload)
+        except ValueError:
+            self.stats.add("bad_runs")
+            return
+        if not isinstance(run, dict) or not all(isinstance(run.get(f), (int, float)) for f in RUN_FIELDS):
+            self.stats.add("bad_runs")
+            return
+        key = run.get("idempotency_key")
+        with self.lock:
+            duplicate = key in self.run_keys
+            self.run_keys.add(key)
+        self.stats.add("duplicate_runs" if duplicate else "runs")
+
+
+class Handler(socketserver.BaseRequestHandler):
+    @property
+    def broker(self):
+        return self.server.broker
+
+    def setup(self):
+        self.request.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.send_lock = threading.Lock()
+        self.subscriptions = set()
+        self.buffer = b""
+
+    def send(self, data):
+        with self.send_lock:
+            try:
+                self.request.sendall(data)
+            except OSError:
+                pass
+
+    def log(self, fmt, *args):
+        if self.broker.args.verbose:
+            sys.stderr.write("%s:%d %s\n" % (self.client_address + (fmt % args,)))
+
+    def read(self, n):
+        while len(self.buffer) < n:
+            piece = self.request.recv(4096)
+            if not piece:
+                raise ConnectionError("closed")
+            self.buffer += piece
+        data, self.buffer = self.buffer[:n], self.buffer[n:]
+        return data
+
+    def read_packet(self):
+        header = self.read(1)[0]
+        length, shift = 0, 0
+        while True:
+            byte = self.read(1)[0]
+            length += (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        return header >> 4, header & 0x0F, self.read(length)
+
+    def handle(self):
+        broker = self.broker
+        # a client that does not ping within 1.5 keepalive intervals is gone
+        self.request.settimeout(10)
+        try:
+            kind, _, body = self.read_packet()
+            if kind != CONNECT or not self.connect(body):
+                return
+            with broker.lock:
+                broker.clients.add(self)
+            broker.stats.add("connections")
+            while True:
+                kind, flags, body = self.read_packet()
+                if kind == PUBLISH:
+                    if not self.publish(flags, body):
+                        return
+                elif kind == SUBSCRIBE:
+                    self.subscribe(body)
+                elif kind == UNSUBSCRIBE:
+                    self.send(packet(UNSUBACK, body[:2]))
+                elif kind == PINGREQ:
+                    broker.stats.add("pings")
+                    self.send(packet(PINGRESP))
+                elif kind == DISCONNECT:
+                    return
+                elif kind != PUBACK:
+                    self.log("unexpected packet %d", kind)
+                    return
+        except (ConnectionError, socket.timeout, OSError, ValueError, IndexError):
+            pass
+        finally:
+            with broker.lock:
+                broker.clients.discard(self)
+            self.log("closed")
+
+    def connect(self, body):
+        protocol, off = utf8(body, 0)
+        level, flags = body[off], body[off + 1]
+        keepalive = int.from_bytes(body[off + 2:off + 4], "big")
+        client_id, off = utf8(body, off + 4)
+        if flags & 0x04:
+            _, off = utf8(body, off)
+            _, off = utf8(body, off)
+        username = password = None
+        if flags & 0x80:
+            username, off = utf8(body, off)
+        if flags & 0x40:
+            password, off = utf8(body, off)
+        if protocol != "MQTT" or level != 4:
+            self.send(packet(CONNACK, b"\x00\x01"))
+            return False
+        if (username, password) != (USERNAME, PASSWORD):
+            self.broker.stats.add("auth_failed")
+            self.send(packet(CONNACK, b"\x00\x05"))
+            return False
+        self.request.settimeout(keepalive * 1.5 if keepalive else None)
+        self.log("connected as %s, keepalive %d s", client_id, keepalive)
+        self.send(packet(CONNACK, b"\x00\x00"))
+        return True
+
+    def publish(self, flags, body):
+        broker = self.broker
+        qos = (flags >> 1) & 0x03
+        topic, off = utf8(body, 0)
+        packet_id = None
+        if qos:
+            packet_id, off = body[off:off + 2], off + 2
+        payload = body[off:]
+        if qos > 1:
+            self.log("QoS %d not supported", qos)
+            return False
+        broker.stats.add("publishes")
+        if flags & 0x08:
+            broker.stats.add("redeliveries")
+        if broker.chance(broker.args.drop_rate):
+            # the client resends QoS 1 messages after reconnecting
+            broker.stats.add("drops")
+            return False
+        latency = broker.args.latency_ms / 1000.0
+        if latency:
+            time.sleep(latency)
+        broker.check_run(topic, payload)
+        broker.forward(topic, payload)
+        if packet_id and not broker.chance(broker.args.no_ack_rate):
+            self.send(packet(PUBACK, packet_id))
+        self.log("%s %d bytes qos %d", topic, len(payload), qos)
+        return True
+
+    def subscribe(self, body):
+        packet_id, off, granted = body[:2], 2, bytearray()
+        while off < len(body):
+            pattern, off = utf8(body, off)
+            qos = min(body[off], 1)
+            off += 1
+            self.subscriptions.add(pattern)
+            granted.append(qos)
+        self.send(packet(SUBACK, packet_id + bytes(granted)))
+
+
+class Server(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--run-topic", default="trichter/runs", help="payloads checked as run events")
+    parser.add_argument("--latency-ms", type=float, default=0, help="delay before each PUBLISH is handled")
+    parser.add_argument("--drop-rate", type=float, default=0, help="share of PUBLISH answered by closing the connection")
+    parser.add_argument("--no-ack-rate", type=float, default=0, help="share of QoS 1 PUBLISH left without PUBACK")
+    parser.add_argument("--seed", type=int, default=None)
+    parser.add_argument("--stats-interval", type=float, default=10, help="seconds between stats lines, 0 is off")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = Server((args.bind, args.port), Handler)
+    server.broker = Broker(args)
+    print(f"Stand-in broker on mqtt://{args.bind}:{args.port}", file=sys.stderr)
+
+    if args.stats_interval > 0:
+        def report():
+            while True:
+                time.sleep(args.stats_interval)
+                print(server.broker.stats.summary(), file=sys.stderr)
+        threading.Thread(target=report, daemon=True).start()
+
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print(server.broker.stats.summary(), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,370 @@
+#!/usr/bin/env python3
+"""
+Local stand-in for the upload backend described in ENDPOINTS.md
+
+Serves POST /api/v1/images and POST /api/v1/runs, the latter also with an
+array of runs and as JSON or CBOR, and can inject latency, bandwidth limits,
+error responses and connection resets. Requests carrying an Idempotency-Key
+that already succeeded are answered with the stored response, runs of an array
+by their own key.
+
+Usage: standin_server.py [--port 8080] [--latency-ms 50] [--bandwidth-kbps 2000]
+                         [--error-rate 0.05] [--reset-rate 0.01] [--stall-rate 0.01]
+                         [--tls-cert cert.pem --tls-key key.pem] [--close-connections]
+                         [--json-only]
+"""
+
+import argparse
+import itertools
+import json
+import random
+import socket
+import ssl
+import struct
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+AUTH_HEADER = "Basic dHJpY2h0ZXI6c3VwZXItc2FmZS1wYXNzd29yZA=="
+RUN_FIELDS = ("rate", "duration", "volume")
+MAX_BATCH = 100
+
+
+def decode_cbor(data):
+    """Decodes the definite-length CBOR the device sends, typed uint8 arrays (tag 64) become lists"""
+    def head(off):
+        initial = data[off]
+        major, info = initial >> 5, initial & 0x1F
+        if info < 24:
+            return major, info, info, off + 1
+        if info > 27:
+            raise ValueError("indefinite length or reserved")
+        n = 1 << (info - 24)
+        return major, info, int.from_bytes(data[off + 1:off + 1 + n], "big"), off + 1 + n
+
+    def item(off):
+        major, info, arg, off = head(off)
+        if major == 0:
+            return arg, off
+        if major == 1:
+            return -1 - arg, off
+        if major in (2, 3):
+            raw = data[off:off + arg]
+            if len(raw) != arg:
+                raise ValueError("truncated")
+            return (bytes(raw) if major == 2 else raw.decode()), off + arg
+        if major == 4:
+            out = []
+            for _ in range(arg):
+                value, off = item(off)
+                out.append(value)
+            return out, off
+        if major == 5:
+            out = {}
+            for _ in range(arg):
+                key, off = item(off)
+                out[key], off = item(off)
+            return out, off
+        if major == 6:
+            value, off = item(off)
+            return (list(value) if arg == 64 and isinstance(value, bytes) else value), off
+        if info == 25:
+            return struct.unpack(">e", arg.to_bytes(2, "big"))[0], off
+        if info == 26:
+            return struct.unpack(">f", arg.to_bytes(4, "big"))[0], off
+        if info == 27:
+            return struct.unpack(">d", arg.to_bytes(8, "big"))[0], off
+        return {20: False, 21: True, 22: None}.get(arg), off
+
+    value, off = item(0)
+    if off != len(data):
+        raise ValueError("trailing data")
+    return value
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.counters = {}
+
+    def add(self, key, n=1):
+        with self.lock:
+            self.counters[key] = self.counters.get(key, 0) + n
+
+    def summary(self):
+        with self.lock:
+            return " ".join(f"{k}={v}" for k, v in sorted(self.counters.items()))
+
+
+class Backend:
+    def __init__(self, args):
+        self.args = args
+        self.random = random.Random(args.seed)
+        self.random_lock = threading.Lock()
+        self.stats = Stats()
+        self.images = set()
+        self.runs = []
+        self.replies = {}
+        self.run_keys = {}
+        self.lock = threading.Lock()
+        self.ids = itertools.count(1)
+
+    def chance(self, rate):
+        with self.random_lock:
+            return self.random.random() < rate
+
+    def latency(self):
+        with self.random_lock:
+            jitter = self.random.uniform(-self.args.jitter_ms, self.args.jitter_ms)
+        return max(0.0, self.args.latency_ms + jitter) / 1000.0
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "trichter-standin"
+    # responses go out as header and body writes, Nagle would hold the body for the delayed ACK
+    disable_nagle_algorithm = True
+
+    @property
+    def backend(self):
+        return self.server.backend
+
+    def setup(self):
+        # idle kept connections are closed after this long, like most servers do
+        self.timeout = self.backend.args.idle_timeout_s or None
+        # The handshake runs on the connection's own thread, a slow client does not hold up accept()
+        if self.server.tls:
+            self.request.settimeout(30)
+            try:
+                self.request = self.server.tls.wrap_socket(self.request, server_side=True)
+            except (ssl.SSLError, OSError):
+                self.backend.stats.add("tls_failed")
+                raise
+            self.backend.stats.add("tls_resumed" if self.request.session_reused else "tls_full")
+        super().setup()
+
+    def log_message(self, fmt, *args):
+        if self.backend.args.verbose:
+            sys.stderr.write("%s %s\n" % (self.address_string(), fmt % args))
+
+    def throttle(self, n, start):
+        # Paces transfers to the configured bandwidth
+        kbps = self.backend.args.bandwidth_kbps
+        if kbps > 0:
+            due = start + n * 8 / (kbps * 1000.0)
+            delay = due - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+
+    def read_exact(self, n, received, start):
+        data = bytearray()
+        while len(data) < n:
+            piece = self.rfile.read(min(n - len(data), 4096))
+            if not piece:
+                raise ConnectionError("body truncated")
+            data += piece
+            self.throttle(received + len(data), start)
+        return bytes(data)
+
+    def read_body(self):
+        start = time.monotonic()
+        if self.headers.get("Transfer-Encoding", "").lower() == "chunked":
+            body = bytearray()
+            while True:
+                size = int(self.rfile.readline().split(b";")[0].strip() or b"0", 16)
+                if size == 0:
+                    while self.rfile.readline() not in (b"\r\n", b"\n", b""):
+                        pass
+                    return bytes(body)
+                body += self.read_exact(size, len(body), start)
+                self.rfile.readline()
+        length = int(self.headers.get("Content-Length", 0))
+        return self.read_exact(length, 0, start)
+
+    def reset(self):
+        # RST instead of FIN, like a dropped NAT mapping or a crashed backend
+        self.backend.stats.add("resets")
+        self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+        self.close_connection = True
+        self.connection.close()
+
+    def reply(self, status, body, content_type="text/plain"):
+        data = body.encode() if isinstance(body, str) else body
+        self.send_response(status)
+        if self.backend.args.close_connections:
+            self.send_header("Connection", "close")
+            self.close_connection = True
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        start = time.monotonic()
+        for off in range(0, len(data), 1024):
+            self.wfile.write(data[off:off + 1024])
+            self.throttle(off + 1024, start)
+        self.backend.stats.add(f"status_{status}")
+
+    def do_POST(self):
+        backend = self.backend
+        backend.stats.add("requests")
+        if backend.chance(backend.args.reset_rate / 2):
+            # before the body, the client sees the reset while still sending
+            return self.reset()
+        try:
+            body = self.read_body()
+        except (ConnectionError, ValueError):
+            backend.stats.add("bad_bodies")
+            self.close_connection = True
+            return
+        backend.stats.add("bytes_in", len(body))
+        time.sleep(backend.latency())
+        if self.headers.get("Authorization") != AUTH_HEADER:
+            return self.reply(401, "Unauthorized")
+        if backend.chance(backend.args.stall_rate):
+            # a dead link: the request is taken and never answered
+            backend.stats.add("stalls")
+            time.sleep(backend.args.stall_s)
+            self.close_connection = True
+            return
+        if backend.chance(backend.args.error_rate):
+            backend.stats.add("injected_errors")
+            return self.reply(backend.args.error_status, "Injected error")
+
+        key = self.headers.get("Idempotency-Key")
+        with backend.lock:
+            stored = backend.replies.get((self.path, key)) if key else None
+        if stored:
+            backend.stats.add("replays")
+            result = stored
+        elif self.path == "/api/v1/images":
+            result = self.create_image(body)
+        elif self.path == "/api/v1/runs":
+            result = self.create_run(body)
+        else:
+            result = (404, "Not found", "text/plain")
+        if key and 200 <= result[0] < 300:
+            with backend.lock:
+                backend.replies[(self.path, key)] = result
+
+        if backend.chance(backend.args.reset_rate / 2):
+            # after processing, the client does not learn that the request succeeded
+            return self.reset()
+        self.reply(*result)
+
+    def create_image(self, body):
+        if self.headers.get("Content-Type") != "image/jpeg":
+            return (415, "Expected image/jpeg", "text/plain")
+        if not body.startswith(b"\xff\xd8") or not body.rstrip(b"\0").endswith(b"\xff\xd9"):
+            return (400, "Not a JPEG image", "text/plain")
+        name = f"images/{next(self.backend.ids):08d}.jpg"
+        with self.backend.lock:
+            self.backend.images.add(name)
+        self.backend.stats.add("images")
+        return (201, name, "text/plain")
+
+    def create_run(self, body):
+        content_type = self.headers.get("Content-Type")
+        accepted = ("application/json",) if self.backend.args.json_only else ("application/json", "application/cbor")
+        if content_type not in accepted:
+            return (415, f"Expected {' or '.join(accepted)}", "text/plain")
+        try:
+            run = json.loads(body) if content_type == "application/json" else decode_cbor(body)
+        except (ValueError, IndexError, struct.error):
+            return (400, "Invalid body", "text/plain")
+        self.backend.stats.add("cbor_bodies" if content_type == "application/cbor" else "json_bodies")
+        if isinstance(run, list):
+            return self.create_runs(run)
+        if not isinstance(run, dict) or not all(isinstance(run.get(f), (int, float)) for f in RUN_FIELDS):
+            return (400, "Missing run fields", "text/plain")
+        key = self.headers.get("Idempotency-Key")
+        with self.backend.lock:
+            if key in self.backend.run_keys:
+                # created as part of an array
+                self.backend.stats.add("replays")
+                return (201, json.dumps(self.backend.run_keys[key]), "application/json")
+            if run.get("image") not in self.backend.images:
+                return (422, "Unknown image", "text/plain")
+            run["id"] = next(self.backend.ids)
+            self.backend.runs.append(run)
+            if key:
+                self.backend.run_keys[key] = run
+        self.backend.stats.add("runs")
+        return (201, json.dumps(run), "application/json")
+
+    def create_runs(self, runs):
+        # All or nothing, runs whose idempotency_key was seen before are answered from the store
+        if not runs or len(runs) > MAX_BATCH:
+            return (400, f"Expected 1 to {MAX_BATCH} runs", "text/plain")
+        for run in runs:
+            if not isinstance(run, dict) or not all(isinstance(run.get(f), (int, float)) for f in RUN_FIELDS):
+                return (400, "Missing run fields", "text/plain")
+        created = []
+        with self.backend.lock:
+            for run in runs:
+                if run.get("image") not in self.backend.images:
+                    return (422, f"Unknown image {run.get('image')}", "text/plain")
+            for run in runs:
+                key = run.pop("idempotency_key", None)
+                stored = self.backend.run_keys.get(key) if key else None
+                if stored:
+                    self.backend.stats.add("replays")
+                    created.append(stored)
+                    continue
+                run["id"] = next(self.backend.ids)
+                self.backend.runs.append(run)
+                if key:
+                    self.backend.run_keys[key] = run
+                created.append(run)
+                self.backend.stats.add("runs")
+        self.backend.stats.add("batches")
+        return (201, json.dumps(created), "application/json")
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--latency-ms", type=float, default=0, help="processing delay per request")
+    parser.add_argument("--jitter-ms", type=float, default=0, help="uniform +- jitter on the latency")
+    parser.add_argument("--bandwidth-kbps", type=float, default=0, help="per connection, 0 is unlimited")
+    parser.add_argument("--error-rate", type=float, default=0, help="share of requests answered with --error-status")
+    parser.add_argument("--error-status", type=int, default=503)
+    parser.add_argument("--reset-rate", type=float, default=0, help="share of connections reset mid-request")
+    parser.add_argument("--stall-rate", type=float, default=0, help="share of requests never answered")
+    parser.add_argument("--stall-s", type=float, default=60, help="how long a stalled request is held open")
+    parser.add_argument("--tls-cert", help="serve HTTPS with this certificate (PEM)")
+    parser.add_argument("--tls-key", help="private key of --tls-cert (PEM)")
+    parser.add_argument("--close-connections", action="store_true", help="answer with Connection: close")
+    parser.add_argument("--json-only", action="store_true", help="answer CBOR runs with 415")
+    parser.add_argument("--idle-timeout-s", type=float, default=0, help="close connections idle this long, 0 is never")
+    parser.add_argument("--seed", type=int, default=None)
+    parser.add_argument("--stats-interval", type=float, default=10, help="seconds between stats lines, 0 is off")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.bind, args.port), Handler)
+    server.daemon_threads = True
+    server.backend = Backend(args)
+    server.tls = None
+    if args.tls_cert:
+        # session IDs and tickets are both on by default
+        server.tls = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        server.tls.load_cert_chain(args.tls_cert, args.tls_key)
+    scheme = "https" if server.tls else "http"
+    print(f"Stand-in backend on {scheme}://{args.bind}:{args.port}", file=sys.stderr)
+
+    if args.stats_interval > 0:
+        def report():
+            while True:
+                time.sleep(args.stats_interval)
+                print(server.backend.stats.summary(), file=sys.stderr)
+        threading.Thread(target=report, daemon=True).start()
+
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print(server.backend.stats.summary(), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,158 @@
+// Decodes each picture on one core and split in two bands (cfg->flags.parallel_decode), checks that
+// the outputs are identical and prints the speedup. The bands run as pthreads. Their thread CPU time,
+// taken around jd_decomp() (linked with --wrap), gives the speedup on two free cores even where the
+// host has fewer; the wall-clock speedup is only meaningful with two CPUs or more.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "jpeg_decoder.h"
+#include "tjpgd.h"
+
+#define MAX_BANDS 2
+
+static double s_band_ms[MAX_BANDS];
+static int s_band_count;
+
+JRESULT __real_jd_decomp(JDEC *jd, int (*outfunc)(JDEC *, void *, JRECT *), uint8_t scale);
+
+JRESULT __wrap_jd_decomp(JDEC *jd, int (*outfunc)(JDEC *, void *, JRECT *), uint8_t scale)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    JRESULT res = __real_jd_decomp(jd, outfunc, scale);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    int band = __atomic_fetch_add(&s_band_count, 1, __ATOMIC_SEQ_CST);
+    if (band < MAX_BANDS) {
+        s_band_ms[band] = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    }
+    return res;
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint8_t *load_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(*len);
+    if (data && fread(data, 1, *len, f) != *len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+static int bench_picture(const char *path)
+{
+    // As in to_bmp.c, the default 3.1kB is too small for full Huffman tables at JD_FASTDECODE 1
+    static uint8_t work[4096];
+    const int times = 50;
+    const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    size_t len;
+    uint8_t *jpg = load_file(path, &len);
+    if (!jpg) {
+        printf("%s: cannot read the picture\n", name);
+        return 1;
+    }
+
+    esp_jpeg_image_cfg_t cfg = {
+        .indata = jpg,
+        .indata_size = len,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+        .advanced.working_buffer = work,
+        .advanced.working_buffer_size = sizeof(work),
+    };
+    esp_jpeg_image_output_t info;
+    if (esp_jpeg_get_image_info(&cfg, &info) != ESP_OK) {
+        printf("%s: not a JPEG\n", name);
+        free(jpg);
+        return 1;
+    }
+    size_t out_size = info.output_len;
+    uint8_t *single = malloc(out_size);
+    uint8_t *parallel = malloc(out_size);
+
+    int failed = 0;
+    for (esp_jpeg_image_scale_t scale = JPEG_IMAGE_SCALE_0; scale <= JPEG_IMAGE_SCALE_1_8; scale++) {
+        esp_jpeg_image_output_t out_single, out_parallel;
+        cfg.out_scale = scale;
+        cfg.outbuf = single;
+        cfg.outbuf_size = out_size;
+        cfg.flags.parallel_decode = 0;
+        memset(single, 0x00, out_size);
+        double start = now_ms();
+        for (int i = 0; i < times; i++) {
+            if (esp_jpeg_decode(&cfg, &out_single) != ESP_OK) {
+                printf("%s: decode failed\n", name);
+                failed = 1;
+                break;
+            }
+        }
+        double t_single = (now_ms() - start) / times;
+
+        cfg.outbuf = parallel;
+        cfg.flags.parallel_decode = 1;
+        memset(parallel, 0xFF, out_size);
+        double bands[MAX_BANDS] = {0};
+        int band_count = 0;
+        start = now_ms();
+        for (int i = 0; i < times; i++) {
+            s_band_count = 0;
+            if (esp_jpeg_decode(&cfg, &out_parallel) != ESP_OK) {
+                printf("%s: parallel decode failed\n", name);
+                failed = 1;
+                break;
+            }
+            band_count = s_band_count;
+            for (int b = 0; b < band_count && b < MAX_BANDS; b++) {
+                bands[b] += s_band_ms[b] / times;
+            }
+        }
+        double t_parallel = (now_ms() - start) / times;
+        if (failed) {
+            break;
+        }
+
+        bool same = out_single.output_len == out_parallel.output_len &&
+                    memcmp(single, parallel, out_single.output_len) == 0;
+        failed |= !same;
+        printf("%-22s 1/%d %4dx%-4d single %7.3f ms, parallel %7.3f ms (x%.2f)", name, 1 << scale,
+               out_single.width, out_single.height, t_single, t_parallel, t_single / t_parallel);
+        if (band_count == MAX_BANDS) {
+            double critical = bands[0] > bands[1] ? bands[0] : bands[1];
+            printf(", bands %.3f + %.3f ms CPU, two cores x%.2f", bands[0], bands[1], (bands[0] + bands[1]) / critical);
+        } else {
+            printf(", not split");
+        }
+        printf("%s\n", same ? "" : ", OUTPUT DIFFERS");
+    }
+
+    free(single);
+    free(parallel);
+    free(jpg);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    printf("%ld CPUs online\n", sysconf(_SC_NPROCESSORS_ONLN));
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        failed |= bench_picture(argv[i]);
+    }
+    return failed;
+}
@@ -0,0 +1,116 @@
+// Times one presence detection sample as presence.c takes it: a grayscale 1:8 decode of the frame
+// followed by luma_diff_update() against the reference, on the sample pictures.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "img_converters.h"
+#include "jpeg_decoder.h"
+
+// As in presence.c
+#define PRESENCE_MAX_PIXELS (90 * 160)
+#define PRESENCE_ADAPT_SHIFT 3
+#define PIXEL_THRESHOLD 16
+
+static uint8_t frame_buf[PRESENCE_MAX_PIXELS];
+static uint8_t reference_buf[PRESENCE_MAX_PIXELS];
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static uint8_t *load_picture(const char *name, size_t *len)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", PICTURES_DIR, name);
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(*len);
+    if (data && fread(data, 1, *len, f) != *len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+static size_t decode(const uint8_t *jpg, size_t len)
+{
+    esp_jpeg_image_cfg_t cfg = {
+        .indata = (uint8_t *)jpg,
+        .indata_size = len,
+        .outbuf = frame_buf,
+        .outbuf_size = sizeof(frame_buf),
+        .out_format = JPEG_IMAGE_FORMAT_GRAY8,
+        .out_scale = JPEG_IMAGE_SCALE_1_8,
+    };
+    esp_jpeg_image_output_t out;
+    if (esp_jpeg_decode(&cfg, &out) != ESP_OK) {
+        return 0;
+    }
+    return (size_t)out.width * out.height;
+}
+
+static int bench_picture(const char *name)
+{
+    const int times = 200;
+    size_t len;
+    uint8_t *jpg = load_picture(name, &len);
+    if (!jpg) {
+        printf("%s: cannot read the picture\n", name);
+        return 1;
+    }
+    size_t pixels = decode(jpg, len);
+    if (!pixels) {
+        printf("%s: decode failed\n", name);
+        free(jpg);
+        return 1;
+    }
+
+    double start = now_us();
+    for (int i = 0; i < times; i++) {
+        decode(jpg, len);
+    }
+    double t_decode = (now_us() - start) / times;
+
+    // The reference starts off by a lighting change and has to follow the static scene
+    for (size_t i = 0; i < pixels; i++) {
+        reference_buf[i] = frame_buf[i] / 2;
+    }
+    size_t changed = 0;
+    int samples = 0;
+    start = now_us();
+    for (; samples < times; samples++) {
+        changed = luma_diff_update(reference_buf, frame_buf, pixels, PIXEL_THRESHOLD, PRESENCE_ADAPT_SHIFT);
+        __asm__ volatile("" ::: "memory");
+    }
+    double t_diff = (now_us() - start) / times;
+
+    // The reference converges to within 2^shift - 1 of the frame, from both sides
+    int max_error = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        int d = abs(frame_buf[i] - reference_buf[i]);
+        max_error = d > max_error ? d : max_error;
+    }
+    printf("%-18s %4zu pixels: decode %7.1f us, difference %5.2f us (%6.1f MPix/s), sample %7.1f us, "
+           "%zu changed, max error %d\n",
+           name, pixels, t_decode, t_diff, pixels / t_diff, t_decode + t_diff, changed, max_error);
+    free(jpg);
+    return changed != 0 || max_error >= 1 << PRESENCE_ADAPT_SHIFT;
+}
+
+int main(void)
+{
+    int failed = bench_picture("testimg.jpeg");
+    failed |= bench_picture("test_inside.jpeg");
+    failed |= bench_picture("test_outside.jpeg");
+    return failed;
+}
@@ -0,0 +1,6 @@
+// Host stand-in for esp_attr.h, placement attributes have no meaning on the host
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_BSS_ATTR
@@ -0,0 +1,21 @@
+// Host stand-in for esp_log.h: errors, warnings and info go to stderr, format strings are checked
+#pragma once
+
+#include <stdarg.h>
+#include <stdio.h>
+
+__attribute__((format(printf, 3, 4))) static inline void esp_log_host(char level, const char *tag, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%s) ", level, tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+#define ESP_LOGE(tag, format, ...) esp_log_host('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_host('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_host('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { if (0) esp_log_host('D', tag, format, ##__VA_ARGS__); } while (0)
+#define ESP_LOGV(tag, format, ...) do { if (0) esp_log_host('V', tag, format, ##__VA_ARGS__); } while (0)
@@ -0,0 +1,18 @@
+// Host stand-in for esp_random.h, seeded by the test runner so failures repeat
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+static inline uint32_t esp_random(void)
+{
+    return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+}
+
+static inline void esp_fill_random(void *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        ((uint8_t *)buf)[i] = (uint8_t)rand();
+    }
+}
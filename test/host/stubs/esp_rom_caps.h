@@ -0,0 +1,2 @@
+// Host stand-in, the host has no ROM decoder
+#pragma once
@@ -0,0 +1,2 @@
+// Host stand-in, nothing of esp_system.h is used by the host builds
+#pragma once
@@ -0,0 +1,24 @@
+// Host stand-in for freertos/semphr.h, binary semaphores on POSIX semaphores
+#pragma once
+
+#include <semaphore.h>
+#include "freertos/FreeRTOS.h"
+
+typedef sem_t StaticSemaphore_t;
+typedef sem_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    return sem_init(buffer, 0, 0) == 0 ? buffer : NULL;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return sem_post(sem) == 0 ? pdTRUE : pdFALSE;
+}
+
+// Only portMAX_DELAY is supported
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return sem_wait(sem) == 0 ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,64 @@
+// Host stand-in for freertos/task.h, see FreeRTOS.h
+#pragma once
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+} host_task_start_t;
+
+static inline void *host_task_entry(void *arg)
+{
+    host_task_start_t start = *(host_task_start_t *)arg;
+    free(arg);
+    start.fn(start.arg);
+    return NULL;
+}
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                                 UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id)
+{
+    host_task_start_t *start = (host_task_start_t *)malloc(sizeof(host_task_start_t));
+    pthread_t thread;
+    if (!start) {
+        return pdFAIL;
+    }
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(&thread, NULL, host_task_entry, start) != 0) {
+        free(start);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (handle) {
+        *handle = NULL;
+    }
+    return pdPASS;
+}
+
+// Tasks end by returning from host_task_entry
+static inline void vTaskDelete(TaskHandle_t task)
+{
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000);
+}
+
+static inline UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return 5;
+}
+
+static inline BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
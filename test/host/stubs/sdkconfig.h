@@ -0,0 +1,13 @@
+// Configuration of the host builds. esp_jpeg uses its own TJpgDec copy, as on targets without it in ROM.
+#pragma once
+
+#define CONFIG_JD_SZBUF 512
+#define CONFIG_JD_FORMAT 0
+#define CONFIG_JD_USE_SCALE 1
+#define CONFIG_JD_TBLCLIP 1
+#define CONFIG_JD_FASTDECODE 1
+#define CONFIG_JD_DEFAULT_HUFFMAN 1
+#define CONFIG_CAMERA_CONVERTER_ENABLED 1
+#ifndef CONFIG_CAMERA_JPEG_ENCODER_FAST_DCT
+#define CONFIG_CAMERA_JPEG_ENCODER_FAST_DCT 1
+#endif
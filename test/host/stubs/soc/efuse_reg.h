@@ -0,0 +1,2 @@
+// Host stand-in, no eFuse registers on the host
+#pragma once
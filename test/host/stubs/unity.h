@@ -0,0 +1,55 @@
+// Host stand-in for the ESP-IDF Unity component: TEST_CASE registration and the assertions the
+// shared test files use. unity_host.c runs every registered case.
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+typedef void (*unity_test_fn_t)(void);
+
+void unity_register(const char *name, unity_test_fn_t fn);
+void unity_fail(const char *file, int line, const char *msg);
+
+#define UNITY_CAT2(a, b) a##b
+#define UNITY_CAT(a, b) UNITY_CAT2(a, b)
+
+#define TEST_CASE(name, tags)                                                                \
+    static void UNITY_CAT(test_fn_, __LINE__)(void);                                         \
+    __attribute__((constructor)) static void UNITY_CAT(test_reg_, __LINE__)(void)            \
+    {                                                                                        \
+        unity_register(name, UNITY_CAT(test_fn_, __LINE__));                                 \
+    }                                                                                        \
+    static void UNITY_CAT(test_fn_, __LINE__)(void)
+
+#define TEST_ASSERT_MESSAGE(cond, msg)                                                       \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            unity_fail(__FILE__, __LINE__, msg);                                             \
+        }                                                                                    \
+    } while (0)
+
+#define TEST_ASSERT(cond) TEST_ASSERT_MESSAGE(cond, #cond)
+#define TEST_ASSERT_TRUE(cond) TEST_ASSERT_MESSAGE(cond, #cond)
+#define TEST_ASSERT_FALSE(cond) TEST_ASSERT_MESSAGE(!(cond), "!(" #cond ")")
+#define TEST_ASSERT_NULL(p) TEST_ASSERT_MESSAGE((p) == NULL, #p " == NULL")
+#define TEST_ASSERT_NOT_NULL(p) TEST_ASSERT_MESSAGE((p) != NULL, #p " != NULL")
+#define TEST_ESP_OK(x) TEST_ASSERT_MESSAGE((x) == 0, #x " == ESP_OK")
+#define TEST_ASSERT_EQUAL(e, a) TEST_ASSERT_MESSAGE((e) == (a), #e " == " #a)
+#define TEST_ASSERT_EQUAL_INT(e, a) TEST_ASSERT_EQUAL((int)(e), (int)(a))
+#define TEST_ASSERT_EQUAL_UINT8(e, a) TEST_ASSERT_EQUAL((uint8_t)(e), (uint8_t)(a))
+#define TEST_ASSERT_EQUAL_UINT32(e, a) TEST_ASSERT_EQUAL((uint32_t)(e), (uint32_t)(a))
+#define TEST_ASSERT_GREATER_THAN(t, a) TEST_ASSERT_MESSAGE((a) > (t), #a " > " #t)
+#define TEST_ASSERT_LESS_THAN(t, a) TEST_ASSERT_MESSAGE((a) < (t), #a " < " #t)
+#define TEST_ASSERT_LESS_OR_EQUAL(t, a) TEST_ASSERT_MESSAGE((a) <= (t), #a " <= " #t)
+#define TEST_ASSERT_UINT8_WITHIN(d, e, a) TEST_ASSERT_INT_WITHIN(d, (uint8_t)(e), (uint8_t)(a))
+#define TEST_ASSERT_INT_WITHIN(d, e, a) TEST_ASSERT_MESSAGE(abs((int)(a) - (int)(e)) <= (int)(d), #a " within " #d " of " #e)
+#define TEST_ASSERT_FLOAT_WITHIN(d, e, a) TEST_ASSERT_MESSAGE(fabs((double)(a) - (double)(e)) <= (double)(d), #a " within " #d " of " #e)
+#define TEST_ASSERT_EQUAL_MEMORY(e, a, n) TEST_ASSERT_MESSAGE(memcmp((e), (a), (n)) == 0, #a " equals " #e)
+#define TEST_ASSERT_EQUAL_HEX8_ARRAY(e, a, n) TEST_ASSERT_EQUAL_MEMORY(e, a, (n))
+#define TEST_ASSERT_EQUAL_UINT8_ARRAY(e, a, n) TEST_ASSERT_EQUAL_MEMORY(e, a, (n))
+#define TEST_ASSERT_EQUAL_UINT32_ARRAY(e, a, n) TEST_ASSERT_EQUAL_MEMORY(e, a, (n) * sizeof(uint32_t))
@@ -0,0 +1,56 @@
+// Runs the TEST_CASEs of the shared test files on the host. Arguments select cases by substring.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+
+#define MAX_TESTS 64
+
+static struct {
+    const char *name;
+    unity_test_fn_t fn;
+} s_tests[MAX_TESTS];
+static int s_test_count;
+static const char *s_current;
+
+void unity_register(const char *name, unity_test_fn_t fn)
+{
+    if (s_test_count < MAX_TESTS) {
+        s_tests[s_test_count].name = name;
+        s_tests[s_test_count].fn = fn;
+        s_test_count++;
+    }
+}
+
+void unity_fail(const char *file, int line, const char *msg)
+{
+    printf("%s:%d: %s: FAIL: %s\n", file, line, s_current, msg);
+    exit(1);
+}
+
+static bool selected(const char *name, int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strstr(name, argv[i])) {
+            return true;
+        }
+    }
+    return argc < 2;
+}
+
+int main(int argc, char **argv)
+{
+    int run = 0;
+    for (int i = 0; i < s_test_count; i++) {
+        if (!selected(s_tests[i].name, argc, argv)) {
+            continue;
+        }
+        s_current = s_tests[i].name;
+        printf("%s\n", s_current);
+        srand(1);
+        s_tests[i].fn();
+        run++;
+    }
+    printf("%d tests OK\n", run);
+    return run ? 0 : 1;
+}